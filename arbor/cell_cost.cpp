@@ -0,0 +1,48 @@
+#include <arbor/cable_cell.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/util/unique_any.hpp>
+
+#include "cell_cost.hpp"
+
+namespace arb {
+
+namespace {
+// Approximate state per compartment in a cable cell group: voltage, current,
+// conductance, area, capacitance, the matrix coefficients and indices.
+constexpr std::size_t bytes_per_cv = 160;
+
+// Approximate state per mechanism instance: node index, weight, and a
+// handful of parameters and state variables.
+constexpr std::size_t bytes_per_mechanism_instance = 96;
+
+// State of a point neuron, spike source or benchmark cell.
+constexpr std::size_t bytes_per_point_cell = 64;
+}
+
+cell_cost_estimate estimate_cell_cost(const recipe& rec, cell_gid_type gid, cell_kind kind) {
+    cell_cost_estimate est;
+
+    if (kind!=cell_kind::cable) {
+        est.memory = bytes_per_point_cell;
+        return est;
+    }
+
+    auto cell = util::any_cast<cable_cell>(rec.get_cell_description(gid));
+
+    std::size_t num_instances = 0;
+    for (const auto& seg: cell.segments()) {
+        num_instances += seg->num_compartments()*seg->mechanisms().size();
+    }
+    num_instances += cell.synapses().size();
+    num_instances += cell.stimuli().size();
+    num_instances += cell.gap_junction_sites().size();
+    num_instances += cell.detectors().size();
+
+    est.num_cv = cell.num_compartments();
+    est.work = est.num_cv + num_instances;
+    est.memory = est.num_cv*bytes_per_cv + num_instances*bytes_per_mechanism_instance;
+    return est;
+}
+
+} // namespace arb
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+#include <arbor/common_types.hpp>
+#include <arbor/recipe.hpp>
+
+namespace arb {
+
+// A rough model of the resources used by a cell in a cell group, for use by
+// the load balancer.
+struct cell_cost_estimate {
+    // Relative cost of advancing the cell by one time step, in units of the
+    // update of one compartment; a point neuron counts as one compartment.
+    double work = 1;
+
+    // Size in bytes of the state of the cell in a cell group.
+    std::size_t memory = 0;
+
+    // Number of compartments, which are the unit of vectorization of
+    // mechanism and matrix updates in cable cell groups; zero for cell
+    // kinds that are not vectorized.
+    std::size_t num_cv = 0;
+};
+
+// Estimate the cost of cell gid of kind kind.
+//
+// Cable cells are described by their number of compartments and the number
+// of density and point mechanism instances; the cost of other cell kinds
+// does not depend on their description.
+cell_cost_estimate estimate_cell_cost(const recipe& rec, cell_gid_type gid, cell_kind kind);
+
+} // namespace arb
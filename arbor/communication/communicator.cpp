@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <limits>
+#include <numeric>
 #include <utility>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/domain_decomposition.hpp>
@@ -9,6 +13,7 @@
 
 #include "algorithms.hpp"
 #include "communication/gathered_vector.hpp"
+#include "communication/spike_encoding.hpp"
 #include "connection.hpp"
 #include "distributed_context.hpp"
 #include "execution_context.hpp"
@@ -29,6 +34,12 @@ communicator::communicator(const recipe& rec,
     distributed_ = ctx.distributed;
     thread_pool_ = ctx.thread_pool;
 
+    // The domains of a dry run are copies of the local domain, which has
+    // no way to find the destinations of its spikes in a sparse exchange.
+    if (ctx.exchange==spike_exchange::sparse && distributed_->name()=="dryrun") {
+        throw arbor_exception("dry run context: sparse spike exchange is not supported");
+    }
+
     num_domains_ = distributed_->size();
     num_local_groups_ = dom_dec.groups.size();
     num_local_cells_ = dom_dec.num_local_cells;
@@ -48,15 +59,16 @@ communicator::communicator(const recipe& rec,
     //   -> gid_infos
     // Count the number of local connections (i.e. connections terminating on this domain)
     //   -> n_cons: scalar
-    // Calculate and store domain id of the presynaptic cell on each local connection
-    //   -> src_domains: array with one entry for every local connection
-    // Also the count of presynaptic sources from each domain
-    //   -> src_counts: array with one entry for each domain
+    // Divide the local cells into blocks, and collect the connections onto
+    // the cells of each block
+    //   -> block_connections: array with one entry for each block
+    // Index the connections of each block by source
+    //   -> tables_: array with one entry for each block
 
     // Record all the gid in a flat vector.
     // These are used to map from local index to gid in the parallel loop
     // that populates gid_infos.
-    std::vector<cell_gid_type> gids;
+    auto& gids = local_gids_;
     gids.reserve(num_local_cells_);
     for (auto g: dom_dec.groups) {
         util::append(gids, g.gids);
@@ -72,29 +84,32 @@ communicator::communicator(const recipe& rec,
 
     cell_local_size_type n_cons =
         util::sum_by(gid_infos, [](const gid_info& g){ return g.conns.size(); });
-    std::vector<unsigned> src_domains;
-    src_domains.reserve(n_cons);
-    std::vector<cell_size_type> src_counts(num_domains_);
-    for (const auto& g: gid_infos) {
-        for (auto con: g.conns) {
-            const auto src = dom_dec.gid_domain(con.source.gid);
-            src_domains.push_back(src);
-            src_counts[src]++;
+
+    // Divide the local cells into blocks of contiguous cells with about the
+    // same number of connections, one block per thread, so that the events
+    // for each block can be generated in parallel without contention.
+    num_blocks_ = std::max<cell_size_type>(1,
+        std::min<cell_size_type>(thread_pool_->get_num_threads(), num_local_cells_));
+    std::vector<cell_size_type> cell_block(num_local_cells_);
+    {
+        std::size_t count = 0;
+        for (const auto& g: gid_infos) {
+            const auto mid = count+g.conns.size()/2;
+            cell_block[g.index_on_domain] = n_cons? std::min<std::size_t>(num_blocks_-1, mid*num_blocks_/n_cons): 0;
+            count += g.conns.size();
         }
     }
 
-    // Construct the connections.
-    // The loop above gave the information required to construct in place
-    // the connections as partitioned by the domain of their source gid.
-    connections_.resize(n_cons);
-    connection_part_ = algorithms::make_index(src_counts);
-    auto offsets = connection_part_;
-    std::size_t pos = 0;
+    // Collect the connections onto the cells of each block.
+    std::vector<std::vector<connection>> block_connections(num_blocks_);
+    local_min_delay_ = std::numeric_limits<time_type>::max();
+    local_max_delay_ = 0;
     for (const auto& cell: gid_infos) {
+        auto& cons = block_connections[cell_block[cell.index_on_domain]];
         for (auto c: cell.conns) {
-            const auto i = offsets[src_domains[pos]]++;
-            connections_[i] = {c.source, c.dest, c.weight, c.delay, cell.index_on_domain};
-            ++pos;
+            cons.push_back({c.source, c.dest, c.weight, c.delay, cell.index_on_domain});
+            local_min_delay_ = std::min<time_type>(local_min_delay_, c.delay);
+            local_max_delay_ = std::max<time_type>(local_max_delay_, c.delay);
         }
     }
 
@@ -104,13 +119,83 @@ communicator::communicator(const recipe& rec,
             dom_dec.groups,
             [](const group_description& g){return g.gids.size();}));
 
-    // Sort the connections for each domain.
-    // This is num_domains_ independent sorts, so it can be parallelized trivially.
-    const auto& cp = connection_part_;
-    threading::parallel_for::apply(0, num_domains_, thread_pool_.get(),
+    // Index the connections of each block by source.
+    // These are independent, so they can be built in parallel.
+    tables_.resize(num_blocks_);
+    threading::parallel_for::apply(0, num_blocks_, 1, thread_pool_.get(),
         [&](cell_size_type i) {
-            util::sort(util::subrange_view(connections_, cp[i], cp[i+1]));
+            tables_[i] = connection_table(std::move(block_connections[i]));
         });
+
+    exchange_mode_ = ctx.exchange;
+    encoding_ = exchange_mode_==spike_exchange::sparse? spike_encoding::raw: ctx.encoding;
+    if (exchange_mode_==spike_exchange::sparse) {
+        std::vector<cell_gid_type> source_gids;
+        for (const auto& cell: gid_infos) {
+            for (const auto& c: cell.conns) {
+                source_gids.push_back(c.source.gid);
+            }
+        }
+        build_send_table(rec, dom_dec, std::move(source_gids));
+    }
+}
+
+// Find the domains to which the spikes of each local source are sent in a
+// sparse exchange, and the domains from which spikes are received.
+//
+// The distinct sources of the connections onto the cells of each domain
+// are gathered on all domains: a domain sends the spikes of a local source
+// to each domain that has it as a source. The domain from which the spikes
+// of a source are received is given by the domain decomposition.
+void communicator::build_send_table(
+        const recipe& rec,
+        const domain_decomposition& dom_dec,
+        std::vector<cell_gid_type> source_gids)
+{
+    // Connections from gids that are not in the model generate no spikes.
+    const auto num_cells = rec.num_cells();
+    util::sort(source_gids);
+    source_gids.erase(std::unique(source_gids.begin(), source_gids.end()), source_gids.end());
+    source_gids.erase(
+        std::lower_bound(source_gids.begin(), source_gids.end(), num_cells),
+        source_gids.end());
+
+    const int domain = distributed_->id();
+    for (auto gid: source_gids) {
+        neighbors_.recv.push_back(dom_dec.gid_domain(gid));
+    }
+    util::sort(neighbors_.recv);
+    neighbors_.recv.erase(std::unique(neighbors_.recv.begin(), neighbors_.recv.end()), neighbors_.recv.end());
+
+    // (local source gid, destination domain) for each domain that has a
+    // connection from a local source.
+    auto global_sources = distributed_->gather_gids(source_gids);
+    std::vector<std::pair<cell_gid_type, int>> sends;
+    for (auto d: util::make_span(global_sources.partition().size()-1)) {
+        const auto& gids = global_sources.values();
+        for (auto i: util::make_span(global_sources.partition()[d], global_sources.partition()[d+1])) {
+            if (dom_dec.gid_domain(gids[i])==domain) {
+                sends.push_back({gids[i], int(d)});
+                neighbors_.send.push_back(int(d));
+            }
+        }
+    }
+    util::sort(neighbors_.send);
+    neighbors_.send.erase(std::unique(neighbors_.send.begin(), neighbors_.send.end()), neighbors_.send.end());
+
+    util::sort(sends);
+    send_gids_.clear();
+    send_dests_.clear();
+    send_dest_divisions_.assign(1, 0);
+    for (const auto& s: sends) {
+        if (send_gids_.empty() || send_gids_.back()!=s.first) {
+            if (!send_gids_.empty()) send_dest_divisions_.push_back(send_dests_.size());
+            send_gids_.push_back(s.first);
+        }
+        send_dests_.push_back(
+            std::lower_bound(neighbors_.send.begin(), neighbors_.send.end(), s.second)-neighbors_.send.begin());
+    }
+    if (!send_gids_.empty()) send_dest_divisions_.push_back(send_dests_.size());
 }
 
 std::pair<cell_size_type, cell_size_type> communicator::group_queue_range(cell_size_type i) {
@@ -119,104 +204,232 @@ std::pair<cell_size_type, cell_size_type> communicator::group_queue_range(cell_s
 }
 
 time_type communicator::min_delay() {
-    auto local_min = std::numeric_limits<time_type>::max();
-    for (auto& con : connections_) {
-        local_min = std::min(local_min, con.delay());
-    }
+    return distributed_->min(local_min_delay_);
+}
 
-    return distributed_->min(local_min);
+time_type communicator::local_max_delay() const {
+    return local_max_delay_;
 }
 
-gathered_vector<spike> communicator::exchange(std::vector<spike> local_spikes) {
+// The spikes must be in ascending order of source gid: if they are not, they
+// are sorted in sort_buffer_, which is kept until the next exchange.
+const std::vector<spike>& communicator::sorted_spikes(const std::vector<spike>& local_spikes) {
+    auto source_less = [](const spike& a, const spike& b) { return a.source<b.source; };
+    if (std::is_sorted(local_spikes.begin(), local_spikes.end(), source_less)) {
+        return local_spikes;
+    }
+
     PE(communication_exchange_sort);
-    // sort the spikes in ascending order of source gid
-    util::sort_by(local_spikes, [](spike s){return s.source;});
+    sort_buffer_.assign(local_spikes.begin(), local_spikes.end());
+    std::sort(sort_buffer_.begin(), sort_buffer_.end(), source_less);
     PL();
+    return sort_buffer_;
+}
 
-    PE(communication_exchange_gather);
+gathered_vector<spike> communicator::exchange(const std::vector<spike>& local_spikes) {
+    return finish_exchange(start_exchange(local_spikes));
+}
+
+gather_request<spike> communicator::start_exchange(const std::vector<spike>& local_spikes) {
+    const auto& spikes = sorted_spikes(local_spikes);
+
+    if (exchange_mode_==spike_exchange::sparse) {
+        return gather_request<spike>(sparse_exchange(spikes));
+    }
+
+    PE(communication_exchange_start);
     // global all-to-all to gather a local copy of the global spike list on each node.
-    auto global_spikes = distributed_->gather_spikes(local_spikes);
-    num_spikes_ += global_spikes.size();
+    auto request = distributed_->start_gather_spikes(spikes);
+    PL();
+
+    PC(exchange_bytes_sent, spikes.size()*sizeof(spike));
+
+    return request;
+}
+
+gathered_vector<spike> communicator::finish_exchange(gather_request<spike> request) {
+    PE(communication_exchange_wait);
+    auto global_spikes = request.wait();
     PL();
 
+    // The sparse exchange is complete on return from start_exchange, and
+    // counts its spikes itself.
+    if (exchange_mode_!=spike_exchange::sparse) {
+        num_spikes_ += global_spikes.size();
+        PC(exchange_bytes_received, global_spikes.size()*sizeof(spike));
+    }
+
     return global_spikes;
 }
 
+gathered_vector<std::uint8_t> communicator::exchange_encoded(const std::vector<spike>& local_spikes) {
+    return finish_exchange(start_exchange_encoded(local_spikes));
+}
+
+gather_request<std::uint8_t> communicator::start_exchange_encoded(const std::vector<spike>& local_spikes) {
+    const auto& spikes = sorted_spikes(local_spikes);
+
+    PE(communication_exchange_encode);
+    encode_buffer_.clear();
+    encode_spikes(spikes, encode_buffer_);
+    PL();
+
+    PE(communication_exchange_start);
+    auto request = distributed_->start_gather_bytes(encode_buffer_);
+    PL();
+
+    PC(exchange_bytes_sent, encode_buffer_.size());
+
+    return request;
+}
+
+gathered_vector<std::uint8_t> communicator::finish_exchange(gather_request<std::uint8_t> request) {
+    PE(communication_exchange_wait);
+    auto encoded = request.wait();
+    PL();
+
+    const auto& part = encoded.partition();
+    for (auto d: util::make_span(part.size()-1)) {
+        if (part[d+1]>part[d]) {
+            num_spikes_ += encoded_spike_count(encoded.values().data()+part[d]);
+        }
+    }
+
+    PC(exchange_bytes_received, encoded.size());
+
+    return encoded;
+}
+
+// Copy the spikes of each local source to the part of the send buffer of
+// each domain to which it is sent, in two passes like make_event_queues:
+// the first counts the spikes for each domain, the second writes them. The
+// spikes for each domain remain sorted by source.
+gathered_vector<spike> communicator::sparse_exchange(const std::vector<spike>& local_spikes) {
+    PE(communication_exchange_pack);
+    const auto n_send = neighbors_.send.size();
+    num_local_spikes_ += local_spikes.size();
+
+    // Call f(spike, k) for each local spike and the index k in
+    // neighbors_.send of each domain to which it is sent. Both the spikes
+    // and send_gids_ are sorted by gid.
+    auto for_each_send = [&](auto&& f) {
+        std::size_t i = 0;
+        for (const auto& spk: local_spikes) {
+            while (i<send_gids_.size() && send_gids_[i]<spk.source.gid) ++i;
+            if (i==send_gids_.size()) break;
+            if (send_gids_[i]!=spk.source.gid) continue;
+            for (auto j: util::make_span(send_dest_divisions_[i], send_dest_divisions_[i+1])) {
+                f(spk, send_dests_[j]);
+            }
+        }
+    };
+
+    send_divisions_.assign(n_send+1, 0);
+    for_each_send([&](const spike&, cell_size_type k) { ++send_divisions_[k+1]; });
+    std::partial_sum(send_divisions_.begin(), send_divisions_.end(), send_divisions_.begin());
+
+    send_buffer_.resize(send_divisions_.back());
+    std::vector<unsigned> cursor(send_divisions_.begin(), send_divisions_.end()-1);
+    for_each_send([&](const spike& spk, cell_size_type k) { send_buffer_[cursor[k]++] = spk; });
+    PL();
+
+    PE(communication_exchange_sparse);
+    auto spikes = distributed_->exchange_spikes(send_buffer_, send_divisions_, neighbors_);
+    PL();
+
+    PC(exchange_bytes_sent, send_buffer_.size()*sizeof(spike));
+    PC(exchange_bytes_received, spikes.size()*sizeof(spike));
+
+    return spikes;
+}
+
 void communicator::make_event_queues(
         const gathered_vector<spike>& global_spikes,
-        std::vector<pse_vector>& queues)
+        cell_event_buffer& queues)
 {
-    arb_assert(queues.size()==num_local_cells_);
-
-    using util::subrange_view;
-    using util::make_span;
-    using util::make_range;
-
-    const auto& sp = global_spikes.partition();
-    const auto& cp = connection_part_;
-    for (auto dom: make_span(num_domains_)) {
-        auto cons = subrange_view(connections_, cp[dom], cp[dom+1]);
-        auto spks = subrange_view(global_spikes.values(), sp[dom], sp[dom+1]);
-
-        struct spike_pred {
-            bool operator()(const spike& spk, const cell_member_type& src)
-                {return spk.source<src;}
-            bool operator()(const cell_member_type& src, const spike& spk)
-                {return src<spk.source;}
-        };
-
-        // We have a choice of whether to walk spikes or connections:
-        // i.e., we can iterate over the spikes, and for each spike search
-        // the for connections that have the same source; or alternatively
-        // for each connection, we can search the list of spikes for spikes
-        // with the same source.
-        //
-        // We iterate over whichever set is the smallest, which has
-        // complexity of order max(S log(C), C log(S)), where S is the
-        // number of spikes, and C is the number of connections.
-        if (cons.size()<spks.size()) {
-            auto sp = spks.begin();
-            auto cn = cons.begin();
-            while (cn!=cons.end() && sp!=spks.end()) {
-                auto sources = std::equal_range(sp, spks.end(), cn->source(), spike_pred());
-                for (auto s: make_range(sources)) {
-                    queues[cn->index_on_domain()].push_back(cn->make_event(s));
-                }
+    const auto& spikes = global_spikes.values();
+    make_event_queues_impl(
+        [&](auto&& f) { for (const auto& spk: spikes) f(spk); },
+        queues);
+}
 
-                sp = sources.first;
-                ++cn;
+void communicator::make_event_queues(
+        const gathered_vector<std::uint8_t>& encoded_spikes,
+        cell_event_buffer& queues)
+{
+    const auto& part = encoded_spikes.partition();
+    const auto bytes = encoded_spikes.values().data();
+    make_event_queues_impl(
+        [&](auto&& f) {
+            for (auto d: util::make_span(part.size()-1)) {
+                if (part[d+1]>part[d]) for_each_encoded_spike(bytes+part[d], f);
             }
-        }
-        else {
-            auto cn = cons.begin();
-            auto sp = spks.begin();
-            while (cn!=cons.end() && sp!=spks.end()) {
-                auto targets = std::equal_range(cn, cons.end(), sp->source);
-                for (auto c: make_range(targets)) {
-                    queues[c.index_on_domain()].push_back(c.make_event(*sp));
-                }
+        },
+        queues);
+}
 
-                cn = targets.first;
-                ++sp;
-            }
-        }
-    }
+template <typename ForEachSpike>
+void communicator::make_event_queues_impl(ForEachSpike&& for_each_spike, cell_event_buffer& queues) {
+    // The connections of each block of cells are looked up by a separate
+    // task: the blocks are disjoint sets of cells, so each task writes to
+    // the counts and events of its own cells only. The fan-out of each
+    // spike in a block is found by a single hash table lookup.
+    auto& divisions = queues.divisions;
+
+    // Count the events for each cell: divisions[i+1] is the number of
+    // events for cell i.
+    divisions.assign(num_local_cells_+1, 0);
+    threading::parallel_for::apply(0, num_blocks_, 1, thread_pool_.get(),
+        [&](cell_size_type block) {
+            const auto& table = tables_[block];
+            if (!table.size()) return;
+
+            for_each_spike([&](const spike& spk) {
+                auto cons = table.connections_from(spk.source);
+                for (auto c = cons.first; c!=cons.second; ++c) {
+                    ++divisions[c->index_on_domain+1];
+                }
+            });
+        });
+    std::partial_sum(divisions.begin(), divisions.end(), divisions.begin());
+
+    // Write the events of each cell to its part of the buffer.
+    queues.events.resize(divisions.back());
+    cursor_.assign(divisions.begin(), divisions.end()-1);
+    auto events = queues.events.data();
+    threading::parallel_for::apply(0, num_blocks_, 1, thread_pool_.get(),
+        [&](cell_size_type block) {
+            const auto& table = tables_[block];
+            if (!table.size()) return;
+
+            for_each_spike([&](const spike& spk) {
+                auto cons = table.connections_from(spk.source);
+                for (auto c = cons.first; c!=cons.second; ++c) {
+                    events[cursor_[c->index_on_domain]++] =
+                        {{local_gids_[c->index_on_domain], c->target}, spk.time+c->delay, c->weight};
+                }
+            });
+        });
 }
 
 std::uint64_t communicator::num_spikes() const {
     return num_spikes_;
 }
 
-cell_size_type communicator::num_local_cells() const {
-    return num_local_cells_;
+void communicator::sum_spikes() {
+    if (exchange_mode_==spike_exchange::sparse) {
+        num_spikes_ += distributed_->sum(num_local_spikes_);
+        num_local_spikes_ = 0;
+    }
 }
 
-const std::vector<connection>& communicator::connections() const {
-    return connections_;
+cell_size_type communicator::num_local_cells() const {
+    return num_local_cells_;
 }
 
 void communicator::reset() {
     num_spikes_ = 0;
+    num_local_spikes_ = 0;
 }
 
 } // namespace arb
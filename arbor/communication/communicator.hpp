@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 #include <arbor/common_types.hpp>
@@ -7,13 +9,44 @@
 #include <arbor/recipe.hpp>
 #include <arbor/spike.hpp>
 
+#include "communication/connection_table.hpp"
 #include "communication/gathered_vector.hpp"
 #include "connection.hpp"
+#include "distributed_context.hpp"
 #include "execution_context.hpp"
 #include "util/partition.hpp"
+#include "util/range.hpp"
 
 namespace arb {
 
+// The events to be delivered to each local cell, stored contiguously by cell
+// in a single buffer: the events of cell i are
+//      events[divisions[i], divisions[i+1]).
+// The buffer is reused from one epoch to the next, so that once it has grown
+// to the largest number of events in an epoch no further allocation is
+// required.
+struct cell_event_buffer {
+    std::vector<cell_size_type> divisions;
+    pse_vector events;
+
+    cell_size_type num_cells() const {
+        return divisions.empty()? 0: divisions.size()-1;
+    }
+
+    util::range<spike_event*> cell(cell_size_type i) {
+        return {events.data()+divisions[i], events.data()+divisions[i+1]};
+    }
+
+    util::range<const spike_event*> cell(cell_size_type i) const {
+        return {events.data()+divisions[i], events.data()+divisions[i+1]};
+    }
+
+    void clear() {
+        std::fill(divisions.begin(), divisions.end(), 0);
+        events.clear();
+    }
+};
+
 // When the communicator is constructed the number of target groups and targets
 // is specified, along with a mapping between local cell id and local
 // target id.
@@ -29,6 +62,8 @@ class communicator {
 public:
     communicator() {}
 
+    /// Throws arbor_exception if ctx selects spike_exchange::sparse with a
+    /// dry run context, which can not find the destinations of spikes.
     explicit communicator(const recipe& rec,
                           const domain_decomposition& dom_dec,
                           execution_context& ctx);
@@ -39,30 +74,92 @@ public:
     /// The minimum delay of all connections in the global network.
     time_type min_delay();
 
+    /// The maximum delay of the connections onto local cells, or zero if
+    /// there are none.
+    time_type local_max_delay() const;
+
     /// Perform exchange of spikes.
     ///
     /// Takes as input the list of local_spikes that were generated on the calling domain.
     /// Returns the full global set of vectors, along with meta data about their partition
-    gathered_vector<spike> exchange(std::vector<spike> local_spikes);
+    ///
+    /// With spike_exchange::sparse, each domain receives only the spikes
+    /// from sources with connections onto its cells, partitioned by sending
+    /// domain, instead of the full global set.
+    ///
+    /// The spikes are passed to the distributed context without a copy if
+    /// they are sorted by source, as gathered by thread_private_spike_store,
+    /// and are otherwise sorted first.
+    gathered_vector<spike> exchange(const std::vector<spike>& local_spikes);
+
+    /// Perform exchange of spikes in two steps, as exchange(): start_exchange
+    /// starts the gather of the spikes, and finish_exchange waits for it to
+    /// complete, so that the caller can do other work in between, calling
+    /// test() on the request to make progress.
+    ///
+    /// The local spikes must not be modified or destroyed until the exchange
+    /// is finished. With spike_exchange::sparse, the exchange is complete
+    /// on return from start_exchange.
+    gather_request<spike> start_exchange(const std::vector<spike>& local_spikes);
+    gathered_vector<spike> finish_exchange(gather_request<spike> request);
+
+    /// The encoding of the spikes in exchange: with spike_encoding::compact,
+    /// exchange_encoded() and the corresponding make_event_queues() are
+    /// used in place of exchange(). Always raw with spike_exchange::sparse.
+    spike_encoding encoding() const { return encoding_; }
+
+    /// Perform exchange of spikes in the compact encoding.
+    ///
+    /// Returns the encoded spikes of each domain, partitioned by domain, to
+    /// be decoded by make_event_queues, or by decode_spikes.
+    gathered_vector<std::uint8_t> exchange_encoded(const std::vector<spike>& local_spikes);
+
+    /// Perform exchange of spikes in the compact encoding in two steps, as
+    /// start_exchange and finish_exchange.
+    gather_request<std::uint8_t> start_exchange_encoded(const std::vector<spike>& local_spikes);
+    gathered_vector<std::uint8_t> finish_exchange(gather_request<std::uint8_t> request);
 
     /// Check each global spike in turn to see it generates local events.
-    /// If so, make the events and insert them into the appropriate event list.
+    /// If so, make the events and write them to the event buffer.
+    ///
+    /// On completion, the events of each local cell in queues are all the
+    /// events that must be delivered to the cell as a result of the global
+    /// spike exchange, in no particular order. Any previous contents of
+    /// queues are replaced.
     ///
-    /// Takes reference to a vector of event lists as an argument, with one list
-    /// for each local cell group. On completion, the events in each list are
-    /// all events that must be delivered to targets in that cell group as a
-    /// result of the global spike exchange, plus any events that were already
-    /// in the list.
+    /// The events are generated in two passes: the first counts the events
+    /// for each cell, so that the buffer can be sized and partitioned by
+    /// cell, and the second writes each event directly to its place in the
+    /// buffer.
+    ///
+    /// The local cells are divided into one block per thread, and each pass
+    /// over a block is performed by a separate task. The spikes need not be
+    /// sorted.
     void make_event_queues(
             const gathered_vector<spike>& global_spikes,
-            std::vector<pse_vector>& queues);
+            cell_event_buffer& queues);
+
+    /// As above, for the encoded spikes returned by exchange_encoded. The
+    /// spikes are decoded by each pass over each block of cells, without
+    /// an intermediate buffer.
+    void make_event_queues(
+            const gathered_vector<std::uint8_t>& encoded_spikes,
+            cell_event_buffer& queues);
 
     /// Returns the total number of global spikes over the duration of the simulation
+    ///
+    /// With spike_exchange::sparse, the spikes exchanged since the last call
+    /// to sum_spikes() are not included: the count is exact only once
+    /// sum_spikes() has been called at the end of simulation::run().
     std::uint64_t num_spikes() const;
 
-    cell_size_type num_local_cells() const;
+    /// Add the number of spikes exchanged since the last call, summed over
+    /// all domains, to num_spikes(). This is a collective operation, needed
+    /// only with spike_exchange::sparse, for which the domains don't see the
+    /// spikes of the other domains.
+    void sum_spikes();
 
-    const std::vector<connection>& connections() const;
+    cell_size_type num_local_cells() const;
 
     void reset();
 
@@ -70,14 +167,56 @@ private:
     cell_size_type num_local_cells_;
     cell_size_type num_local_groups_;
     cell_size_type num_domains_;
-    std::vector<connection> connections_;
-    std::vector<cell_size_type> connection_part_;
+    // Number of blocks of local cells, which are the unit of parallelism
+    // in make_event_queues.
+    cell_size_type num_blocks_;
+    // The connections onto the cells of each block, indexed by source.
+    std::vector<connection_table> tables_;
+    // The gid of each local cell, by index on the local domain.
+    std::vector<cell_gid_type> local_gids_;
+    time_type local_min_delay_;
+    time_type local_max_delay_;
+    // Next free position of each local cell in the event buffer, used
+    // in make_event_queues.
+    std::vector<cell_size_type> cursor_;
     std::vector<cell_size_type> index_divisions_;
     util::partition_view_type<std::vector<cell_size_type>> index_part_;
 
+    // Sparse exchange: the neighbouring domains, and the local sources
+    // with connections onto other domains, in ascending order of gid, with
+    // the indices in neighbors_.send of the domains to which the spikes of
+    // send_gids_[i] are sent in
+    //      send_dests_[send_dest_divisions_[i], send_dest_divisions_[i+1]).
+    spike_exchange exchange_mode_ = spike_exchange::allgather;
+    spike_exchange_neighbors neighbors_;
+    std::vector<cell_gid_type> send_gids_;
+    std::vector<cell_size_type> send_dest_divisions_;
+    std::vector<cell_size_type> send_dests_;
+    // The spikes to send to each neighbour in an exchange, partitioned by
+    // send_divisions_.
+    std::vector<spike> send_buffer_;
+    std::vector<unsigned> send_divisions_;
+
+    spike_encoding encoding_ = spike_encoding::raw;
+    std::vector<std::uint8_t> encode_buffer_;
+
+    // The local spikes in order of source, if they are not already sorted.
+    std::vector<spike> sort_buffer_;
+
     distributed_context_handle distributed_;
     task_system_handle thread_pool_;
     std::uint64_t num_spikes_ = 0u;
+    std::uint64_t num_local_spikes_ = 0u;
+
+    const std::vector<spike>& sorted_spikes(const std::vector<spike>& local_spikes);
+    void build_send_table(const recipe& rec, const domain_decomposition& dom_dec,
+                          std::vector<cell_gid_type> source_gids);
+    gathered_vector<spike> sparse_exchange(const std::vector<spike>& local_spikes);
+
+    // Generate the events of each spike visited by for_each_spike(f),
+    // which calls f(s) for each spike s in turn.
+    template <typename ForEachSpike>
+    void make_event_queues_impl(ForEachSpike&& for_each_spike, cell_event_buffer& queues);
 };
 
 } // namespace arb
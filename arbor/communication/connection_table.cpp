@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <vector>
+
+#include <arbor/assert.hpp>
+
+#include "communication/connection_table.hpp"
+#include "connection.hpp"
+
+namespace arb {
+
+constexpr std::uint64_t connection_table::empty_key;
+
+connection_table::connection_table(std::vector<connection> connections) {
+    std::sort(connections.begin(), connections.end());
+
+    connections_.reserve(connections.size());
+    for (auto& c: connections) {
+        connections_.push_back({c.destination().index, c.index_on_domain(), c.weight(), c.delay()});
+    }
+
+    for (std::size_t i = 0; i<connections.size(); ++i) {
+        if (!i || connections[i-1].source()!=connections[i].source()) {
+            ++num_sources_;
+        }
+    }
+    if (!num_sources_) return;
+
+    unsigned log_capacity = 1;
+    while ((std::size_t(1)<<log_capacity) < 2*num_sources_) ++log_capacity;
+    const std::size_t capacity = std::size_t(1)<<log_capacity;
+    shift_ = 64-log_capacity;
+    mask_ = capacity-1;
+    keys_.assign(capacity, empty_key);
+    offsets_.resize(capacity);
+
+    for (std::size_t b = 0; b<connections.size();) {
+        const auto source = connections[b].source();
+        auto e = b+1;
+        while (e<connections.size() && connections[e].source()==source) ++e;
+
+        const auto key = make_key(source);
+        arb_assert(key!=empty_key);
+        auto slot = hash(key);
+        while (keys_[slot]!=empty_key) slot = (slot+1)&mask_;
+        keys_[slot] = key;
+        offsets_[slot] = {std::uint32_t(b), std::uint32_t(e)};
+        b = e;
+    }
+}
+
+} // namespace arb
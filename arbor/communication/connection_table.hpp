@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+
+#include "connection.hpp"
+
+namespace arb {
+
+// A connection onto a local cell, in the compact form used for event
+// generation: the source is implied by the position of the connection in
+// a connection_table, and the gid of the target cell by its index on the
+// local domain.
+struct local_connection {
+    cell_lid_type target;           // index of the target on the target cell
+    cell_size_type index_on_domain; // index of the target cell on the local domain
+    float weight;
+    float delay;
+};
+
+// Connections onto local cells, grouped by source in compressed sparse row
+// form, with a hash table from source to the range of its connections, so
+// that the fan-out of a spike is found in constant time.
+//
+// The hash table uses open addressing with linear probing, and a capacity of
+// at least twice the number of distinct sources, so gid spaces of any
+// sparsity cost memory in proportion to the number of sources only.
+class connection_table {
+public:
+    using range = std::pair<const local_connection*, const local_connection*>;
+
+    connection_table() = default;
+
+    explicit connection_table(std::vector<connection> connections);
+
+    // The connections from source, or an empty range if there are none.
+    range connections_from(cell_member_type source) const {
+        if (keys_.empty()) return {nullptr, nullptr};
+
+        const auto key = make_key(source);
+        for (auto slot = hash(key);; slot = (slot+1)&mask_) {
+            const auto k = keys_[slot];
+            if (k==key) {
+                auto first = connections_.data();
+                return {first+offsets_[slot].first, first+offsets_[slot].second};
+            }
+            if (k==empty_key) return {nullptr, nullptr};
+        }
+    }
+
+    std::size_t size() const { return connections_.size(); }
+
+    std::size_t num_sources() const { return num_sources_; }
+
+private:
+    // Marks the unused slots of the table: the source {0xffffffff, 0xffffffff}
+    // is reserved, and may not be the source of a connection. Lookups of it
+    // find an unused slot, whose range of connections is empty.
+    static constexpr std::uint64_t empty_key = -1;
+
+    static std::uint64_t make_key(cell_member_type source) {
+        return (std::uint64_t(source.gid)<<32) | source.index;
+    }
+
+    // Fibonacci hashing of the key into [0, capacity).
+    std::size_t hash(std::uint64_t key) const {
+        return (key*0x9e3779b97f4a7c15ull)>>shift_;
+    }
+
+    std::vector<local_connection> connections_;
+    std::vector<std::uint64_t> keys_;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> offsets_;
+    std::size_t num_sources_ = 0;
+    std::size_t mask_ = 0;
+    unsigned shift_ = 64;
+};
+
+} // namespace arb
@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/spike.hpp>
 
 #include <distributed_context.hpp>
@@ -68,6 +70,35 @@ struct dry_run_context_impl {
         return gathered_vector<cell_gid_type>(std::move(gathered_gids), std::move(partition));
     }
 
+    // The sources of the spikes in an opaque buffer can't be renumbered for
+    // each copy of the local domain.
+    gathered_vector<std::uint8_t>
+    gather_bytes(const std::vector<std::uint8_t>&) const {
+        throw arbor_exception("dry run context: gather of encoded data is not supported");
+    }
+
+    // The gathers of a dry run don't communicate, and are complete on return.
+    gather_request<arb::spike>
+    start_gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return gather_request<arb::spike>(gather_spikes(local_spikes));
+    }
+
+    gather_request<std::uint8_t>
+    start_gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return gather_request<std::uint8_t>(gather_bytes(local_bytes));
+    }
+
+    // The domains of a dry run are copies of the local domain, so there is
+    // no way to tell to which of them a spike would be sent.
+    gathered_vector<arb::spike>
+    exchange_spikes(
+        const std::vector<arb::spike>&,
+        const std::vector<unsigned>&,
+        const spike_exchange_neighbors&) const
+    {
+        throw arbor_exception("dry run context: sparse spike exchange is not supported");
+    }
+
     int id() const { return 0; }
 
     int size() const { return num_ranks_; }
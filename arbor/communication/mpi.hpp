@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <memory>
 #include <type_traits>
 #include <vector>
 
@@ -177,6 +178,144 @@ gathered_vector<T> gather_all_with_partition(const std::vector<T>& values, MPI_C
     );
 }
 
+/// Non-blocking gather_all_with_partition.
+///
+/// The counts are gathered on construction with a blocking collective, which
+/// sends one int per rank, and the non-blocking gather of the values is then
+/// started at once, so that it is in flight while the caller does other
+/// work. The values must not be modified until the gather is complete.
+///
+/// If the request is destroyed before it is complete, the destructor waits
+/// for the collective in flight.
+template <typename T>
+class gather_all_request {
+    using count_type = typename gathered_vector<T>::count_type;
+    using traits = mpi_traits<T>;
+
+    // MPI holds pointers to the buffers of the state, which is not moved
+    // with the request.
+    struct state {
+        std::vector<int> counts;
+        std::vector<int> displs;
+        std::vector<T> buffer;
+        MPI_Request request = MPI_REQUEST_NULL;
+    };
+    std::unique_ptr<state> s_;
+
+public:
+    gather_all_request(const std::vector<T>& values, MPI_Comm comm): s_(new state) {
+        auto& s = *s_;
+        int count = int(values.size()*traits::count());
+        s.counts.resize(size(comm));
+        MPI_OR_THROW(MPI_Allgather,
+                &count, 1, MPI_INT,          // send buffer
+                s.counts.data(), 1, MPI_INT, // receive buffer
+                comm);
+
+        s.displs = algorithms::make_index(s.counts);
+        s.buffer.resize(s.displs.back()/traits::count());
+        MPI_OR_THROW(MPI_Iallgatherv,
+                // const_cast required for MPI implementations that don't use const* in their interfaces
+                const_cast<T*>(values.data()), count, traits::mpi_type(), // send buffer
+                s.buffer.data(), s.counts.data(), s.displs.data(), traits::mpi_type(), // receive buffer
+                comm, &s.request);
+    }
+
+    gather_all_request(gather_all_request&&) = default;
+
+    ~gather_all_request() {
+        if (s_ && s_->request!=MPI_REQUEST_NULL) {
+            MPI_Wait(&s_->request, MPI_STATUS_IGNORE);
+        }
+    }
+
+    bool test() {
+        int done = 0;
+        MPI_OR_THROW(MPI_Test, &s_->request, &done, MPI_STATUS_IGNORE);
+        return done;
+    }
+
+    gathered_vector<T> wait() {
+        auto& s = *s_;
+        MPI_OR_THROW(MPI_Wait, &s.request, MPI_STATUS_IGNORE);
+
+        for (auto& d: s.displs) {
+            d /= traits::count();
+        }
+        return gathered_vector<T>(
+            std::move(s.buffer),
+            std::vector<count_type>(s.displs.begin(), s.displs.end())
+        );
+    }
+};
+
+/// Point-to-point exchange of the parts of a vector with neighbouring ranks:
+/// values[send_divisions[i], send_divisions[i+1]) is sent to rank send_to[i],
+/// and the values sent to this rank by each rank in recv_from are returned,
+/// partitioned in the order of recv_from.
+///
+/// Every rank in send_to must list this rank in its recv_from, and vice versa.
+/// The counts are exchanged first, so that the receive buffer can be sized,
+/// then the values.
+template <typename T, typename C>
+gathered_vector<T> neighbor_exchange(
+    const std::vector<T>& values,
+    const std::vector<C>& send_divisions,
+    const std::vector<int>& send_to,
+    const std::vector<int>& recv_from,
+    MPI_Comm comm)
+{
+    using gathered_type = gathered_vector<T>;
+    using count_type = typename gathered_vector<T>::count_type;
+    using traits = mpi_traits<T>;
+
+    constexpr int count_tag = 0x5e1;
+    constexpr int value_tag = 0x5e2;
+
+    const auto n_send = send_to.size();
+    const auto n_recv = recv_from.size();
+    std::vector<MPI_Request> requests(n_send+n_recv);
+
+    std::vector<int> send_counts(n_send), recv_counts(n_recv);
+    for (std::size_t i = 0; i<n_send; ++i) {
+        send_counts[i] = int((send_divisions[i+1]-send_divisions[i])*traits::count());
+    }
+    for (std::size_t i = 0; i<n_recv; ++i) {
+        MPI_OR_THROW(MPI_Irecv,
+            &recv_counts[i], 1, MPI_INT, recv_from[i], count_tag, comm, &requests[i]);
+    }
+    for (std::size_t i = 0; i<n_send; ++i) {
+        MPI_OR_THROW(MPI_Isend,
+            &send_counts[i], 1, MPI_INT, send_to[i], count_tag, comm, &requests[n_recv+i]);
+    }
+    MPI_OR_THROW(MPI_Waitall, int(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+
+    auto displs = algorithms::make_index(recv_counts);
+    std::vector<T> buffer(displs.back()/traits::count());
+
+    for (std::size_t i = 0; i<n_recv; ++i) {
+        MPI_OR_THROW(MPI_Irecv,
+            reinterpret_cast<char*>(buffer.data())+displs[i]*(sizeof(T)/traits::count()),
+            recv_counts[i], traits::mpi_type(), recv_from[i], value_tag, comm, &requests[i]);
+    }
+    for (std::size_t i = 0; i<n_send; ++i) {
+        MPI_OR_THROW(MPI_Isend,
+            // const_cast required for MPI implementations that don't use const* in their interfaces
+            const_cast<T*>(values.data()+send_divisions[i]),
+            send_counts[i], traits::mpi_type(), send_to[i], value_tag, comm, &requests[n_recv+i]);
+    }
+    MPI_OR_THROW(MPI_Waitall, int(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+
+    for (auto& d : displs) {
+        d /= traits::count();
+    }
+
+    return gathered_type(
+        std::move(buffer),
+        std::vector<count_type>(displs.begin(), displs.end())
+    );
+}
+
 template <typename T>
 T reduce(T value, MPI_Op op, int root, MPI_Comm comm) {
     using traits = mpi_traits<T>;
@@ -5,6 +5,7 @@
 #error "build only if MPI is enabled"
 #endif
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -38,6 +39,30 @@ struct mpi_context_impl {
         return mpi::gather_all_with_partition(local_gids, comm_);
     }
 
+    gathered_vector<std::uint8_t>
+    gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return mpi::gather_all_with_partition(local_bytes, comm_);
+    }
+
+    gather_request<arb::spike>
+    start_gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return mpi::gather_all_request<arb::spike>(local_spikes, comm_);
+    }
+
+    gather_request<std::uint8_t>
+    start_gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return mpi::gather_all_request<std::uint8_t>(local_bytes, comm_);
+    }
+
+    gathered_vector<arb::spike>
+    exchange_spikes(
+        const std::vector<arb::spike>& send_spikes,
+        const std::vector<unsigned>& send_divisions,
+        const spike_exchange_neighbors& neighbors) const
+    {
+        return mpi::neighbor_exchange(send_spikes, send_divisions, neighbors.send, neighbors.recv, comm_);
+    }
+
     std::string name() const { return "MPI"; }
     int id() const { return rank_; }
     int size() const { return size_; }
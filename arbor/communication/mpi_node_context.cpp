@@ -0,0 +1,300 @@
+// A distributed context that aggregates the gathers of the ranks on each
+// node in shared memory, so that only one rank per node takes part in the
+// collectives between nodes.
+
+#ifndef ARB_HAVE_MPI
+#error "build only if MPI is enabled"
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include <arbor/spike.hpp>
+
+#include "algorithms.hpp"
+#include "communication/mpi.hpp"
+#include "distributed_context.hpp"
+
+namespace arb {
+
+namespace {
+
+// Calls to MPI are not allowed after MPI_Finalize, which may be called before
+// a context is destroyed.
+bool mpi_finalized() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    return finalized;
+}
+
+// A buffer in a shared memory window of the ranks of a node, allocated
+// contiguously by the first rank of the node.
+//
+// reserve() is collective over the ranks of the node, which must all request
+// the same size. Writes to the buffer are made visible to the other ranks of
+// the node by sync(). The destructor frees the window, which is also
+// collective: the ranks of the node must destroy their buffers together.
+class shared_buffer {
+public:
+    explicit shared_buffer(MPI_Comm comm): comm_(comm) {}
+
+    shared_buffer(const shared_buffer&) = delete;
+    shared_buffer& operator=(const shared_buffer&) = delete;
+
+    ~shared_buffer() {
+        if (!mpi_finalized()) free();
+    }
+
+    void reserve(std::size_t bytes) {
+        if (bytes<=capacity_) return;
+
+        auto capacity = std::max(bytes, 2*capacity_);
+        free();
+        capacity_ = capacity;
+
+        char* base;
+        MPI_Aint size = mpi::rank(comm_)==0? capacity_: 0;
+        MPI_OR_THROW(MPI_Win_allocate_shared, size, 1, MPI_INFO_NULL, comm_, &base, &win_);
+
+        int disp_unit;
+        MPI_OR_THROW(MPI_Win_shared_query, win_, 0, &size, &disp_unit, &data_);
+        MPI_OR_THROW(MPI_Win_lock_all, MPI_MODE_NOCHECK, win_);
+    }
+
+    char* data() const {
+        return static_cast<char*>(data_);
+    }
+
+    // Make the writes of every rank of the node visible to the others.
+    void sync() {
+        if (win_!=MPI_WIN_NULL) MPI_OR_THROW(MPI_Win_sync, win_);
+        mpi::barrier(comm_);
+        if (win_!=MPI_WIN_NULL) MPI_OR_THROW(MPI_Win_sync, win_);
+    }
+
+private:
+    void free() {
+        if (win_!=MPI_WIN_NULL) {
+            MPI_Win_unlock_all(win_);
+            MPI_Win_free(&win_);
+        }
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+
+    MPI_Comm comm_;
+    MPI_Win win_ = MPI_WIN_NULL;
+    void* data_ = nullptr;
+    std::size_t capacity_ = 0;
+};
+
+} // namespace
+
+// The ranks of comm are grouped by node, with the communicator of the ranks
+// of a node, node_comm, and that of the first rank of each node, the
+// leaders, leader_comm. With ranks_per_node>0, the ranks of a node are
+// further divided into groups of ranks_per_node ranks that are treated as
+// nodes, so that a run on many nodes can be simulated on one.
+//
+// The domains are numbered node by node: comm_ is comm with the ranks in
+// this order, and is used for the operations other than the gathers.
+//
+// A gather copies the local values of each rank into a shared buffer of
+// the node, the leaders gather the values of all nodes into a second shared
+// buffer, from which each rank copies the gathered values.
+//
+// The shared buffers are freed when the last copy of the context is
+// destroyed, which is collective over the ranks of the node.
+//
+// Throws arb::mpi::mpi_error if MPI calls fail.
+struct mpi_node_context_impl {
+    struct state {
+        MPI_Comm comm = MPI_COMM_NULL;
+        MPI_Comm node_comm = MPI_COMM_NULL;
+        MPI_Comm leader_comm = MPI_COMM_NULL;
+
+        // The first domain and the number of domains of each node: only
+        // set on the leaders.
+        std::vector<int> node_first;
+        std::vector<int> node_size;
+
+        std::unique_ptr<shared_buffer> send;
+        std::unique_ptr<shared_buffer> recv;
+
+        ~state() {
+            send.reset();
+            recv.reset();
+            if (mpi_finalized()) return;
+            for (auto c: {&comm, &node_comm, &leader_comm}) {
+                if (*c!=MPI_COMM_NULL) MPI_Comm_free(c);
+            }
+        }
+    };
+
+    std::shared_ptr<state> state_;
+    int size_;
+    int rank_;
+    int node_rank_;
+    MPI_Comm comm_;
+
+    mpi_node_context_impl(MPI_Comm comm, unsigned ranks_per_node): state_(new state) {
+        auto& s = *state_;
+        int rank = mpi::rank(comm);
+
+        MPI_Comm shared_comm;
+        MPI_OR_THROW(MPI_Comm_split_type, comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &shared_comm);
+        int group = ranks_per_node? mpi::rank(shared_comm)/ranks_per_node: 0;
+        MPI_OR_THROW(MPI_Comm_split, shared_comm, group, rank, &s.node_comm);
+        MPI_Comm_free(&shared_comm);
+
+        node_rank_ = mpi::rank(s.node_comm);
+        int node_size = mpi::size(s.node_comm);
+        MPI_OR_THROW(MPI_Comm_split, comm, node_rank_==0? 0: MPI_UNDEFINED, rank, &s.leader_comm);
+
+        // Number the domains node by node.
+        int first = 0;
+        if (node_rank_==0) {
+            s.node_size = mpi::gather_all(node_size, s.leader_comm);
+            s.node_first = algorithms::make_index(s.node_size);
+            first = s.node_first[mpi::rank(s.leader_comm)];
+        }
+        first = mpi::broadcast(first, 0, s.node_comm);
+        rank_ = first+node_rank_;
+
+        MPI_OR_THROW(MPI_Comm_split, comm, 0, rank_, &s.comm);
+        comm_ = s.comm;
+        size_ = mpi::size(comm_);
+
+        s.send.reset(new shared_buffer(s.node_comm));
+        s.recv.reset(new shared_buffer(s.node_comm));
+    }
+
+    template <typename T>
+    gathered_vector<T> gather_all(const std::vector<T>& values) const {
+        using traits = mpi::mpi_traits<T>;
+        using count_type = typename gathered_vector<T>::count_type;
+        auto& s = *state_;
+
+        // Copy the local values into the buffer of the node.
+        auto node_counts = mpi::gather_all(int(values.size()), s.node_comm);
+        auto node_displs = algorithms::make_index(node_counts);
+        s.send->reserve(node_displs.back()*sizeof(T));
+        if (!values.empty()) {
+            std::memcpy(s.send->data()+node_displs[node_rank_]*sizeof(T), values.data(), values.size()*sizeof(T));
+        }
+        s.send->sync();
+
+        // The number of values of every domain, gathered by the leaders and
+        // shared with the node.
+        std::vector<int> counts(size_);
+        if (node_rank_==0) {
+            MPI_OR_THROW(MPI_Allgatherv,
+                    node_counts.data(), int(node_counts.size()), MPI_INT,
+                    counts.data(), s.node_size.data(), s.node_first.data(), MPI_INT,
+                    s.leader_comm);
+        }
+        MPI_OR_THROW(MPI_Bcast, counts.data(), size_, MPI_INT, 0, s.node_comm);
+        auto displs = algorithms::make_index(counts);
+        s.recv->reserve(displs.back()*sizeof(T));
+
+        // The leaders gather the values of all nodes into the receive buffer.
+        if (node_rank_==0) {
+            auto num_nodes = s.node_size.size();
+            std::vector<int> recv_counts(num_nodes), recv_displs(num_nodes);
+            for (std::size_t i = 0; i<num_nodes; ++i) {
+                auto b = s.node_first[i];
+                auto e = s.node_first[i+1];
+                recv_displs[i] = displs[b]*traits::count();
+                recv_counts[i] = (displs[e]-displs[b])*traits::count();
+            }
+            MPI_OR_THROW(MPI_Allgatherv,
+                    s.send->data(), int(node_displs.back()*traits::count()), traits::mpi_type(),
+                    s.recv->data(), recv_counts.data(), recv_displs.data(), traits::mpi_type(),
+                    s.leader_comm);
+        }
+        s.recv->sync();
+
+        auto first = reinterpret_cast<const T*>(s.recv->data());
+        return gathered_vector<T>(
+            std::vector<T>(first, first+displs.back()),
+            std::vector<count_type>(displs.begin(), displs.end())
+        );
+    }
+
+    gathered_vector<arb::spike>
+    gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return gather_all(local_spikes);
+    }
+
+    gathered_vector<cell_gid_type>
+    gather_gids(const std::vector<cell_gid_type>& local_gids) const {
+        return gather_all(local_gids);
+    }
+
+    gathered_vector<std::uint8_t>
+    gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return gather_all(local_bytes);
+    }
+
+    // The gathers are blocking, and complete on return: the spike exchange
+    // is not overlapped with the cell updates.
+    gather_request<arb::spike>
+    start_gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return gather_request<arb::spike>(gather_spikes(local_spikes));
+    }
+
+    gather_request<std::uint8_t>
+    start_gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return gather_request<std::uint8_t>(gather_bytes(local_bytes));
+    }
+
+    gathered_vector<arb::spike>
+    exchange_spikes(
+        const std::vector<arb::spike>& send_spikes,
+        const std::vector<unsigned>& send_divisions,
+        const spike_exchange_neighbors& neighbors) const
+    {
+        return mpi::neighbor_exchange(send_spikes, send_divisions, neighbors.send, neighbors.recv, comm_);
+    }
+
+    std::string name() const { return "MPI"; }
+    int id() const { return rank_; }
+    int size() const { return size_; }
+
+    template <typename T>
+    T min(T value) const {
+        return mpi::reduce(value, MPI_MIN, comm_);
+    }
+
+    template <typename T>
+    T max(T value) const {
+        return mpi::reduce(value, MPI_MAX, comm_);
+    }
+
+    template <typename T>
+    T sum(T value) const {
+        return mpi::reduce(value, MPI_SUM, comm_);
+    }
+
+    template <typename T>
+    std::vector<T> gather(T value, int root) const {
+        return mpi::gather(value, root, comm_);
+    }
+
+    void barrier() const {
+        mpi::barrier(comm_);
+    }
+};
+
+template <>
+std::shared_ptr<distributed_context> make_mpi_node_context(MPI_Comm comm, unsigned ranks_per_node) {
+    return std::make_shared<distributed_context>(mpi_node_context_impl(comm, ranks_per_node));
+}
+
+} // namespace arb
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+#include "communication/spike_encoding.hpp"
+#include "util/span.hpp"
+
+namespace arb {
+
+void encode_spikes(const std::vector<spike>& spikes, std::vector<std::uint8_t>& bytes) {
+    using namespace spike_encoding_impl;
+
+    // Write to a buffer large enough for the longest possible encoding,
+    // which is trimmed to size at the end.
+    const auto offset = bytes.size();
+    bytes.resize(offset+max_varint_bytes*(3+3*spikes.size()));
+    auto p = bytes.data()+offset;
+
+    put_varint(spikes.size(), p);
+    if (!spikes.empty()) {
+        auto t0 = to_ordered(spikes.front().time);
+        auto t1 = t0;
+        for (const auto& s: spikes) {
+            t0 = std::min(t0, to_ordered(s.time));
+            t1 = std::max(t1, to_ordered(s.time));
+        }
+        unsigned w = 0;
+        for (auto d = t1-t0; d; d >>= 8) ++w;
+
+        put_varint(t0, p);
+        *p++ = std::uint8_t(w);
+
+        cell_gid_type gid = 0;
+        for (const auto& s: spikes) {
+            arb_assert(s.source.gid>=gid);
+            put_varint(s.source.gid-gid, p);
+            put_varint(s.source.index, p);
+            put_fixed(to_ordered(s.time)-t0, w, p);
+            gid = s.source.gid;
+        }
+    }
+    bytes.resize(p-bytes.data());
+}
+
+gathered_vector<spike> decode_spikes(const gathered_vector<std::uint8_t>& encoded) {
+    using count_type = gathered_vector<spike>::count_type;
+
+    const auto& part = encoded.partition();
+    const auto bytes = encoded.values().data();
+
+    std::vector<spike> spikes;
+    std::vector<count_type> partition(1, 0);
+    for (auto d: util::make_span(part.size()-1)) {
+        if (part[d+1]>part[d]) {
+            for_each_encoded_spike(bytes+part[d], [&](const spike& s) { spikes.push_back(s); });
+        }
+        partition.push_back(spikes.size());
+    }
+    return gathered_vector<spike>(std::move(spikes), std::move(partition));
+}
+
+} // namespace arb
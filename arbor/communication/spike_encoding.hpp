@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+
+namespace arb {
+
+// Compact encoding of the spikes exchanged between domains.
+//
+// The spikes of a domain, sorted by source, are encoded as:
+//      the number of spikes n;
+//      if n>0, the earliest spike time t0, and the width w in bytes of the
+//      largest time offset;
+//      for each spike: the difference between its gid and the gid of the
+//      previous spike (or the gid itself for the first spike), its source
+//      index, and the offset of its time from t0.
+// Integers are unsigned LEB128 varints, except for the time offsets, which
+// are little-endian in w bytes, so that they are decoded without branches
+// that depend on their values; w is a single byte.
+//
+// Times are encoded without loss as the difference between the ordered
+// integer representations of the floating point values: the spikes of an
+// epoch are close in time, so that the offsets fit in two or three bytes.
+// Gid differences and source indices are typically a single byte each.
+namespace spike_encoding_impl {
+    using time_bits = std::conditional_t<sizeof(time_type)==8, std::uint64_t, std::uint32_t>;
+    static_assert(sizeof(time_type)==sizeof(time_bits), "unsupported time_type");
+
+    constexpr time_bits sign_bit = time_bits(1)<<(8*sizeof(time_bits)-1);
+
+    // Map time values to unsigned integers of the same order.
+    inline time_bits to_ordered(time_type t) {
+        time_bits b;
+        std::memcpy(&b, &t, sizeof(b));
+        return b&sign_bit? ~b: b|sign_bit;
+    }
+
+    inline time_type from_ordered(time_bits b) {
+        b = b&sign_bit? b&~sign_bit: ~b;
+        time_type t;
+        std::memcpy(&t, &b, sizeof(t));
+        return t;
+    }
+
+    // The largest number of bytes in the encoding of a 64 bit value.
+    constexpr std::size_t max_varint_bytes = 10;
+
+    inline void put_varint(std::uint64_t v, std::uint8_t*& p) {
+        while (v>=0x80) {
+            *p++ = std::uint8_t(v|0x80);
+            v >>= 7;
+        }
+        *p++ = std::uint8_t(v);
+    }
+
+    // Fixed width little-endian values of w bytes.
+    inline void put_fixed(std::uint64_t v, unsigned w, std::uint8_t*& p) {
+        for (unsigned i = 0; i<w; ++i, v >>= 8) *p++ = std::uint8_t(v);
+    }
+
+    inline std::uint64_t get_fixed(unsigned w, const std::uint8_t*& p) {
+        std::uint64_t v = 0;
+        for (unsigned i = 0; i<w; ++i) v |= std::uint64_t(*p++)<<(8*i);
+        return v;
+    }
+
+    inline std::uint64_t get_varint(const std::uint8_t*& p) {
+        // Most values are encoded in a single byte.
+        std::uint64_t v = *p++;
+        if (v<0x80) return v;
+
+        v &= 0x7f;
+        for (unsigned shift = 7;; shift += 7) {
+            const std::uint8_t b = *p++;
+            v |= std::uint64_t(b&0x7f)<<shift;
+            if (b<0x80) return v;
+        }
+    }
+} // namespace spike_encoding_impl
+
+// Append the encoding of spikes, which must be sorted by source, to bytes.
+void encode_spikes(const std::vector<spike>& spikes, std::vector<std::uint8_t>& bytes);
+
+// The number of spikes encoded at first.
+inline std::size_t encoded_spike_count(const std::uint8_t* first) {
+    return spike_encoding_impl::get_varint(first);
+}
+
+// Call f(s) for each spike s encoded at first, in order, and return the
+// end of the encoding.
+template <typename F>
+const std::uint8_t* for_each_encoded_spike(const std::uint8_t* first, F&& f) {
+    using namespace spike_encoding_impl;
+
+    auto n = get_varint(first);
+    if (!n) return first;
+
+    const auto t0 = time_bits(get_varint(first));
+    const unsigned w = *first++;
+    cell_gid_type gid = 0;
+    while (n--) {
+        gid += cell_gid_type(get_varint(first));
+        const auto index = cell_lid_type(get_varint(first));
+        const auto t = from_ordered(t0+time_bits(get_fixed(w, first)));
+        f(spike({gid, index}, t));
+    }
+    return first;
+}
+
+// Decode the encoded spikes gathered from each domain, keeping the partition
+// by domain.
+gathered_vector<spike> decode_spikes(const gathered_vector<std::uint8_t>& encoded);
+
+} // namespace arb
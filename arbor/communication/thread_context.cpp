@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/spike.hpp>
+
+#include "distributed_context.hpp"
+#include "util/span.hpp"
+
+namespace arb {
+
+// The state shared by the domains of a thread context, each of which runs
+// in its own thread.
+//
+// The domains synchronize with a lock-free barrier. Collectives are
+// implemented in one of two ways:
+//
+//  * The gathers copy the local values of each domain into a buffer of the
+//    domain before arriving at the barrier, and read the buffers of all
+//    domains once the barrier is complete. The buffers are double buffered
+//    by the parity of the barrier generation: a domain can only write the
+//    buffer of generation g again in generation g+2, once every domain has
+//    arrived at generation g+1, which it does after reading generation g.
+//
+//  * The other collectives publish a pointer to the local values of each
+//    domain, and read the values of the others between two barriers.
+//
+// A domain that fails can not take part in any further collectives, so it
+// aborts the hub: the domains that wait for it, or that start a collective
+// later, throw instead.
+class thread_domain_hub {
+public:
+    explicit thread_domain_hub(int n):
+        size_(n), slots_(n), buffers_{std::vector<buffer>(n), std::vector<buffer>(n)}
+    {}
+
+    int size() const { return size_; }
+
+    // Arrive at the barrier without waiting for the other domains, and
+    // return the generation of the barrier, which is complete once passed()
+    // returns true.
+    unsigned arrive() {
+        auto gen = generation_.load(std::memory_order_acquire);
+        if (arrived_.fetch_add(1, std::memory_order_acq_rel)+1==size_) {
+            arrived_.store(0, std::memory_order_relaxed);
+            generation_.store(gen+1, std::memory_order_release);
+        }
+        return gen;
+    }
+
+    bool passed(unsigned gen) const {
+        return generation_.load(std::memory_order_acquire)!=gen;
+    }
+
+    // Spin until the barrier of generation gen is complete, yielding to the
+    // other threads after a while.
+    void wait(unsigned gen) const {
+        for (unsigned i = 0; !passed(gen); ++i) {
+            check_aborted();
+            if (i>=spin_limit) std::this_thread::yield();
+        }
+    }
+
+    void abort() {
+        aborted_.store(true, std::memory_order_release);
+    }
+
+    void barrier() {
+        wait(arrive());
+    }
+
+    // Copy the local values of domain into its buffer and arrive at the
+    // barrier: the gathered values are returned by gathered() once the
+    // barrier is complete.
+    template <typename T>
+    unsigned post(int domain, const std::vector<T>& values) {
+        auto gen = generation_.load(std::memory_order_acquire);
+        auto& b = buffers_[gen&1][domain];
+        b.resize(values.size()*sizeof(T));
+        if (!values.empty()) {
+            std::memcpy(b.data(), values.data(), b.size());
+        }
+        return arrive();
+    }
+
+    template <typename T>
+    gathered_vector<T> gathered(unsigned gen) const {
+        using count_type = typename gathered_vector<T>::count_type;
+        const auto& bufs = buffers_[gen&1];
+
+        std::vector<count_type> partition(1, 0);
+        for (const auto& b: bufs) {
+            partition.push_back(partition.back()+b.size()/sizeof(T));
+        }
+
+        std::vector<T> values(partition.back());
+        for (auto d: util::make_span(size_)) {
+            if (!bufs[d].empty()) {
+                std::memcpy(values.data()+partition[d], bufs[d].data(), bufs[d].size());
+            }
+        }
+        return gathered_vector<T>(std::move(values), std::move(partition));
+    }
+
+    // Publish p as the contribution of domain, and return the result of
+    // f applied to the contributions of all domains.
+    template <typename F>
+    auto collect(int domain, const void* p, F&& f) {
+        check_aborted();
+        slots_[domain] = p;
+        barrier();
+        auto result = f(slots_);
+        barrier();
+        return result;
+    }
+
+private:
+    static constexpr unsigned spin_limit = 1000;
+
+    using buffer = std::vector<char>;
+
+    void check_aborted() const {
+        if (aborted_.load(std::memory_order_acquire)) {
+            throw arbor_exception("thread context: collective aborted by the failure of another domain");
+        }
+    }
+
+    const int size_;
+    std::atomic<int> arrived_{0};
+    std::atomic<unsigned> generation_{0};
+    std::atomic<bool> aborted_{false};
+
+    std::vector<const void*> slots_;
+    std::vector<buffer> buffers_[2];
+};
+
+// A gather posted to a thread_domain_hub.
+template <typename T>
+struct thread_gather {
+    std::shared_ptr<thread_domain_hub> hub;
+    unsigned generation;
+
+    bool test() {
+        return hub->passed(generation);
+    }
+
+    gathered_vector<T> wait() {
+        hub->wait(generation);
+        return hub->gathered<T>(generation);
+    }
+};
+
+// One of the domains of a thread context. The domains must call the same
+// collectives in the same order, and a domain must wait for a gather it
+// has started before it calls another collective.
+struct thread_context_impl {
+    std::shared_ptr<thread_domain_hub> hub_;
+    int rank_;
+
+    thread_context_impl(std::shared_ptr<thread_domain_hub> hub, int rank):
+        hub_(std::move(hub)), rank_(rank)
+    {}
+
+    template <typename T>
+    gathered_vector<T> gather_all(const std::vector<T>& local) const {
+        return thread_gather<T>{hub_, hub_->post(rank_, local)}.wait();
+    }
+
+    gathered_vector<arb::spike>
+    gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return gather_all(local_spikes);
+    }
+
+    gathered_vector<cell_gid_type>
+    gather_gids(const std::vector<cell_gid_type>& local_gids) const {
+        return gather_all(local_gids);
+    }
+
+    gathered_vector<std::uint8_t>
+    gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return gather_all(local_bytes);
+    }
+
+    // The local values are copied when the gather is started, and the
+    // gather is complete once every domain has started it.
+    gather_request<arb::spike>
+    start_gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return thread_gather<arb::spike>{hub_, hub_->post(rank_, local_spikes)};
+    }
+
+    gather_request<std::uint8_t>
+    start_gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return thread_gather<std::uint8_t>{hub_, hub_->post(rank_, local_bytes)};
+    }
+
+    gathered_vector<arb::spike>
+    exchange_spikes(
+        const std::vector<arb::spike>& send_spikes,
+        const std::vector<unsigned>& send_divisions,
+        const spike_exchange_neighbors& neighbors) const
+    {
+        struct message {
+            const std::vector<arb::spike>* spikes;
+            const std::vector<unsigned>* divisions;
+            const spike_exchange_neighbors* neighbors;
+        };
+        message m{&send_spikes, &send_divisions, &neighbors};
+
+        return hub_->collect(rank_, &m, [&](const std::vector<const void*>& slots) {
+            std::vector<arb::spike> values;
+            std::vector<unsigned> partition(1, 0);
+            for (auto r: neighbors.recv) {
+                auto& from = *static_cast<const message*>(slots[r]);
+                auto& send = from.neighbors->send;
+                auto k = std::find(send.begin(), send.end(), rank_)-send.begin();
+                if (std::size_t(k)<send.size()) {
+                    auto first = from.spikes->begin();
+                    values.insert(values.end(), first+(*from.divisions)[k], first+(*from.divisions)[k+1]);
+                }
+                partition.push_back(values.size());
+            }
+            return gathered_vector<arb::spike>(std::move(values), std::move(partition));
+        });
+    }
+
+    std::string name() const { return "threads"; }
+    int id() const { return rank_; }
+    int size() const { return hub_->size(); }
+
+    template <typename T>
+    T min(T value) const {
+        return reduce(value, [](T a, T b) { return std::min(a, b); });
+    }
+
+    template <typename T>
+    T max(T value) const {
+        return reduce(value, [](T a, T b) { return std::max(a, b); });
+    }
+
+    template <typename T>
+    T sum(T value) const {
+        return reduce(value, [](T a, T b) { return a+b; });
+    }
+
+    template <typename T>
+    std::vector<T> gather(T value, int root) const {
+        return hub_->collect(rank_, &value, [&](const std::vector<const void*>& slots) {
+            std::vector<T> values;
+            if (rank_==root) {
+                for (auto p: slots) {
+                    values.push_back(*static_cast<const T*>(p));
+                }
+            }
+            return values;
+        });
+    }
+
+    void barrier() const {
+        hub_->barrier();
+    }
+
+private:
+    template <typename T, typename Op>
+    T reduce(T value, Op op) const {
+        return hub_->collect(rank_, &value, [&](const std::vector<const void*>& slots) {
+            T result = *static_cast<const T*>(slots[0]);
+            for (auto i: util::make_span(std::size_t(1), slots.size())) {
+                result = op(result, *static_cast<const T*>(slots[i]));
+            }
+            return result;
+        });
+    }
+};
+
+std::vector<distributed_context_handle> make_thread_domain_contexts(unsigned num_domains) {
+    std::function<void()> abort;
+    return make_thread_domain_contexts(num_domains, abort);
+}
+
+std::vector<distributed_context_handle> make_thread_domain_contexts(unsigned num_domains, std::function<void()>& abort) {
+    auto hub = std::make_shared<thread_domain_hub>(num_domains);
+    abort = [hub] { hub->abort(); };
+
+    std::vector<distributed_context_handle> contexts;
+    for (unsigned i = 0; i<num_domains; ++i) {
+        contexts.push_back(std::make_shared<distributed_context>(thread_context_impl(hub, i)));
+    }
+    return contexts;
+}
+
+} // namespace arb
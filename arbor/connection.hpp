@@ -4,6 +4,7 @@
 
 #include <arbor/common_types.hpp>
 #include <arbor/spike.hpp>
+#include <arbor/spike_event.hpp>
 
 namespace arb {
 
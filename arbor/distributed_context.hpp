@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 #include <arbor/spike.hpp>
 #include <arbor/util/pp_util.hpp>
@@ -30,6 +33,89 @@ namespace arb {
 
 #define ARB_COLLECTIVE_TYPES_ float, double, int, unsigned, long, unsigned long, long long, unsigned long long
 
+// The domains with which a domain exchanges spikes in a sparse spike
+// exchange, in ascending order. A domain may be its own neighbour.
+struct spike_exchange_neighbors {
+    std::vector<int> send;  // Domains to which spikes are sent.
+    std::vector<int> recv;  // Domains from which spikes are received.
+};
+
+// A gather started by distributed_context::start_gather_spikes or
+// start_gather_bytes, which proceeds while the caller does other work. The
+// local values of the gather must not be modified or destroyed until it is
+// complete.
+//
+// test() returns true once the gather is complete: implementations may make
+// progress only when it is called, so it should be called regularly while
+// the gather is in flight. wait() blocks until the gather is complete and
+// returns the gathered values; it is called once.
+//
+// Uses the same value-semantic type erasure as distributed_context: an
+// implementation provides test() and wait(). A gather_request constructed
+// from gathered values is complete.
+template <typename T>
+class gather_request {
+public:
+    gather_request() = default;
+
+    explicit gather_request(gathered_vector<T> values):
+        impl_(new wrap<ready>(ready{std::move(values)}))
+    {}
+
+    template <
+        typename Impl,
+        typename = std::enable_if_t<
+            !std::is_same<std::decay_t<Impl>, gather_request>::value &&
+            !std::is_same<std::decay_t<Impl>, gathered_vector<T>>::value>
+    >
+    gather_request(Impl&& impl):
+        impl_(new wrap<std::decay_t<Impl>>(std::forward<Impl>(impl)))
+    {}
+
+    gather_request(gather_request&& other) = default;
+    gather_request& operator=(gather_request&& other) = default;
+
+    bool test() {
+        return impl_->test();
+    }
+
+    gathered_vector<T> wait() {
+        return impl_->wait();
+    }
+
+private:
+    struct interface {
+        virtual bool test() = 0;
+        virtual gathered_vector<T> wait() = 0;
+
+        virtual ~interface() {}
+    };
+
+    template <typename Impl>
+    struct wrap: interface {
+        explicit wrap(const Impl& impl): wrapped(impl) {}
+        explicit wrap(Impl&& impl): wrapped(std::move(impl)) {}
+
+        bool test() override {
+            return wrapped.test();
+        }
+        gathered_vector<T> wait() override {
+            return wrapped.wait();
+        }
+
+        Impl wrapped;
+    };
+
+    struct ready {
+        gathered_vector<T> values;
+
+        bool test() { return true; }
+        gathered_vector<T> wait() { return std::move(values); }
+    };
+
+    std::unique_ptr<interface> impl_;
+};
+
 // Defines the concept/interface for a distributed communication context.
 //
 // Uses value-semantic type erasure to define the interface, so that
@@ -43,6 +129,8 @@ class distributed_context {
 public:
     using spike_vector = std::vector<arb::spike>;
     using gid_vector = std::vector<cell_gid_type>;
+    using count_vector = std::vector<gathered_vector<arb::spike>::count_type>;
+    using byte_vector = std::vector<std::uint8_t>;
 
     // default constructor uses a local context: see below.
     distributed_context();
@@ -63,6 +151,37 @@ public:
         return impl_->gather_gids(local_gids);
     }
 
+    // Gather opaque buffers, such as encoded spikes, from all domains.
+    gathered_vector<std::uint8_t> gather_bytes(const byte_vector& local_bytes) const {
+        return impl_->gather_bytes(local_bytes);
+    }
+
+    // Start gather_spikes or gather_bytes without waiting for it to
+    // complete: see gather_request.
+    gather_request<arb::spike> start_gather_spikes(const spike_vector& local_spikes) const {
+        return impl_->start_gather_spikes(local_spikes);
+    }
+
+    gather_request<std::uint8_t> start_gather_bytes(const byte_vector& local_bytes) const {
+        return impl_->start_gather_bytes(local_bytes);
+    }
+
+    // Sparse exchange of spikes with neighbouring domains: the spikes
+    //      send_spikes[send_divisions[i], send_divisions[i+1])
+    // are sent to domain neighbors.send[i], and the spikes sent to this
+    // domain by each domain in neighbors.recv are returned, partitioned by
+    // sending domain. The neighbours of all domains must be consistent.
+    //
+    // Implementations that can't tell the domains apart, such as the dry
+    // run context, may return more spikes than were sent to this domain.
+    gathered_vector<arb::spike> exchange_spikes(
+        const spike_vector& send_spikes,
+        const count_vector& send_divisions,
+        const spike_exchange_neighbors& neighbors) const
+    {
+        return impl_->exchange_spikes(send_spikes, send_divisions, neighbors);
+    }
+
     int id() const {
         return impl_->id();
     }
@@ -91,6 +210,14 @@ private:
             gather_spikes(const spike_vector& local_spikes) const = 0;
         virtual gathered_vector<cell_gid_type>
             gather_gids(const gid_vector& local_gids) const = 0;
+        virtual gathered_vector<std::uint8_t>
+            gather_bytes(const byte_vector& local_bytes) const = 0;
+        virtual gather_request<arb::spike>
+            start_gather_spikes(const spike_vector& local_spikes) const = 0;
+        virtual gather_request<std::uint8_t>
+            start_gather_bytes(const byte_vector& local_bytes) const = 0;
+        virtual gathered_vector<arb::spike>
+            exchange_spikes(const spike_vector&, const count_vector&, const spike_exchange_neighbors&) const = 0;
         virtual int id() const = 0;
         virtual int size() const = 0;
         virtual void barrier() const = 0;
@@ -115,6 +242,26 @@ private:
         gather_gids(const gid_vector& local_gids) const override {
             return wrapped.gather_gids(local_gids);
         }
+        gathered_vector<std::uint8_t>
+        gather_bytes(const byte_vector& local_bytes) const override {
+            return wrapped.gather_bytes(local_bytes);
+        }
+        gather_request<arb::spike>
+        start_gather_spikes(const spike_vector& local_spikes) const override {
+            return wrapped.start_gather_spikes(local_spikes);
+        }
+        gather_request<std::uint8_t>
+        start_gather_bytes(const byte_vector& local_bytes) const override {
+            return wrapped.start_gather_bytes(local_bytes);
+        }
+        gathered_vector<arb::spike>
+        exchange_spikes(
+            const spike_vector& send_spikes,
+            const count_vector& send_divisions,
+            const spike_exchange_neighbors& neighbors) const override
+        {
+            return wrapped.exchange_spikes(send_spikes, send_divisions, neighbors);
+        }
         int id() const override {
             return wrapped.id();
         }
@@ -157,6 +304,40 @@ struct local_context {
                 {0u, static_cast<count_type>(local_gids.size())}
         );
     }
+    gathered_vector<std::uint8_t>
+    gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        using count_type = typename gathered_vector<std::uint8_t>::count_type;
+        return gathered_vector<std::uint8_t>(
+                std::vector<std::uint8_t>(local_bytes),
+                {0u, static_cast<count_type>(local_bytes.size())}
+        );
+    }
+
+    // There is nothing to wait for: the gathers are complete on return.
+    gather_request<arb::spike>
+    start_gather_spikes(const std::vector<arb::spike>& local_spikes) const {
+        return gather_request<arb::spike>(gather_spikes(local_spikes));
+    }
+    gather_request<std::uint8_t>
+    start_gather_bytes(const std::vector<std::uint8_t>& local_bytes) const {
+        return gather_request<std::uint8_t>(gather_bytes(local_bytes));
+    }
+
+    // The only possible neighbour is the domain itself.
+    gathered_vector<arb::spike>
+    exchange_spikes(
+        const std::vector<arb::spike>& send_spikes,
+        const std::vector<unsigned>& send_divisions,
+        const spike_exchange_neighbors& neighbors) const
+    {
+        std::vector<arb::spike> spikes;
+        if (!neighbors.send.empty() && !neighbors.recv.empty()) {
+            spikes.assign(send_spikes.begin()+send_divisions[0], send_spikes.begin()+send_divisions[1]);
+        }
+        std::vector<unsigned> partition(neighbors.recv.size()+1, spikes.size());
+        partition[0] = 0;
+        return gathered_vector<arb::spike>(std::move(spikes), std::move(partition));
+    }
 
     int id() const { return 0; }
 
@@ -192,9 +373,23 @@ distributed_context_handle make_local_context() {
 
 distributed_context_handle make_dry_run_context(unsigned num_ranks, unsigned num_cells_per_rank);
 
+// Contexts for num_domains domains in the same process, each of which is
+// used from its own thread: see run_thread_domains.
+std::vector<distributed_context_handle> make_thread_domain_contexts(unsigned num_domains);
+
+// As above, and sets abort to a function that makes the collectives of all
+// the domains throw arbor_exception, both those in progress and any started
+// later: used when a domain fails, so that the others do not wait for it.
+std::vector<distributed_context_handle> make_thread_domain_contexts(unsigned num_domains, std::function<void()>& abort);
+
 // MPI context creation functions only provided if built with MPI support.
 template <typename MPICommType>
 distributed_context_handle make_mpi_context(MPICommType);
 
+// MPI context that gathers over the ranks of each node in shared memory
+// before gathering over the nodes: see spike_exchange::hierarchical.
+template <typename MPICommType>
+distributed_context_handle make_mpi_node_context(MPICommType, unsigned ranks_per_node);
+
 } // namespace arb
 
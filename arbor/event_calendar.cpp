@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "event_calendar.hpp"
+
+namespace arb {
+
+constexpr time_type event_calendar::no_time;
+
+event_calendar::event_calendar(time_type width, unsigned num_bins):
+    width_(width),
+    bins_(std::max(1u, num_bins))
+{
+    arb_assert(width>0);
+}
+
+void event_calendar::pop_before(time_type t_from, time_type t_to, pse_vector& out) {
+    if (!size_ || !(t_from<t_to)) return;
+
+    // Visit the bins that overlap [t_from, t_to), each at most once.
+    const std::int64_t first = std::int64_t(t_from/width_);
+    const std::int64_t last = std::min<std::int64_t>(
+        std::int64_t(t_to/width_), first+bins_.size()-1);
+
+    for (auto b = first; b<=last; ++b) {
+        auto& bin = bins_[b%bins_.size()];
+        if (bin.t_min>=t_to) continue;
+
+        // Move the events due before t_to to out, and keep the rest, which
+        // belong to later epochs, in the bin.
+        auto& evs = bin.events;
+        auto keep = std::partition(evs.begin(), evs.end(),
+            [t_to](const spike_event& e) { return e.time>=t_to; });
+        out.insert(out.end(), keep, evs.end());
+        size_ -= evs.end()-keep;
+        evs.erase(keep, evs.end());
+
+        bin.t_min = no_time;
+        for (const auto& e: evs) {
+            bin.t_min = std::min(bin.t_min, e.time);
+        }
+    }
+}
+
+void event_calendar::clear() {
+    for (auto& b: bins_) {
+        b.events.clear();
+        b.t_min = no_time;
+    }
+    size_ = 0;
+}
+
+} // namespace arb
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+namespace arb {
+
+// A calendar queue of the pending events of one cell.
+//
+// The events are kept unsorted in a ring of bins of fixed width in time:
+// an event with delivery time t is appended to bin floor(t/width) modulo
+// the number of bins. With the width equal to the length of an epoch, and
+// enough bins to span the largest delay, an event is added in constant
+// time, and the events of an epoch are taken from one or two bins.
+//
+// Events further in the future than the span of the ring share bins with
+// earlier events, and are left in their bin until their time comes.
+class event_calendar {
+public:
+    event_calendar() = default;
+
+    event_calendar(time_type width, unsigned num_bins);
+
+    void push(const spike_event& e) {
+        auto& b = bins_[bin(e.time)];
+        b.events.push_back(e);
+        if (e.time<b.t_min) b.t_min = e.time;
+        ++size_;
+    }
+
+    template <typename Seq>
+    void push(const Seq& events) {
+        for (const auto& e: events) push(e);
+    }
+
+    // Move all events with delivery time before t_to to the end of out,
+    // in no particular order. Events before t_from must already have
+    // been taken.
+    void pop_before(time_type t_from, time_type t_to, pse_vector& out);
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_==0; }
+
+    void clear();
+
+private:
+    static constexpr time_type no_time = std::numeric_limits<time_type>::max();
+
+    struct time_bin {
+        pse_vector events;
+        // Earliest delivery time in the bin, so that bins with only events
+        // of a later epoch can be skipped without a scan.
+        time_type t_min = no_time;
+    };
+
+    std::size_t bin(time_type t) const {
+        return std::int64_t(t/width_)%bins_.size();
+    }
+
+    time_type width_ = 1;
+    std::vector<time_bin> bins_;
+    std::size_t size_ = 0;
+};
+
+} // namespace arb
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/event_generator.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "merge_events.hpp"
+#include "util/philox.hpp"
+
+namespace arb {
+
+namespace {
+    // The time to the next arrival of input i, after count arrivals, in units
+    // of the mean time between arrivals: the counter of the Philox block is
+    // (count, i), so that each input has its own stream.
+    inline double exponential_draw(std::uint64_t seed, std::uint32_t i, std::uint64_t count) {
+        util::philox_key key = {{std::uint32_t(seed), std::uint32_t(seed>>32)}};
+        util::philox_block ctr = {{std::uint32_t(count), std::uint32_t(count>>32), i, 0u}};
+        return -std::log(util::philox_uniform(util::philox4x32(ctr, key)));
+    }
+}
+
+poisson_population_generator::poisson_population_generator(
+    std::vector<input> inputs,
+    std::uint64_t seed,
+    time_type tstart,
+    time_type tstop):
+    seed_(seed), tstart_(tstart), tstop_(tstop)
+{
+    arb_assert(tstart_>=0);
+    arb_assert(inputs.size()<=std::numeric_limits<std::uint32_t>::max());
+
+    for (const auto& in: inputs) {
+        target_.push_back(in.target);
+        weight_.push_back(in.weight);
+        mean_.push_back(in.rate_kHz>0? 1/in.rate_kHz: 0);
+    }
+    reset();
+}
+
+void poisson_population_generator::reset() {
+    const auto n = target_.size();
+    next_.resize(n);
+    count_.assign(n, 1);
+    for (std::uint32_t i=0; i<n; ++i) {
+        // Inputs with zero rate never fire.
+        next_[i] = mean_[i]>0? tstart_+time_type(mean_[i]*exponential_draw(seed_, i, 0)): terminal_time;
+    }
+}
+
+event_seq poisson_population_generator::events(time_type t0, time_type t1) {
+    events_.clear();
+    t1 = std::min(t1, tstop_);
+
+    // Gather the inputs with at least one arrival before t1.
+    active_.clear();
+    for (std::uint32_t i=0; i<next_.size(); ++i) {
+        if (next_[i]<t1) active_.push_back(i);
+    }
+
+    // Each pass over the active inputs emits one arrival per input, draws
+    // the next, and drops the inputs that have no more arrivals before t1.
+    // Arrivals before t0 are drawn but not emitted.
+    while (!active_.empty()) {
+        const auto m = active_.size();
+        events_.reserve(events_.size()+m);
+
+        for (std::size_t k=0; k<m; ++k) {
+            const auto i = active_[k];
+            if (next_[i]>=t0) {
+                events_.push_back({target_[i], next_[i], weight_[i]});
+            }
+        }
+
+        for (std::size_t k=0; k<m; ++k) {
+            const auto i = active_[k];
+            next_[i] += time_type(mean_[i]*exponential_draw(seed_, i, count_[i]++));
+        }
+
+        std::size_t j = 0;
+        for (std::size_t k=0; k<m; ++k) {
+            const auto i = active_[k];
+            active_[j] = i;
+            j += next_[i]<t1;
+        }
+        active_.resize(j);
+    }
+
+    scratch_.resize(events_.size());
+    sort_events(util::make_range(events_.data(), events_.data()+events_.size()), scratch_.data());
+
+    return {events_.data(), events_.data()+events_.size()};
+}
+
+} // namespace arb
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+#include <arbor/util/lexcmp_def.hpp>
+
+#include "backends/event.hpp"
+#include "event_stager.hpp"
+
+namespace arb {
+
+ARB_DEFINE_LEXICOGRAPHIC_ORDERING(arb::target_handle,(a.mech_id,a.mech_index,a.intdom_index),(b.mech_id,b.mech_index,b.intdom_index))
+ARB_DEFINE_LEXICOGRAPHIC_ORDERING(arb::deliverable_event,(a.time,a.handle,a.weight),(b.time,b.handle,b.weight))
+
+event_stager::event_stager(const std::vector<fvm_index_type>& cell_to_intdom) {
+    const auto n = cell_to_intdom.size();
+
+    cells_by_intdom_.resize(n);
+    std::iota(cells_by_intdom_.begin(), cells_by_intdom_.end(), 0);
+    std::stable_sort(cells_by_intdom_.begin(), cells_by_intdom_.end(),
+        [&](cell_size_type a, cell_size_type b) { return cell_to_intdom[a]<cell_to_intdom[b]; });
+
+    intdom_divisions_.assign(1, 0);
+    for (std::size_t k = 1; k<n; ++k) {
+        if (cell_to_intdom[cells_by_intdom_[k]]!=cell_to_intdom[cells_by_intdom_[k-1]]) {
+            intdom_divisions_.push_back(k);
+        }
+    }
+    if (n) intdom_divisions_.push_back(n);
+}
+
+// Merge adjacent pairs of runs, from staged_ to scratch_ and back, until
+// one run is left. std::merge takes equal events from the first run, so
+// that the result is the same as merging the runs one by one in order.
+void event_stager::merge_runs() {
+    if (runs_.size()<=2) return;
+
+    const auto base = runs_.front();
+    for (auto& b: runs_) b -= base;
+    scratch_.resize(runs_.back());
+
+    deliverable_event* src = staged_.data()+base;
+    deliverable_event* dst = scratch_.data();
+
+    while (runs_.size()>2) {
+        const std::size_t r = runs_.size()-1;
+        std::size_t i = 0, j = 0;
+        for (; i+2<=r; i += 2) {
+            std::merge(src+runs_[i], src+runs_[i+1], src+runs_[i+1], src+runs_[i+2], dst+runs_[i]);
+            runs_[j++] = runs_[i];
+        }
+        if (i<r) {
+            std::copy(src+runs_[i], src+runs_[i+1], dst+runs_[i]);
+            runs_[j++] = runs_[i];
+        }
+        runs_[j++] = runs_[r];
+        runs_.resize(j);
+        std::swap(src, dst);
+    }
+
+    if (src!=staged_.data()+base) {
+        std::copy(src, src+runs_.back(), staged_.data()+base);
+    }
+}
+
+} // namespace arb
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "backends/event.hpp"
+#include "cell_group.hpp"
+
+namespace arb {
+
+// Stage the events of the cells of a cell group for delivery to the lowered
+// cell in an epoch.
+//
+// The staged events are ordered by integration domain, and by time within
+// each integration domain: the events of the cells of an integration domain
+// are appended to the buffer one cell at a time, and then merged. The order
+// of the cells by integration domain is fixed at construction, and the
+// buffers are kept between epochs, so that no allocation is required once
+// they have grown to their working size.
+class event_stager {
+public:
+    event_stager() = default;
+
+    // The integration domain of each cell of the group.
+    explicit event_stager(const std::vector<fvm_index_type>& cell_to_intdom);
+
+    // Stage the events of each lane with delivery time before tfinal.
+    // to_event(i, e) gives the deliverable event for the event e of the
+    // lane of cell i; it is called for the events of each lane in order.
+    template <typename F>
+    const std::vector<deliverable_event>& stage(const event_lane_subrange& lanes, time_type tfinal, F&& to_event) {
+        staged_.clear();
+        if (!lanes.size()) return staged_;
+
+        for (std::size_t d = 0; d+1<intdom_divisions_.size(); ++d) {
+            runs_.assign(1, staged_.size());
+            for (auto k = intdom_divisions_[d]; k<intdom_divisions_[d+1]; ++k) {
+                auto cell = cells_by_intdom_[k];
+                for (const auto& e: lanes[cell]) {
+                    if (e.time>=tfinal) break;
+                    staged_.push_back(to_event(cell, e));
+                }
+                if (staged_.size()>runs_.back()) runs_.push_back(staged_.size());
+            }
+            merge_runs();
+        }
+        return staged_;
+    }
+
+    const std::vector<deliverable_event>& events() const { return staged_; }
+
+private:
+    // Merge the sorted runs of staged_ with boundaries runs_.
+    void merge_runs();
+
+    // Cell indices ordered by integration domain, partitioned by
+    // integration domain by intdom_divisions_.
+    std::vector<cell_size_type> cells_by_intdom_;
+    std::vector<std::size_t> intdom_divisions_;
+
+    std::vector<std::size_t> runs_;
+    std::vector<deliverable_event> staged_;
+    std::vector<deliverable_event> scratch_;
+};
+
+} // namespace arb
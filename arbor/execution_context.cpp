@@ -1,11 +1,17 @@
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <arbor/context.hpp>
 
 #include "gpu_context.hpp"
 #include "distributed_context.hpp"
 #include "execution_context.hpp"
+#include "hardware/affinity.hpp"
 #include "threading/threading.hpp"
 
 #ifdef ARB_HAVE_MPI
@@ -14,11 +20,19 @@
 
 namespace arb {
 
+static task_system_handle make_thread_pool(const proc_allocation& resources) {
+    return std::make_shared<threading::task_system>(
+        resources.num_threads, resources.scheduler, hw::place_threads(resources));
+}
+
 execution_context::execution_context(const proc_allocation& resources):
     distributed(make_local_context()),
-    thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
+    thread_pool(make_thread_pool(resources)),
     gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
-                           : std::make_shared<gpu_context>())
+                           : std::make_shared<gpu_context>()),
+    group_scheduling(resources.group_scheduling),
+    exchange(resources.exchange),
+    encoding(resources.encoding)
 {}
 
 context make_context(const proc_allocation& p) {
@@ -28,10 +42,15 @@ context make_context(const proc_allocation& p) {
 #ifdef ARB_HAVE_MPI
 template <>
 execution_context::execution_context(const proc_allocation& resources, MPI_Comm comm):
-    distributed(make_mpi_context(comm)),
-    thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
+    distributed(resources.exchange==spike_exchange::hierarchical?
+        make_mpi_node_context(comm, resources.ranks_per_node):
+        make_mpi_context(comm)),
+    thread_pool(make_thread_pool(resources)),
     gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
-                           : std::make_shared<gpu_context>())
+                           : std::make_shared<gpu_context>()),
+    group_scheduling(resources.group_scheduling),
+    exchange(resources.exchange),
+    encoding(resources.encoding)
 {}
 
 template <>
@@ -44,9 +63,12 @@ execution_context::execution_context(
         const proc_allocation& resources,
         dry_run_info d):
         distributed(make_dry_run_context(d.num_ranks, d.num_cells_per_rank)),
-        thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
+        thread_pool(make_thread_pool(resources)),
         gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
-                               : std::make_shared<gpu_context>())
+                               : std::make_shared<gpu_context>()),
+        group_scheduling(resources.group_scheduling),
+        exchange(resources.exchange),
+        encoding(resources.encoding)
 {}
 
 template <>
@@ -54,6 +76,69 @@ context make_context(const proc_allocation& p, dry_run_info d) {
     return context(new execution_context(p, d), [](execution_context* p){delete p;});
 }
 
+// A domain of a thread context, with the cpus on which the threads of its
+// thread pool are placed.
+struct thread_domain {
+    distributed_context_handle distributed;
+    std::vector<int> placement;
+};
+
+template <>
+execution_context::execution_context(
+        const proc_allocation& resources,
+        thread_domain d):
+        distributed(std::move(d.distributed)),
+        thread_pool(std::make_shared<threading::task_system>(
+            resources.num_threads, resources.scheduler, std::move(d.placement))),
+        gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
+                               : std::make_shared<gpu_context>()),
+        group_scheduling(resources.group_scheduling),
+        exchange(resources.exchange),
+        encoding(resources.encoding)
+{}
+
+void run_thread_domains(const proc_allocation& p, unsigned num_domains,
+                        const std::function<void(const context&)>& f)
+{
+    // Place the threads of all domains together, and give each domain
+    // a consecutive block of them.
+    auto all = p;
+    all.num_threads = p.num_threads*num_domains;
+    auto placement = hw::place_threads(all);
+
+    std::function<void()> abort;
+    auto distributed = make_thread_domain_contexts(num_domains, abort);
+
+    // The first domain to fail aborts the collectives of the others, which
+    // then fail in turn: its exception is the one that is rethrown.
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    // The thread pool of a domain is constructed in the thread of the domain,
+    // which becomes its first thread.
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i<num_domains; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                auto first = placement.begin()+i*p.num_threads;
+                thread_domain d{distributed[i], std::vector<int>(first, first+p.num_threads)};
+                context ctx(new execution_context(p, std::move(d)), [](execution_context* p){delete p;});
+                f(ctx);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                    abort();
+                }
+            }
+        });
+    }
+    for (auto& t: threads) t.join();
+
+    if (error) std::rethrow_exception(error);
+}
+
 std::string distribution_type(const context& ctx) {
     return ctx->distributed->name();
 }
@@ -66,6 +151,10 @@ unsigned num_threads(const context& ctx) {
     return ctx->thread_pool->get_num_threads();
 }
 
+std::vector<int> thread_placement(const context& ctx) {
+    return ctx->thread_pool->placement();
+}
+
 unsigned num_ranks(const context& ctx) {
     return ctx->distributed->size();
 }
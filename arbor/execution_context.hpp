@@ -24,6 +24,13 @@ struct execution_context {
     task_system_handle thread_pool;
     gpu_context_handle gpu;
 
+    // Assignment of cell groups to the threads of thread_pool.
+    cell_group_scheduling group_scheduling = cell_group_scheduling::dynamic;
+
+    // Exchange of spikes between the domains of distributed.
+    spike_exchange exchange = spike_exchange::allgather;
+    spike_encoding encoding = spike_encoding::raw;
+
     execution_context(const proc_allocation& resources = proc_allocation{});
 
     // Use a template for constructing with a specific distributed context.
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+
+#include "affinity.hpp"
+#include "util/strprintf.hpp"
+
+#ifdef __linux__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+extern "C" {
+#include <pthread.h>
+#include <sched.h>
+}
+
+#endif // def __linux__
+
+namespace arb {
+namespace hw {
+
+#ifdef __linux__
+
+namespace {
+bool make_cpu_set(const std::vector<int>& cpus, cpu_set_t& set) {
+    CPU_ZERO(&set);
+    for (int c: cpus) {
+        if (c<0 || c>=CPU_SETSIZE) return false;
+        CPU_SET(c, &set);
+    }
+    return !cpus.empty();
+}
+
+// Read a single integer from a sysfs file, returning -1 on failure.
+int read_sysfs_int(const std::string& path) {
+    std::ifstream f(path);
+    int value = -1;
+    if (!(f >> value)) return -1;
+    return value;
+}
+} // anonymous namespace
+
+std::vector<int> get_affinity() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &set)) {
+        return cpus;
+    }
+    for (int i=0; i<CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &set)) {
+            cpus.push_back(i);
+        }
+    }
+    return cpus;
+}
+
+bool set_affinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    return make_cpu_set(cpus, set) && !pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+bool set_affinity(std::thread& t, const std::vector<int>& cpus) {
+    cpu_set_t set;
+    return make_cpu_set(cpus, set) && !pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &set);
+}
+
+std::vector<cpu_info> cpu_topology(const std::vector<int>& cpus) {
+    std::vector<cpu_info> info;
+    for (int c: cpus) {
+        auto base = util::pprintf("/sys/devices/system/cpu/cpu{}/topology/", c);
+        int package = read_sysfs_int(base+"physical_package_id");
+        int core = read_sysfs_int(base+"core_id");
+        if (package<0 || core<0) {
+            package = 0;
+            core = c;
+        }
+        info.push_back({c, package, core});
+    }
+    return info;
+}
+
+#else // def __linux__
+
+std::vector<int> get_affinity() {
+    return {};
+}
+
+bool set_affinity(const std::vector<int>&) {
+    return false;
+}
+
+bool set_affinity(std::thread&, const std::vector<int>&) {
+    return false;
+}
+
+std::vector<cpu_info> cpu_topology(const std::vector<int>& cpus) {
+    std::vector<cpu_info> info;
+    for (int c: cpus) {
+        info.push_back({c, 0, c});
+    }
+    return info;
+}
+
+#endif // def __linux__
+
+namespace {
+// Order cpus by socket, then core, then logical id.
+bool topology_less(const cpu_info& a, const cpu_info& b) {
+    if (a.package!=b.package) return a.package<b.package;
+    if (a.core!=b.core) return a.core<b.core;
+    return a.id<b.id;
+}
+
+// Scatter order: the sockets take turns, and within each socket the first
+// hardware thread of every core comes before the second, and so on.
+std::vector<int> scatter_order(std::vector<cpu_info> cpus) {
+    std::sort(cpus.begin(), cpus.end(), topology_less);
+
+    // Per socket, the cpus as (sibling rank on their core, position in cpus).
+    std::map<int, std::vector<std::pair<int, int>>> sockets;
+    std::map<std::pair<int, int>, int> num_siblings;
+    for (int i=0; i<(int)cpus.size(); ++i) {
+        auto& c = cpus[i];
+        int rank = num_siblings[{c.package, c.core}]++;
+        sockets[c.package].push_back({rank, i});
+    }
+
+    std::vector<std::vector<int>> per_socket;
+    for (auto& s: sockets) {
+        auto& v = s.second;
+        std::sort(v.begin(), v.end());
+        per_socket.emplace_back();
+        for (auto& c: v) per_socket.back().push_back(cpus[c.second].id);
+    }
+
+    std::vector<int> order;
+    for (std::size_t i=0; order.size()<cpus.size(); ++i) {
+        for (auto& s: per_socket) {
+            if (i<s.size()) order.push_back(s[i]);
+        }
+    }
+    return order;
+}
+} // anonymous namespace
+
+std::vector<int> place_threads(
+    unsigned n,
+    thread_affinity affinity,
+    const std::vector<cpu_info>& available,
+    const std::vector<int>& list)
+{
+    std::vector<int> order;
+    switch (affinity) {
+    case thread_affinity::none:
+        break;
+    case thread_affinity::compact: {
+        auto cpus = available;
+        std::sort(cpus.begin(), cpus.end(), topology_less);
+        for (auto& c: cpus) order.push_back(c.id);
+        break;
+    }
+    case thread_affinity::scatter:
+        order = scatter_order(available);
+        break;
+    case thread_affinity::list:
+        if (list.empty()) {
+            throw arbor_exception("thread affinity list: no cpus given");
+        }
+        for (int c: list) {
+            bool allowed = available.empty() ||
+                std::any_of(available.begin(), available.end(), [c](const cpu_info& a) { return a.id==c; });
+            if (!allowed) {
+                throw arbor_exception(util::pprintf("thread affinity list: cpu {} is not available", c));
+            }
+        }
+        order = list;
+        break;
+    }
+
+    if (order.empty()) {
+        return std::vector<int>(n, -1);
+    }
+
+    std::vector<int> placement;
+    placement.reserve(n);
+    for (unsigned i=0; i<n; ++i) {
+        placement.push_back(order[i%order.size()]);
+    }
+    return placement;
+}
+
+std::vector<int> place_threads(const proc_allocation& resources) {
+    if (resources.affinity==thread_affinity::none) {
+        return std::vector<int>(resources.num_threads, -1);
+    }
+    return place_threads(
+        resources.num_threads,
+        resources.affinity,
+        cpu_topology(get_affinity()),
+        resources.cores);
+}
+
+} // namespace hw
+} // namespace arb
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+#include <arbor/context.hpp>
+
+namespace arb {
+namespace hw {
+
+// Location of a logical processor (cpu) in the machine topology.
+struct cpu_info {
+    int id;       // logical processor id, as used by sched_setaffinity
+    int package;  // physical socket
+    int core;     // physical core within the socket
+};
+
+// Returns the cpus on which the calling thread is allowed to run.
+// Returns an empty vector on error, or if the operation is not supported on
+// the target platform.
+std::vector<int> get_affinity();
+
+// Restrict the calling thread, or thread t, to the cpus in cpus.
+// Returns false on error, or if the operation is not supported on the
+// target platform.
+bool set_affinity(const std::vector<int>& cpus);
+bool set_affinity(std::thread& t, const std::vector<int>& cpus);
+
+// Socket and core of each cpu in cpus. Where the topology can't be
+// determined, each cpu is treated as a separate core of socket 0.
+std::vector<cpu_info> cpu_topology(const std::vector<int>& cpus);
+
+// The cpu for each of n threads under the given affinity policy, or -1 for
+// threads that are not to be pinned.
+//
+// For thread_affinity::compact and scatter, threads are placed on the cpus
+// in available, wrapping around if there are more threads than cpus.
+// For thread_affinity::list, thread i is placed on list[i%list.size()];
+// throws arbor_exception if list is empty or holds a cpu that is not in
+// available (unless available is empty, i.e. the affinity is unknown).
+std::vector<int> place_threads(
+    unsigned n,
+    thread_affinity affinity,
+    const std::vector<cpu_info>& available,
+    const std::vector<int>& list = {});
+
+// Placement of the threads of the thread pool described by resources on the
+// cpus available to the calling thread.
+std::vector<int> place_threads(const proc_allocation& resources);
+
+} // namespace hw
+} // namespace arb
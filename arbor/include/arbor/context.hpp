@@ -1,6 +1,8 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 namespace arb {
 
@@ -13,6 +15,66 @@ struct dry_run_info {
             num_cells_per_rank(cells_per_rank) {}
 };
 
+// Scheduling strategy used by the thread pool of a context.
+enum class task_scheduler {
+    // Tasks are distributed round-robin over per-thread FIFO queues.
+    shared_queue,
+    // Each thread pushes and pops tasks on its own lock-free deque;
+    // idle threads steal tasks from randomly chosen threads.
+    work_stealing
+};
+
+// How a simulation distributes its cell groups over the threads of the
+// thread pool.
+enum class cell_group_scheduling {
+    // Each time the cell groups are updated, the threads take cell groups
+    // in turn from a single list, most expensive first.
+    dynamic,
+    // Each cell group is owned by the thread that constructs it, which
+    // updates it in every epoch; other threads take over cell groups only
+    // when they have run out of their own.
+    sticky
+};
+
+// How the spikes generated on each domain are exchanged between domains at
+// the end of each epoch.
+enum class spike_exchange {
+    // Every spike is sent to every domain.
+    allgather,
+    // Each spike is sent only to the domains with connections from its
+    // source, determined once when the simulation is constructed.
+    sparse,
+    // Every spike is sent to every domain in two levels: the spikes of the
+    // ranks on a node are first gathered in shared memory, and one rank per
+    // node takes part in the exchange between nodes. Only used with MPI.
+    hierarchical
+};
+
+// How the spikes are represented when they are exchanged between domains.
+enum class spike_encoding {
+    // Spikes are sent as they are stored.
+    raw,
+    // Spikes are sent in a compact, variable length, encoding: sources are
+    // delta-encoded and times are stored as offsets from the earliest spike
+    // time. The encoding is lossless.
+    compact
+};
+
+// Placement of the threads of a context's thread pool on the logical
+// processors (cpus) on which the process is allowed to run.
+enum class thread_affinity {
+    // Threads are not pinned; the operating system is free to migrate them.
+    none,
+    // Threads are pinned to consecutive cpus, filling the cores of one
+    // socket before moving to the next.
+    compact,
+    // Threads are spread round-robin over the sockets, and over the physical
+    // cores within a socket before placing two threads on the same core.
+    scatter,
+    // Thread i is pinned to cpu cores[i%cores.size()] of proc_allocation.
+    list
+};
+
 // A description of local computation resources to use in a computation.
 // By default, a proc_allocation will comprise one thread and no GPU.
 
@@ -25,6 +87,23 @@ struct proc_allocation {
     // See CUDA documenation for cudaSetDevice and cudaDeviceGetAttribute.
     int gpu_id;
 
+    task_scheduler scheduler = task_scheduler::shared_queue;
+
+    // Pinning of threads to cpus. The cpu ids in cores are only used with
+    // thread_affinity::list.
+    thread_affinity affinity = thread_affinity::none;
+    std::vector<int> cores;
+
+    cell_group_scheduling group_scheduling = cell_group_scheduling::dynamic;
+
+    spike_exchange exchange = spike_exchange::allgather;
+    spike_encoding encoding = spike_encoding::raw;
+
+    // With spike_exchange::hierarchical, the number of ranks on a node that
+    // are treated as a node, or 0 for all the ranks that share memory. Used to
+    // simulate many nodes on a single machine.
+    unsigned ranks_per_node = 0;
+
     proc_allocation(): proc_allocation(1, -1) {}
 
     proc_allocation(unsigned threads, int gpu):
@@ -61,11 +140,27 @@ context make_context(const proc_allocation& resources = proc_allocation{});
 template <typename Comm>
 context make_context(const proc_allocation& resources, Comm comm);
 
+// Run num_domains domains in the same process, which exchange spikes through
+// shared memory: f is called in a new thread for each domain with the context
+// of the domain, and is expected to build and run the simulation of the
+// domain. The thread that calls f is the first thread of the thread pool of
+// the domain, which has resources.num_threads threads, placed on cpus
+// disjoint from those of the other domains.
+//
+// Returns when f has returned for every domain. If f throws for a domain,
+// the collective operations of the other domains throw arb::arbor_exception,
+// so that they don't wait for it, and the first exception is rethrown.
+void run_thread_domains(const proc_allocation& resources, unsigned num_domains,
+                        const std::function<void(const context&)>& f);
+
 // Queries for properties of execution resources in a context.
 
 std::string distribution_type(const context&);
 bool has_gpu(const context&);
 unsigned num_threads(const context&);
+// The cpu to which each thread of the thread pool is pinned, or -1 for
+// threads that are not pinned.
+std::vector<int> thread_placement(const context&);
 bool has_mpi(const context&);
 unsigned num_ranks(const context&);
 unsigned rank(const context&);
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <memory>
 #include <random>
+#include <vector>
 
 #include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
@@ -51,6 +52,7 @@ namespace arb {
 // Some pre-defined event generators are included:
 //  - `empty_generator`: produces no events
 //  - `schedule_generator`: events to a fixed target according to a time schedule
+//  - `poisson_population_generator`: events from many Poisson inputs to a cell
 
 using event_seq = std::pair<const spike_event*, const spike_event*>;
 
@@ -185,6 +187,59 @@ inline event_generator poisson_generator(
 }
 
 
+// Generate events for a population of independent Poisson processes, each
+// with its own target, weight and rate, active in the interval
+// [tstart, tstop).
+//
+// A single poisson_population_generator for all the Poisson inputs of a
+// cell replaces one poisson_generator per input: the arrivals of all the
+// inputs are drawn together in batches over the active inputs, and sorted
+// once per call to `events`.
+//
+// The random numbers are taken from a counter-based generator, keyed by
+// seed, the index of the input and the number of arrivals of the input so
+// far. The events generated therefore depend only on the seed and the
+// inputs, not on how the simulation time is divided into intervals or the
+// number of threads. Generators on different cells should be given
+// different seeds, for example derived from the gid of the cell.
+
+struct poisson_population_generator {
+    struct input {
+        cell_member_type target;
+        float weight;
+        time_type rate_kHz;
+    };
+
+    poisson_population_generator(
+        std::vector<input> inputs,
+        std::uint64_t seed,
+        time_type tstart = 0,
+        time_type tstop = terminal_time);
+
+    void reset();
+
+    event_seq events(time_type t0, time_type t1);
+
+private:
+    std::uint64_t seed_;
+    time_type tstart_;
+    time_type tstop_;
+
+    // Per-input state.
+    std::vector<cell_member_type> target_;
+    std::vector<float> weight_;
+    std::vector<time_type> mean_;       // Mean time between arrivals.
+    std::vector<time_type> next_;       // Time of the next arrival.
+    std::vector<std::uint64_t> count_;  // Number of arrivals drawn.
+
+    // Working space for the inputs with arrivals in the current interval.
+    std::vector<std::uint32_t> active_;
+
+    pse_vector events_;
+    pse_vector scratch_;
+};
+
+
 // Generate events from a predefined sorted event sequence.
 
 struct explicit_generator {
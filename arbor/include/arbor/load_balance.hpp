@@ -9,6 +9,11 @@ namespace arb {
 struct partition_hint {
     constexpr static std::size_t max_size = -1;
 
+    // Use as cpu_group_size to let partition_load_balance choose the size of
+    // cell groups from the number of threads and the estimated cost and
+    // memory footprint of the cells.
+    constexpr static std::size_t auto_size = -2;
+
     std::size_t cpu_group_size = 1;
     std::size_t gpu_group_size = max_size;
     bool prefer_gpu = true;
@@ -21,4 +26,26 @@ domain_decomposition partition_load_balance(
     const context& ctx,
     partition_hint_map hint_map = {});
 
+// As partition_load_balance, but the gids are divided over the domains in
+// contiguous ranges of about equal total cost, as given by
+// recipe::get_cell_cost, rather than of equal numbers of cells.
+domain_decomposition partition_cost_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map = {});
+
+// As partition_cost_balance, but the cells are assigned to domains by a
+// partition of the graph of the connections between cells, which keeps the
+// number of connections between domains small while balancing the total
+// cost of the cells on each domain. The gid_domain of the result is a
+// table lookup.
+//
+// Every domain builds the whole connection graph from the recipe, so the
+// memory and time required grow with the size of the model, not with the
+// size of the local domain.
+domain_decomposition partition_graph_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map = {});
+
 } // namespace arb
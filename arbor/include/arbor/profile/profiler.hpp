@@ -31,6 +31,11 @@ struct profile {
 
     // the wall time between profile_start() and profile_stop().
     double wall_time;
+
+    // the name and accumulated value of each counter, e.g. the number of
+    // bytes sent in spike exchange.
+    std::vector<std::string> counter_names;
+    std::vector<std::uint64_t> counter_values;
 };
 
 void profiler_clear();
@@ -38,8 +43,11 @@ void profiler_initialize(context& ctx);
 void profiler_enter(std::size_t region_id);
 void profiler_leave();
 
+void profiler_count(std::size_t counter_id, std::uint64_t value);
+
 profile profiler_summary();
 std::size_t profiler_region_id(const char* name);
+std::size_t profiler_counter_id(const char* name);
 
 std::ostream& operator<<(std::ostream&, const profile&);
 
@@ -87,6 +87,15 @@ public:
     // Global property type will be specific to given cell kind.
     virtual util::any get_global_properties(cell_kind) const { return util::any{}; };
 
+    // Relative computational cost of cell gid, used by load balancers to
+    // balance the work between domains. Costs are in units of the update of
+    // one compartment for one time step.
+    // The default estimate is the number of compartments and mechanism
+    // instances for cable cells, and 1 for other cell kinds; it requires the
+    // construction of the cell description, so recipes of large models that
+    // use a cost-based load balancer should provide a cheaper override.
+    virtual double get_cell_cost(cell_gid_type gid) const;
+
     virtual ~recipe() {}
 };
 
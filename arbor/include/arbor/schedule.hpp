@@ -4,6 +4,7 @@
 #include <iterator>
 #include <memory>
 #include <random>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -25,6 +26,32 @@ inline time_event_span as_time_event_span(const std::vector<time_type>& v) {
 // are queried monotonically in time: if two method calls `events(t0, t1)` 
 // and `events(t2, t3)` are made without an intervening call to `reset()`,
 // then 0 ≤ _t0_ ≤ _t1_ ≤ _t2_ ≤ _t3_.
+//
+// `append_events(t0, t1, out)` is equivalent to appending the times of
+// `events(t0, t1)` to `out`, and is subject to the same constraint. Schedule
+// implementations may provide an `append_events` method that writes the
+// times directly to `out`; for those that don't, the times are copied from
+// `events`.
+
+namespace impl {
+    template <typename Impl, typename = void>
+    struct has_append_events: std::false_type {};
+
+    template <typename Impl>
+    struct has_append_events<Impl, decltype(void(std::declval<Impl&>().append_events(
+        time_type{}, time_type{}, std::declval<std::vector<time_type>&>())))>: std::true_type {};
+
+    template <typename Impl>
+    void append_events(Impl& impl, time_type t0, time_type t1, std::vector<time_type>& out, std::true_type) {
+        impl.append_events(t0, t1, out);
+    }
+
+    template <typename Impl>
+    void append_events(Impl& impl, time_type t0, time_type t1, std::vector<time_type>& out, std::false_type) {
+        auto ts = impl.events(t0, t1);
+        out.insert(out.end(), ts.first, ts.second);
+    }
+} // namespace impl
 
 class schedule {
 public:
@@ -53,11 +80,16 @@ public:
         return impl_->events(t0, t1);
     }
 
+    void append_events(time_type t0, time_type t1, std::vector<time_type>& out) {
+        impl_->append_events(t0, t1, out);
+    }
+
     void reset() { impl_->reset(); }
 
 private:
     struct interface {
         virtual time_event_span events(time_type t0, time_type t1) = 0;
+        virtual void append_events(time_type t0, time_type t1, std::vector<time_type>& out) = 0;
         virtual void reset() = 0;
         virtual std::unique_ptr<interface> clone() = 0;
         virtual ~interface() {}
@@ -74,6 +106,10 @@ private:
             return wrapped.events(t0, t1);
         }
 
+        virtual void append_events(time_type t0, time_type t1, std::vector<time_type>& out) {
+            impl::append_events(wrapped, t0, t1, out, impl::has_append_events<Impl>{});
+        }
+
         virtual void reset() {
             wrapped.reset();
         }
@@ -95,10 +131,32 @@ public:
         static time_type no_time;
         return {&no_time, &no_time};
     }
+    void append_events(time_type, time_type, std::vector<time_type>&) {}
 };
 
 inline schedule::schedule(): schedule(empty_schedule{}) {}
 
+// Evaluate a sequence of schedules over the same interval [t0, t1) into one
+// flat buffer: on return, the times of the i-th schedule are
+// times[offsets[i]] to times[offsets[i+1]-1]. times and offsets are
+// overwritten, and keep their capacity between calls.
+
+template <typename Schedules>
+void evaluate_schedules(
+    Schedules&& schedules,
+    time_type t0,
+    time_type t1,
+    std::vector<time_type>& times,
+    std::vector<std::size_t>& offsets)
+{
+    times.clear();
+    offsets.assign(1, 0);
+    for (schedule& s: schedules) {
+        s.append_events(t0, t1, times);
+        offsets.push_back(times.size());
+    }
+}
+
 // Common schedules
 
 // Schedule at k·dt for integral k≥0 within the interval [t0, t1).
@@ -112,8 +170,12 @@ public:
 
     void reset() {}
     time_event_span events(time_type t0, time_type t1);
+    void append_events(time_type t0, time_type t1, std::vector<time_type>& out);
 
 private:
+    // The least n with n·dt ≥ t.
+    long long first_index(time_type t) const;
+
     time_type t0_, t1_, dt_;
     time_type oodt_;
 
@@ -190,17 +252,19 @@ public:
 
     time_event_span events(time_type t0, time_type t1) {
         times_.clear();
+        append_events(t0, t1, times_);
+        return as_time_event_span(times_);
+    }
 
+    void append_events(time_type t0, time_type t1, std::vector<time_type>& out) {
         while (next_<t0) {
             step();
         }
 
         while (next_<t1) {
-            times_.push_back(next_);
+            out.push_back(next_);
             step();
         }
-
-        return as_time_event_span(times_);
     }
 
 private:
@@ -18,6 +18,16 @@ namespace arb {
 
 using spike_export_function = std::function<void(const std::vector<spike>&)>;
 
+// How the pending events of each cell are kept between epochs.
+enum class event_lane_kind {
+    // A sorted list of all pending events, into which the new events of
+    // each epoch are merged.
+    sorted,
+    // A calendar queue of time bins one epoch wide: new events are appended
+    // to their bin, and only the events of the next epoch are sorted.
+    calendar
+};
+
 // simulation_state comprises private implementation for simulation class.
 class simulation_state;
 
@@ -39,8 +49,40 @@ public:
 
     void remove_all_samplers();
 
+    // The number of spikes generated on all domains since construction or
+    // reset. With spike_exchange::sparse, the spikes of each call to run
+    // are counted only when it returns, so the count is exact only between
+    // calls to run.
     std::size_t num_spikes() const;
 
+    // Wall time in seconds taken by each cell group to advance in the most
+    // recent epoch, indexed as the groups of the domain decomposition.
+    // Cell groups are scheduled in decreasing order of this cost.
+    std::vector<double> cell_group_costs() const;
+
+    // With sticky cell group scheduling, the thread that owns each cell
+    // group, indexed as the groups of the domain decomposition; 0 for every
+    // group otherwise.
+    std::vector<int> cell_group_threads() const;
+
+    // Rebalance the cell groups over the threads at the first epoch boundary
+    // after every interval of model time (disabled if zero, the default).
+    // With sticky cell group scheduling, cell groups are reassigned to
+    // threads by their total advance time since the last rebalance, if the
+    // threads are unbalanced. Cells are not moved between cell groups or
+    // domains: the imbalance between domains is only measured.
+    void set_thread_rebalance_interval(time_type interval);
+
+    // Ratio of the largest to the mean total advance time of the cell groups
+    // of each domain, measured at the last rebalance; 1 if balanced, or if
+    // no rebalance has taken place.
+    double domain_load_imbalance() const;
+
+    // Choose how pending events are kept (event_lane_kind::sorted by
+    // default). Must be called before the simulation is run, or after
+    // reset; throws arbor_exception otherwise.
+    void set_event_lane_kind(event_lane_kind kind);
+
     // Set event binning policy on all our groups.
     void set_binning_policy(binning_kind policy, time_type bin_interval);
 
@@ -82,6 +82,10 @@ public:
         return tiled_recipe_->get_global_properties(ck);
     };
 
+    double get_cell_cost(cell_gid_type i) const override {
+        return tiled_recipe_->get_cell_cost(i % tiled_recipe_->num_cells());
+    }
+
     std::unique_ptr<tile> tiled_recipe_;
 };
 } // namespace arb
@@ -20,12 +20,10 @@
 #include "util/partition.hpp"
 #include "util/range.hpp"
 #include "util/span.hpp"
+#include "util/transform.hpp"
 
 namespace arb {
 
-ARB_DEFINE_LEXICOGRAPHIC_ORDERING(arb::target_handle,(a.mech_id,a.mech_index,a.intdom_index),(b.mech_id,b.mech_index,b.intdom_index))
-ARB_DEFINE_LEXICOGRAPHIC_ORDERING(arb::deliverable_event,(a.time,a.handle,a.weight),(b.time,b.handle,b.weight))
-
 mc_cell_group::mc_cell_group(const std::vector<cell_gid_type>& gids, const recipe& rec, fvm_lowered_cell_ptr lowered):
     gids_(gids), lowered_(std::move(lowered))
 {
@@ -50,6 +48,9 @@ mc_cell_group::mc_cell_group(const std::vector<cell_gid_type>& gids, const recip
     // Construct cell implementation, retrieving handles and maps. 
     lowered_->initialize(gids_, rec, cell_to_intdom_, target_handles_, probe_map_);
 
+    // The order of the cells by integration domain is fixed.
+    event_stager_ = event_stager(cell_to_intdom_);
+
     // Create a list of the global identifiers for the spike sources
     for (auto source_gid: gids_) {
         for (cell_lid_type lid = 0; lid<rec.num_sources(source_gid); ++lid) {
@@ -83,49 +84,13 @@ void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& e
     time_type tstart = lowered_->time();
 
     PE(advance_eventsetup);
-    staged_events_.clear();
-
-    fvm_index_type ev_begin = 0, ev_mid = 0, ev_end = 0;
-    // skip event binning if empty lanes are passed
-    if (event_lanes.size()) {
-
-        std::vector<cell_size_type> idx_sorted_by_intdom(cell_to_intdom_.size());
-        std::iota(idx_sorted_by_intdom.begin(), idx_sorted_by_intdom.end(), 0);
-        util::sort_by(idx_sorted_by_intdom, [&](cell_size_type i) { return cell_to_intdom_[i]; });
-
-        /// Event merging on integration domain could benefit from the use of the logic from `tree_merge_events`
-        fvm_index_type prev_intdom = -1;
-        for (auto i: util::count_along(gids_)) {
-            unsigned count_staged = 0;
-
-            auto lid = idx_sorted_by_intdom[i];
-            auto& lane = event_lanes[lid];
-            auto curr_intdom = cell_to_intdom_[lid];
-
-            for (auto e: lane) {
-                if (e.time>=ep.tfinal) break;
-                e.time = binners_[lid].bin(e.time, tstart);
-                auto h = target_handles_[target_handle_divisions_[lid]+e.target.index];
-                auto ev = deliverable_event(e.time, h, e.weight);
-                staged_events_.push_back(ev);
-                count_staged++;
-            }
-
-            ev_end += count_staged;
-
-            if (curr_intdom != prev_intdom) {
-                ev_begin = ev_end - count_staged;
-                prev_intdom = curr_intdom;
-            }
-            else {
-                std::inplace_merge(staged_events_.begin() + ev_begin,
-                                   staged_events_.begin() + ev_mid,
-                                   staged_events_.begin() + ev_end);
-            }
-
-            ev_mid = ev_end;
-        }
-    }
+    // Events are binned and mapped to their target handles in lane order,
+    // and merged by integration domain by the stager.
+    const auto& staged_events = event_stager_.stage(event_lanes, ep.tfinal,
+        [&](cell_size_type lid, const spike_event& e) {
+            auto h = target_handles_[target_handle_divisions_[lid]+e.target.index];
+            return deliverable_event(binners_[lid].bin(e.time, tstart), h, e.weight);
+        });
     PL();
 
 
@@ -139,28 +104,27 @@ void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& e
     // Each event is associated with an offset into the sample data and
     // time buffers; these are assigned contiguously such that one call to
     // a sampler callback can be represented by a `sampler_call_info`
-    // value as defined below, grouping together all the samples of the
+    // value as defined in the class, grouping together all the samples of the
     // same probe for this callback in this association.
 
-    struct sampler_call_info {
-        sampler_function sampler;
-        cell_member_type probe_id;
-        probe_tag tag;
-
-        // Offsets are into lowered cell sample time and event arrays.
-        sample_size_type begin_offset;
-        sample_size_type end_offset;
-    };
-
     PE(advance_samplesetup);
-    std::vector<sampler_call_info> call_info;
-
-    std::vector<sample_event> sample_events;
+    call_info_.clear();
+    sample_events_.clear();
     sample_size_type n_samples = 0;
     sample_size_type max_samples_per_call = 0;
 
+    // The schedules of all the associations are evaluated together: the
+    // sample times of the k-th association are then the k-th partition of
+    // sample_times_ by sample_time_offsets_.
+    evaluate_schedules(
+        util::transform_view(sampler_map_, [](sampler_association& sa) -> schedule& { return sa.sched; }),
+        tstart, ep.tfinal, sample_times_, sample_time_offsets_);
+
+    auto sample_time_parts = util::partition_view(sample_time_offsets_);
+    std::size_t k = 0;
     for (auto& sa: sampler_map_) {
-        auto sample_times = util::make_range(sa.sched.events(tstart, ep.tfinal));
+        auto part = sample_time_parts[k++];
+        auto sample_times = util::make_range(sample_times_.data()+part.first, sample_times_.data()+part.second);
         if (sample_times.empty()) {
             continue;
         }
@@ -172,37 +136,36 @@ void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& e
             auto cell_index = gid_index_map_.at(pid.gid);
             auto p = probe_map_[pid];
 
-            call_info.push_back({sa.sampler, pid, p.tag, n_samples, n_samples+n_times});
+            call_info_.push_back({sa.sampler, pid, p.tag, n_samples, n_samples+n_times});
 
             for (auto t: sample_times) {
                 sample_event ev{t, (cell_gid_type)cell_to_intdom_[cell_index], {p.handle, n_samples++}};
-                sample_events.push_back(ev);
+                sample_events_.push_back(ev);
             }
         }
     }
 
     // Sample events must be ordered by time for the lowered cell.
-    util::sort_by(sample_events, [](const sample_event& ev) { return event_time(ev); });
+    util::sort_by(sample_events_, [](const sample_event& ev) { return event_time(ev); });
     PL();
 
     // Run integration and collect samples, spikes.
-    auto result = lowered_->integrate(ep.tfinal, dt, staged_events_, std::move(sample_events));
+    auto result = lowered_->integrate(ep.tfinal, dt, staged_events, sample_events_);
 
-    // For each sampler callback registered in `call_info`, construct the
+    // For each sampler callback registered in `call_info_`, construct the
     // vector of sample entries from the lowered cell sample times and values
     // and then call the callback.
 
     PE(advance_sampledeliver);
-    std::vector<sample_record> sample_records;
-    sample_records.reserve(max_samples_per_call);
+    sample_records_.reserve(max_samples_per_call);
 
-    for (auto& sc: call_info) {
-        sample_records.clear();
+    for (auto& sc: call_info_) {
+        sample_records_.clear();
         for (auto i = sc.begin_offset; i!=sc.end_offset; ++i) {
-           sample_records.push_back(sample_record{time_type(result.sample_time[i]), &result.sample_value[i]});
+           sample_records_.push_back(sample_record{time_type(result.sample_time[i]), &result.sample_value[i]});
         }
 
-        sc.sampler(sc.probe_id, sc.tag, sc.end_offset-sc.begin_offset, sample_records.data());
+        sc.sampler(sc.probe_id, sc.tag, sc.end_offset-sc.begin_offset, sample_records_.data());
     }
     PL();
 
@@ -15,7 +15,7 @@
 #include "cell_group.hpp"
 #include "epoch.hpp"
 #include "event_binner.hpp"
-#include "event_queue.hpp"
+#include "event_stager.hpp"
 #include "fvm_lowered_cell.hpp"
 #include "profile/profiler_macro.hpp"
 #include "sampler_map.hpp"
@@ -79,11 +79,24 @@ private:
     // Event time binning manager.
     std::vector<event_binner> binners_;
 
-    // List of events to deliver
-    std::vector<deliverable_event> staged_events_;
+    // Staging of the events to deliver in each epoch.
+    event_stager event_stager_;
 
-    // Pending samples to be taken.
-    event_queue<sample_event> sample_events_;
+    // Sample events of the current epoch, and the sampler callbacks to
+    // which their values are delivered.
+    struct sampler_call_info {
+        sampler_function sampler;
+        cell_member_type probe_id;
+        probe_tag tag;
+
+        // Offsets are into lowered cell sample time and event arrays.
+        sample_size_type begin_offset;
+        sample_size_type end_offset;
+    };
+
+    std::vector<sample_event> sample_events_;
+    std::vector<sampler_call_info> call_info_;
+    std::vector<sample_record> sample_records_;
 
     // Handles for accessing lowered cell.
     std::vector<target_handle> target_handles_;
@@ -94,6 +107,11 @@ private:
     // Collection of samplers to be run against probes in this group.
     sampler_association_map sampler_map_;
 
+    // Sample times of the associations in sampler_map_ in the current epoch,
+    // partitioned by association.
+    std::vector<time_type> sample_times_;
+    std::vector<std::size_t> sample_time_offsets_;
+
     // Lookup table for target ids -> local target handle indices.
     std::vector<std::size_t> target_handle_divisions_;
 };
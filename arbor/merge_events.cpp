@@ -1,10 +1,11 @@
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
-#include <set>
+#include <limits>
 #include <vector>
 
 #include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
-#include <arbor/math.hpp>
 
 #include "io/trace.hpp"
 #include "merge_events.hpp"
@@ -14,143 +15,230 @@ namespace arb {
 
 namespace impl {
 
-// A postsynaptic spike event that has delivery time set to
-// terminal_time, used as a sentinel in `tourney_tree`.
-
-static constexpr spike_event terminal_pse{cell_member_type{0,0}, terminal_time, 0};
-
-
-// The tournament tree data structure is used to merge k sorted lists of events.
-// See online for high-level information about tournament trees.
+// A sentinel that compares greater than any event that is not itself at
+// terminal_time, used for exhausted sequences in `loser_tree`.
+static constexpr spike_event terminal_pse{
+    cell_member_type{cell_gid_type(-1), cell_lid_type(-1)},
+    terminal_time,
+    std::numeric_limits<float>::infinity()};
+
+// The loser tree is a tournament tree in which each internal node holds the
+// loser of the match played there, and the overall winner is kept apart.
+// When the winner is popped, the next event of its sequence replays only the
+// matches on the path from its leaf to the root, against the losers stored
+// there, with one comparison per level and no need to look at the siblings.
 //
-// This implementation maintains a heap-like data structure, with entries of type:
-//      std::pair<unsigned, post_synaptic_event>
-// where the unsigned ∈ [0, k-1] is the id of the list from which the event was
-// drawn. The id is stored so that the operation of removing the most recent event
-// knows which leaf node needs to be updated (i.e. the leaf node of the list from
-// which the most recent event was drawn).
-//
-// unsigned is used for storing the index, because if drawing events from more
-// event generators than can be counted using an unsigned a complete redesign
-// will be needed.
-
-tourney_tree::tourney_tree(std::vector<event_span>& input):
-    input_(input),
-    n_lanes_(input_.size())
+// The nodes store indexes into the input sequences only. The matches are
+// decided by the delivery times of the heads of the sequences, which are
+// kept contiguously in keys_, and only ties look at the whole events. The
+// outcome of each match is applied with conditional moves rather than
+// branches, which are mispredicted half the time when the sequences
+// interleave.
+
+loser_tree::loser_tree(std::vector<event_span>& input):
+    input_(input)
 {
-    // Must have at least 1 queue.
-    arb_assert(n_lanes_>=1u);
-
-    leaves_ = math::next_pow2(n_lanes_);
-
-    // Must be able to fit leaves in unsigned count.
-    arb_assert(leaves_>=n_lanes_);
-    nodes_ = 2*leaves_-1;
-
-    // Allocate space for the tree nodes
-    heap_.resize(nodes_);
-    // Set the leaf nodes
-    for (auto i=0u; i<leaves_; ++i) {
-        heap_[leaf(i)] = i<n_lanes_?
-            key_val(i, input[i].empty()? terminal_pse: input[i].front()):
-            key_val(i, terminal_pse); // null leaf node
+    const unsigned n = input_.size();
+    // Must have at least 1 sequence.
+    arb_assert(n>=1u);
+
+    heads_.reserve(n);
+    keys_.reserve(n);
+    for (auto& in: input_) {
+        heads_.push_back(in.empty()? terminal_pse: in.front());
+        keys_.push_back(heads_.back().time);
+        remaining_ += in.size();
     }
-    // Walk the tree to initialize the non-leaf nodes
-    setup(0);
-}
 
-std::ostream& operator<<(std::ostream& out, const tourney_tree& tt) {
-    unsigned nxt = 1;
-    for (unsigned i = 0; i<tt.nodes_; ++i) {
-        if (i==nxt-1) {
-            nxt*=2;
-            out << "\n";
-        }
-        out << "{" << tt.heap_[i].first << "," << tt.heap_[i].second << "}\n";
+    // Play the initial tournament bottom-up, recording the winner of each
+    // match in winners and the loser in losers_.
+    std::vector<unsigned> winners(2*n);
+    losers_.resize(n);
+    for (unsigned i=0; i<n; ++i) {
+        winners[n+i] = i;
     }
-    return out;
+    for (unsigned i=n-1; i>0; --i) {
+        auto l = winners[2*i];
+        auto r = winners[2*i+1];
+        bool right_wins = before(r, l);
+        winners[i] = right_wins? r: l;
+        losers_[i] = right_wins? l: r;
+    }
+    winner_ = winners[1];
 }
 
-bool tourney_tree::empty() const {
-    return event(0).time == terminal_time;
+void loser_tree::pop() {
+    const unsigned n = input_.size();
+    auto& in = input_[winner_];
+    ++in.left;
+    --remaining_;
+    heads_[winner_] = in.empty()? terminal_pse: in.front();
+    keys_[winner_] = heads_[winner_].time;
+
+    // Replay the matches from the leaf of the winner to the root.
+    unsigned w = winner_;
+    for (unsigned i=(n+winner_)/2; i>0; i/=2) {
+        const auto l = losers_[i];
+        const bool swap = before(l, w);
+        losers_[i] = swap? w: l;
+        w = swap? l: w;
+    }
+    winner_ = w;
 }
 
-spike_event tourney_tree::head() const {
-    return event(0);
+std::ostream& operator<<(std::ostream& out, const loser_tree& t) {
+    out << "winner {" << t.winner_ << "," << t.heads_[t.winner_] << "}\n";
+    for (unsigned i=1; i<t.losers_.size(); ++i) {
+        out << "{" << t.losers_[i] << "," << t.heads_[t.losers_[i]] << "}\n";
+    }
+    return out;
 }
 
-// Remove the smallest (most recent) event from the tree, then update the
-// tree so that head() returns the next event.
-void tourney_tree::pop() {
-    unsigned lane = id(0);
-    unsigned i = leaf(lane);
+} // namespace impl
 
-    // draw the next event from the input lane
-    auto& in = input_[lane];
+namespace {
+// Merge two sorted sequences into out, with the choice of the next event
+// made by arithmetic on the comparison rather than a branch.
+spike_event* merge_two(event_span a, event_span b, spike_event* out) {
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i!=a.end() && j!=b.end()) {
+        const bool take_b = *j<*i;
+        *out++ = take_b? *j: *i;
+        i += !take_b;
+        j += take_b;
+    }
+    out = std::copy(i, a.end(), out);
+    return std::copy(j, b.end(), out);
+}
 
-    if (!in.empty()) {
-        ++in.left;
+// Merge the sources in rounds of two-way merges, each of which halves the
+// number of sequences, until the last round merges two sequences into dest.
+// The rounds alternate between two scratch buffers.
+void merge_cascade(std::vector<event_span>& sources, spike_event* dest) {
+    thread_local pse_vector buffers[2];
+
+    std::size_t total = 0;
+    for (auto& s: sources) total += s.size();
+
+    for (unsigned round=0; sources.size()>2; ++round) {
+        auto& buf = buffers[round%2];
+        buf.resize(total);
+        auto out = buf.data();
+
+        const auto k = sources.size();
+        for (std::size_t i=0; i<k/2; ++i) {
+            auto first = out;
+            out = merge_two(sources[2*i], sources[2*i+1], out);
+            sources[i] = {first, out};
+        }
+        if (k%2) {
+            auto first = out;
+            out = std::copy(sources[k-1].begin(), sources[k-1].end(), out);
+            sources[k/2] = {first, out};
+        }
+        sources.resize((k+1)/2);
     }
+    merge_two(sources[0], sources.size()>1? sources[1]: event_span{}, dest);
+}
+} // anonymous namespace
+
+void tree_merge_events(std::vector<event_span>& sources, pse_vector& out) {
+    sources.erase(
+        std::remove_if(sources.begin(), sources.end(), [](const event_span& s) { return s.empty(); }),
+        sources.end());
 
-    event(i) = in.empty()? terminal_pse: in.front();
+    std::size_t total = 0;
+    for (auto& s: sources) total += s.size();
 
-    // re-heapify the tree with a single walk from leaf to root
-    while ((i=parent(i))) {
-        merge_up(i);
+    const auto n = out.size();
+    out.resize(n+total);
+    spike_event* dest = out.data()+n;
+
+    if (sources.empty()) return;
+    if (sources.size()<=merge_cascade_max) {
+        merge_cascade(sources, dest);
+    }
+    else {
+        impl::loser_tree tree(sources);
+        while (!tree.empty()) {
+            *dest++ = tree.head();
+            tree.pop();
+        }
     }
-    merge_up(0); // handle the root
 }
 
-void tourney_tree::setup(unsigned i) {
-    if (is_leaf(i)) return;
-    setup(left(i));
-    setup(right(i));
-    merge_up(i);
-};
-
-// Update the value at node i of the tree to be the smallest
-// of its left and right children.
-// The result is undefined for leaf nodes.
-void tourney_tree::merge_up(unsigned i) {
-    const auto l = left(i);
-    const auto r = right(i);
-    heap_[i] = event(l)<event(r)? heap_[l]: heap_[r];
-}
+// The delivery times of the events in a lane lie in a window bounded by the
+// largest delay in the network, so the times are quantized to 32 bits over
+// the range of times in the lane, and sorted by four passes of 8 bits each.
+// Passes in which all the events have the same digit are skipped.
+//
+// The quantization is monotonic, so only events with equal keys can be out
+// of order after the radix sort: these runs, which are typically short, are
+// then sorted with the full comparison of spike_event.
+void sort_events(util::range<spike_event*> events, spike_event* scratch) {
+    const std::size_t n = events.size();
+    if (n<radix_sort_threshold) {
+        std::sort(events.begin(), events.end());
+        return;
+    }
 
-// The tree is stored using the standard heap indexing scheme.
+    auto minmax = std::minmax_element(events.begin(), events.end(),
+        [](const spike_event& l, const spike_event& r) { return l.time<r.time; });
+    const double t0 = minmax.first->time;
+    const double range = minmax.second->time-t0;
+    if (!(range>0)) {
+        std::sort(events.begin(), events.end());
+        return;
+    }
 
-unsigned tourney_tree::parent(unsigned i) const {
-    return (i-1)>>1;
-}
-unsigned tourney_tree::left(unsigned i) const {
-    return (i<<1) + 1;
-}
-unsigned tourney_tree::right(unsigned i) const {
-    return left(i)+1;
-}
-unsigned tourney_tree::leaf(unsigned i) const {
-    return i+leaves_-1;
-}
-bool tourney_tree::is_leaf(unsigned i) const {
-    return i>=leaves_-1;
-}
-const unsigned& tourney_tree::id(unsigned i) const {
-    return heap_[i].first;
-}
-spike_event& tourney_tree::event(unsigned i) {
-    return heap_[i].second;
-}
-const spike_event& tourney_tree::event(unsigned i) const {
-    return heap_[i].second;
-}
+    // Scale to a little under 2^32, so that rounding can't overflow the key.
+    const double scale = 4294967040./range;
+    auto key = [t0, scale](const spike_event& e) {
+        return std::uint32_t((e.time-t0)*scale);
+    };
+
+    std::uint32_t count[4][256] = {};
+    for (const auto& e: events) {
+        auto k = key(e);
+        ++count[0][k&255];
+        ++count[1][(k>>8)&255];
+        ++count[2][(k>>16)&255];
+        ++count[3][k>>24];
+    }
 
-} // namespace impl
+    spike_event* src = events.begin();
+    spike_event* dst = scratch;
+    for (unsigned pass=0; pass<4; ++pass) {
+        auto& c = count[pass];
+        const unsigned shift = 8*pass;
+        if (c[(key(*src)>>shift)&255]==n) continue;
+
+        std::uint32_t offset = 0;
+        for (auto& x: c) {
+            auto m = x;
+            x = offset;
+            offset += m;
+        }
+        for (auto e = src; e!=src+n; ++e) {
+            dst[c[(key(*e)>>shift)&255]++] = *e;
+        }
+        std::swap(src, dst);
+    }
+    if (src!=events.begin()) {
+        std::copy(src, src+n, events.begin());
+    }
 
-void tree_merge_events(std::vector<event_span>& sources, pse_vector& out) {
-    impl::tourney_tree tree(sources);
-    while (!tree.empty()) {
-        out.push_back(tree.head());
-        tree.pop();
+    // Order runs of events with equal keys.
+    auto first = events.begin();
+    while (first!=events.end()) {
+        auto k = key(*first);
+        auto last = first+1;
+        while (last!=events.end() && key(*last)==k) ++last;
+        if (last-first>1) {
+            std::sort(first, last);
+        }
+        first = last;
     }
 }
 
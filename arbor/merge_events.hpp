@@ -15,42 +15,56 @@ namespace arb {
 
 using event_span = util::range<const spike_event*>;
 
+// Append the events of sources to out, in order.
+//
+// Empty sources are removed. Up to merge_cascade_max sources are merged by
+// a cascade of branch-free two-way merges, and more with a loser tree.
+// The contents of sources are unspecified on return.
+constexpr std::size_t merge_cascade_max = 512;
+
 void tree_merge_events(std::vector<event_span>& sources, pse_vector& out);
 
-namespace impl {
-    // The tournament tree is used internally by the merge_events method, and
-    // it is not intended for use elsewhere. It is exposed here for unit testing
-    // of its functionality.
-    class tourney_tree {
-        using key_val = std::pair<unsigned, spike_event>;
+// Sort events in the same order as std::sort.
+//
+// Lanes with at least radix_sort_threshold events are sorted with an LSD
+// radix sort on delivery times quantized to 32 bits over the range of times
+// in the lane, followed by a comparison sort of each run of events with
+// equal keys; shorter lanes use std::sort. scratch must point to storage
+// for at least events.size() events.
+constexpr std::size_t radix_sort_threshold = 64;
+
+void sort_events(util::range<spike_event*> events, spike_event* scratch);
 
+namespace impl {
+    // The loser tree is used internally by tree_merge_events to merge three or
+    // more sequences, and it is not intended for use elsewhere. It is exposed
+    // here for unit testing of its functionality.
+    class loser_tree {
     public:
-        tourney_tree(std::vector<event_span>& input);
-        bool empty() const;
-        spike_event head() const;
+        loser_tree(std::vector<event_span>& input);
+        bool empty() const { return remaining_==0; }
+        const spike_event& head() const { return heads_[winner_]; }
         void pop();
-        friend std::ostream& operator<<(std::ostream&, const tourney_tree&);
+        friend std::ostream& operator<<(std::ostream&, const loser_tree&);
 
     private:
-        void setup(unsigned i);
-        void merge_up(unsigned i);
-        void update_lane(unsigned lane);
-        unsigned parent(unsigned i) const;
-        unsigned left(unsigned i) const;
-        unsigned right(unsigned i) const;
-        unsigned leaf(unsigned i) const;
-        bool is_leaf(unsigned i) const;
-        const unsigned& id(unsigned i) const;
-        spike_event& event(unsigned i);
-        const spike_event& event(unsigned i) const;
-        unsigned next_power_2(unsigned x) const;
-
-        std::vector<key_val> heap_;
+        // Whether the head of sequence a comes before that of sequence b.
+        bool before(unsigned a, unsigned b) const {
+            if (keys_[a]!=keys_[b]) return keys_[a]<keys_[b];
+            return heads_[a]<heads_[b];
+        }
+
         std::vector<event_span>& input_;
-        unsigned leaves_;
-        unsigned nodes_;
-        unsigned n_lanes_;
+        // The head of each input sequence, or a sentinel once it is exhausted.
+        std::vector<spike_event> heads_;
+        // The delivery time of each head, which decides almost every match.
+        std::vector<time_type> keys_;
+        // The loser of the match at each internal node, as an index into
+        // input_. Node i has children 2i and 2i+1, and the leaf of input
+        // sequence j is node n+j, where n is the number of sequences.
+        std::vector<unsigned> losers_;
+        unsigned winner_ = 0;
+        std::size_t remaining_ = 0;
     };
 }
-
 } // namespace arb
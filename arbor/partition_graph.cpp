@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "partition_graph.hpp"
+
+namespace arb {
+
+namespace {
+using weighted_edge = std::tuple<cell_size_type, cell_size_type, double>;
+
+// Build the graph with vertex weights vw from edges, which hold each edge in
+// both directions; parallel edges are merged by summing their weights.
+weighted_graph make_csr_graph(std::vector<double> vw, std::vector<weighted_edge> edges) {
+    weighted_graph g;
+    g.vertex_weights = std::move(vw);
+    const auto n = g.size();
+
+    std::sort(edges.begin(), edges.end());
+
+    g.offsets.assign(n+1, 0);
+    for (std::size_t i = 0; i<edges.size(); ++i) {
+        cell_size_type u, v;
+        double w;
+        std::tie(u, v, w) = edges[i];
+        if (i && u==std::get<0>(edges[i-1]) && v==std::get<1>(edges[i-1])) {
+            g.edge_weights.back() += w;
+            continue;
+        }
+        g.adjacency.push_back(v);
+        g.edge_weights.push_back(w);
+        ++g.offsets[u+1];
+    }
+    std::partial_sum(g.offsets.begin(), g.offsets.end(), g.offsets.begin());
+
+    return g;
+}
+
+// Accumulates the edge weight from a vertex to each label (cluster or
+// part) of its neighbours; the weight of all other labels is zero. Only the
+// labels of the last gather are reset, so each gather is linear in the
+// degree of the vertex.
+struct label_connections {
+    std::vector<double> weight;
+    std::vector<char> seen;
+    std::vector<unsigned> labels;
+
+    explicit label_connections(std::size_t num_labels):
+        weight(num_labels, 0), seen(num_labels, 0)
+    {}
+
+    template <typename Label>
+    void gather(const weighted_graph& g, cell_size_type v, const Label& label) {
+        for (auto l: labels) {
+            weight[l] = 0;
+            seen[l] = 0;
+        }
+        labels.clear();
+        for (auto e = g.offsets[v]; e<g.offsets[v+1]; ++e) {
+            const unsigned l = label(g.adjacency[e]);
+            if (!seen[l]) {
+                seen[l] = 1;
+                labels.push_back(l);
+            }
+            weight[l] += g.edge_weights[e];
+        }
+    }
+};
+
+// Size-constrained label propagation clustering: each vertex in turn joins
+// the cluster of its neighbours to which it has the most edge weight, if
+// the weight of the cluster stays below max_weight. Returns the cluster of
+// each vertex, with clusters numbered in order of their first vertex, and
+// the number of clusters.
+std::pair<std::vector<cell_size_type>, cell_size_type>
+cluster_graph(const weighted_graph& g, double max_weight, unsigned passes) {
+    const auto n = g.size();
+    std::vector<cell_size_type> cluster(n);
+    std::iota(cluster.begin(), cluster.end(), 0);
+    std::vector<double> cluster_weight = g.vertex_weights;
+
+    label_connections conn(n);
+    for (unsigned pass = 0; pass<passes; ++pass) {
+        std::size_t moved = 0;
+        for (cell_size_type v = 0; v<n; ++v) {
+            const auto c = cluster[v];
+            const double w = g.vertex_weights[v];
+            conn.gather(g, v, [&](cell_size_type u) { return cluster[u]; });
+
+            auto best = c;
+            for (auto l: conn.labels) {
+                if (l==c || cluster_weight[l]+w>max_weight) continue;
+                if (conn.weight[l]>conn.weight[best]) best = l;
+            }
+            if (best!=c) {
+                cluster_weight[c] -= w;
+                cluster_weight[best] += w;
+                cluster[v] = best;
+                ++moved;
+            }
+        }
+        if (!moved) break;
+    }
+
+    std::vector<cell_size_type> index(n, n);
+    cell_size_type num_clusters = 0;
+    for (auto& c: cluster) {
+        if (index[c]==n) index[c] = num_clusters++;
+        c = index[c];
+    }
+    return {std::move(cluster), num_clusters};
+}
+
+// The graph with a vertex for each cluster of g.
+weighted_graph contract_graph(const weighted_graph& g, const std::vector<cell_size_type>& cluster, cell_size_type num_clusters) {
+    std::vector<double> vw(num_clusters, 0);
+    std::vector<weighted_edge> edges;
+    for (cell_size_type v = 0; v<g.size(); ++v) {
+        vw[cluster[v]] += g.vertex_weights[v];
+        for (auto e = g.offsets[v]; e<g.offsets[v+1]; ++e) {
+            auto cu = cluster[v];
+            auto cv = cluster[g.adjacency[e]];
+            if (cu!=cv) edges.emplace_back(cu, cv, g.edge_weights[e]);
+        }
+    }
+    return make_csr_graph(std::move(vw), std::move(edges));
+}
+
+// Greedy initial partition: vertices in order of decreasing weight go to
+// the part to which they have the most edge weight, if it has room, and
+// otherwise to the least loaded part.
+void initial_partition(const weighted_graph& g, unsigned num_parts, double max_load, std::vector<unsigned>& parts, std::vector<double>& load) {
+    const auto n = g.size();
+    std::vector<cell_size_type> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&](auto a, auto b) { return g.vertex_weights[a]>g.vertex_weights[b]; });
+
+    const unsigned unassigned = num_parts;
+    parts.assign(n, unassigned);
+    load.assign(num_parts, 0);
+    label_connections conn(num_parts+1);
+    for (auto v: order) {
+        const double w = g.vertex_weights[v];
+        conn.gather(g, v, [&](cell_size_type u) { return parts[u]; });
+
+        unsigned best = std::min_element(load.begin(), load.end())-load.begin();
+        for (auto p: conn.labels) {
+            if (p==unassigned || load[p]+w>max_load) continue;
+            if (conn.weight[p]>conn.weight[best] || (conn.weight[p]==conn.weight[best] && load[p]<load[best])) {
+                best = p;
+            }
+        }
+        parts[v] = best;
+        load[best] += w;
+    }
+}
+
+// Label propagation refinement of a partition. A vertex moves if this
+// reduces the edge cut, or leaves the cut unchanged and improves the
+// balance; vertices in overloaded parts move to the best part with room,
+// even if this increases the cut.
+void refine_partition(const weighted_graph& g, unsigned num_parts, double max_load, unsigned max_passes, std::vector<unsigned>& parts, std::vector<double>& load) {
+    const auto n = g.size();
+    label_connections conn(num_parts);
+    for (unsigned pass = 0; pass<max_passes; ++pass) {
+        std::size_t moved = 0;
+        for (cell_size_type v = 0; v<n; ++v) {
+            const unsigned p = parts[v];
+            const double w = g.vertex_weights[v];
+            conn.gather(g, v, [&](cell_size_type u) { return parts[u]; });
+
+            unsigned best = p;
+            if (load[p]>max_load) {
+                // Consider all parts, not only those of the neighbours.
+                double best_weight = 0;
+                for (unsigned q = 0; q<num_parts; ++q) {
+                    if (q==p || load[q]+w>max_load) continue;
+                    const double cw = conn.weight[q];
+                    if (best==p || cw>best_weight || (cw==best_weight && load[q]<load[best])) {
+                        best = q;
+                        best_weight = cw;
+                    }
+                }
+            }
+            else {
+                double best_gain = 0;
+                const double own = conn.weight[p];
+                for (auto q: conn.labels) {
+                    if (q==p || load[q]+w>max_load) continue;
+                    const double gain = conn.weight[q]-own;
+                    const bool better = gain>best_gain ||
+                        (gain==best_gain && (best==p? load[q]+w<load[p]: load[q]<load[best]));
+                    if (better) {
+                        best = q;
+                        best_gain = gain;
+                    }
+                }
+            }
+
+            if (best!=p) {
+                load[p] -= w;
+                load[best] += w;
+                parts[v] = best;
+                ++moved;
+            }
+        }
+        if (!moved) break;
+    }
+}
+} // anonymous namespace
+
+weighted_graph make_weighted_graph(
+    std::vector<double> vertex_weights,
+    std::vector<std::pair<cell_size_type, cell_size_type>> edges)
+{
+    std::vector<weighted_edge> both;
+    both.reserve(2*edges.size());
+    for (auto e: edges) {
+        if (e.first==e.second) continue;
+        both.emplace_back(e.first, e.second, 1.);
+        both.emplace_back(e.second, e.first, 1.);
+    }
+    return make_csr_graph(std::move(vertex_weights), std::move(both));
+}
+
+std::vector<unsigned> partition_graph(
+    const weighted_graph& g,
+    unsigned num_parts,
+    double imbalance,
+    unsigned max_passes)
+{
+    const auto n = g.size();
+    if (!n || num_parts<2) return std::vector<unsigned>(n, 0);
+
+    double total = 0, max_weight = 0;
+    for (auto w: g.vertex_weights) {
+        total += w;
+        max_weight = std::max(max_weight, w);
+    }
+    const double max_load = std::max((1+imbalance)*total/num_parts, max_weight);
+
+    // Coarsen by clustering, until the graph stops shrinking. Clusters are
+    // limited to half of a part, so that the coarsest graph can still be
+    // partitioned in balance.
+    std::vector<weighted_graph> levels;
+    std::vector<std::vector<cell_size_type>> maps;
+    const weighted_graph* fine = &g;
+    while (fine->size()>2*num_parts) {
+        auto c = cluster_graph(*fine, max_load/2, max_passes);
+        if (c.second>0.9*fine->size()) break;
+        levels.push_back(contract_graph(*fine, c.first, c.second));
+        maps.push_back(std::move(c.first));
+        fine = &levels.back();
+    }
+
+    // Partition the coarsest graph, then project the partition onto each
+    // finer graph in turn, refining at each level.
+    std::vector<unsigned> parts;
+    std::vector<double> load;
+    initial_partition(*fine, num_parts, max_load, parts, load);
+    refine_partition(*fine, num_parts, max_load, max_passes, parts, load);
+
+    for (auto i = levels.size(); i>0; --i) {
+        const auto& finer = i>1? levels[i-2]: g;
+        const auto& map = maps[i-1];
+        std::vector<unsigned> fine_parts(finer.size());
+        for (cell_size_type v = 0; v<finer.size(); ++v) {
+            fine_parts[v] = parts[map[v]];
+        }
+        parts = std::move(fine_parts);
+        refine_partition(finer, num_parts, max_load, max_passes, parts, load);
+    }
+
+    return parts;
+}
+
+double edge_cut(const weighted_graph& g, const std::vector<unsigned>& parts) {
+    double cut = 0;
+    for (cell_size_type v = 0; v<g.size(); ++v) {
+        for (auto e = g.offsets[v]; e<g.offsets[v+1]; ++e) {
+            if (parts[v]!=parts[g.adjacency[e]]) cut += g.edge_weights[e];
+        }
+    }
+    // Each edge is counted from both of its vertices.
+    return cut/2;
+}
+
+} // namespace arb
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+
+namespace arb {
+
+// Undirected graph with weighted vertices and edges, in compressed sparse
+// row form: the neighbours of vertex i are adjacency[offsets[i]], ...,
+// adjacency[offsets[i+1]-1], with the edge weights at the same positions in
+// edge_weights. Each edge is stored once for each of its two vertices.
+struct weighted_graph {
+    std::vector<double> vertex_weights;
+    std::vector<std::size_t> offsets;
+    std::vector<cell_size_type> adjacency;
+    std::vector<double> edge_weights;
+
+    cell_size_type size() const { return vertex_weights.size(); }
+};
+
+// Build the graph with the given vertex weights, and an edge of weight one
+// for each pair (u, v) in edges; parallel edges are merged by summing their
+// weights, and self-loops are dropped.
+weighted_graph make_weighted_graph(
+    std::vector<double> vertex_weights,
+    std::vector<std::pair<cell_size_type, cell_size_type>> edges);
+
+// Assign the vertices of g to num_parts parts, so that the total weight of
+// the edges between parts is small, subject to the total vertex weight of
+// each part being at most (1+imbalance) times the mean, or the largest
+// vertex weight if that is larger. The balance constraint is met where the
+// vertex weights allow it.
+//
+// Multilevel partitioning with size-constrained label propagation: the
+// graph is coarsened by repeatedly merging clusters of strongly connected
+// vertices, the coarsest graph is partitioned greedily, and the partition
+// is then projected back onto each finer graph, where it is refined by
+// moving vertices to the part of the neighbours to which they have the
+// most edge weight. Each clustering and refinement stops after max_passes
+// passes over the vertices, or when no vertex moves.
+//
+// The result is deterministic: given the same graph, every domain of a
+// distributed model computes the same partition.
+std::vector<unsigned> partition_graph(
+    const weighted_graph& g,
+    unsigned num_parts,
+    double imbalance = 0.05,
+    unsigned max_passes = 16);
+
+// Total weight of the edges between vertices in different parts.
+double edge_cut(const weighted_graph& g, const std::vector<unsigned>& parts);
+
+} // namespace arb
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <numeric>
 #include <queue>
 #include <unordered_set>
 #include <vector>
@@ -8,23 +12,206 @@
 #include <arbor/symmetric_recipe.hpp>
 #include <arbor/context.hpp>
 
+#include "cell_cost.hpp"
 #include "cell_group_factory.hpp"
 #include "execution_context.hpp"
 #include "gpu_context.hpp"
+#include "partition_graph.hpp"
 #include "util/maputil.hpp"
 #include "util/partition.hpp"
+#include "util/rangeutil.hpp"
 #include "util/span.hpp"
 #include "util/strprintf.hpp"
 
 namespace arb {
 
-domain_decomposition partition_load_balance(
+namespace {
+// Parameters of the automatic cell group size.
+
+// Aim for at least this many cell groups per thread, so that the cell
+// group scheduler can balance the load.
+constexpr std::size_t auto_groups_per_thread = 4;
+
+// Aim for the state of a cell group to fit in this many bytes, around the
+// size of the per-core L2 cache.
+constexpr std::size_t auto_cache_target = 512*1024;
+
+// Aim for at least this many compartments per cable cell group, enough
+// to fill several SIMD vectors in the mechanism and matrix kernels.
+constexpr std::size_t auto_min_cv = 32;
+
+// Maximum number of cells sampled to estimate the cost of a cell kind.
+constexpr std::size_t auto_max_samples = 32;
+
+// Automatic group size for n cells with mean cost estimate est, on a
+// context with nthreads threads: as large as possible for vectorization
+// and to amortize the per-group overheads, but small enough to give
+// enough groups for load balance, and to fit the target cache footprint.
+std::size_t auto_group_size(std::size_t n, unsigned nthreads, const cell_cost_estimate& est) {
+    std::size_t size = n/(auto_groups_per_thread*nthreads);
+    if (est.memory) {
+        size = std::min(size, auto_cache_target/est.memory);
+    }
+    if (est.num_cv) {
+        size = std::max(size, (auto_min_cv+est.num_cv-1)/est.num_cv);
+    }
+    return std::max<std::size_t>(1, std::min(size, n));
+}
+
+struct cell_identifier {
+    cell_gid_type id;
+    bool is_super_cell;
+};
+
+// Build the domain decomposition with the cell groups of the local domain,
+// which holds the independent cells reg_cells, and the super_cells, each of
+// which is a set of cells connected by gap junctions, sorted by gid.
+domain_decomposition make_decomposition(
     const recipe& rec,
     const context& ctx,
-    partition_hint_map hint_map)
+    const partition_hint_map& hint_map,
+    const std::vector<cell_gid_type>& reg_cells,
+    const std::vector<std::vector<cell_gid_type>>& super_cells,
+    std::function<int(cell_gid_type)> gid_domain)
 {
     const bool gpu_avail = ctx->gpu->has_gpu();
 
+    // Sort gids into kind lists
+    // kind_lists maps a cell_kind to a vector of either:
+    // 1. gids of regular cells (in reg_cells)
+    // 2. indices of supercells (in super_cells)
+
+    cell_size_type num_local_cells = 0;
+    std::unordered_map<cell_kind, std::vector<cell_identifier>> kind_lists;
+    for (auto gid: reg_cells) {
+        ++num_local_cells;
+        kind_lists[rec.get_cell_kind(gid)].push_back({gid, false});
+    }
+
+    for (unsigned i = 0; i < super_cells.size(); i++) {
+        auto kind = rec.get_cell_kind(super_cells[i].front());
+        for (auto gid: super_cells[i]) {
+            if (rec.get_cell_kind(gid) != kind) {
+                throw gj_kind_mismatch(gid, super_cells[i].front());
+            }
+            ++num_local_cells;
+        }
+        kind_lists[kind].push_back({i, true});
+    }
+
+    // Create a flat vector of the cell kinds present on this node,
+    // partitioned such that kinds for which GPU implementation are
+    // listed before the others. This is a very primitive attempt at
+    // scheduling; the cell_groups that run on the GPU will be executed
+    // before other cell_groups, which is likely to be more efficient.
+    //
+    // TODO: This creates an dependency between the load balancer and
+    // the threading internals. We need support for setting the priority
+    // of cell group updates according to rules such as the back end on
+    // which the cell group is running.
+
+    auto has_gpu_backend = [&ctx](cell_kind c) {
+        return cell_kind_supported(c, backend_kind::gpu, *ctx);
+    };
+
+    std::vector<cell_kind> kinds;
+    for (auto l: kind_lists) {
+        kinds.push_back(cell_kind(l.first));
+    }
+    std::partition(kinds.begin(), kinds.end(), has_gpu_backend);
+
+    std::vector<group_description> groups;
+    for (auto k: kinds) {
+        partition_hint hint;
+        if (auto opt_hint = util::value_by_key(hint_map, k)) {
+            hint = opt_hint.value();
+            if(!hint.cpu_group_size) {
+                throw arbor_exception(arb::util::pprintf("unable to perform load balancing because {} has invalid suggested cpu_cell_group size of {}", k, hint.cpu_group_size));
+            }
+            if(hint.prefer_gpu && !hint.gpu_group_size) {
+                throw arbor_exception(arb::util::pprintf("unable to perform load balancing because {} has invalid suggested gpu_cell_group size of {}", k, hint.gpu_group_size));
+            }
+        }
+
+        backend_kind backend = backend_kind::multicore;
+        std::size_t group_size = hint.cpu_group_size;
+
+        if (hint.prefer_gpu && gpu_avail && has_gpu_backend(k)) {
+            backend = backend_kind::gpu;
+            group_size = hint.gpu_group_size;
+            if (group_size==partition_hint::auto_size) {
+                group_size = partition_hint::max_size;
+            }
+        }
+        else if (group_size==partition_hint::auto_size) {
+            // Estimate the mean cost of the cells of kind k from a sample.
+            const auto& cells = kind_lists[k];
+            const std::size_t stride = (cells.size()+auto_max_samples-1)/auto_max_samples;
+            std::size_t num_cells = 0, num_samples = 0;
+            cell_cost_estimate mean{0, 0, 0};
+            for (std::size_t i = 0; i<cells.size(); ++i) {
+                num_cells += cells[i].is_super_cell? super_cells[cells[i].id].size(): 1;
+                if (i%stride) continue;
+
+                auto gid = cells[i].is_super_cell? super_cells[cells[i].id].front(): cells[i].id;
+                auto est = estimate_cell_cost(rec, gid, k);
+                mean.work += est.work;
+                mean.memory += est.memory;
+                mean.num_cv += est.num_cv;
+                ++num_samples;
+            }
+            mean.work /= num_samples;
+            mean.memory /= num_samples;
+            mean.num_cv /= num_samples;
+
+            group_size = auto_group_size(num_cells, ctx->thread_pool->get_num_threads(), mean);
+        }
+
+        std::vector<cell_gid_type> group_elements;
+        // group_elements are sorted such that the gids of all members of a super_cell are consecutive.
+        for (auto cell: kind_lists[k]) {
+            if (cell.is_super_cell == false) {
+                group_elements.push_back(cell.id);
+            } else {
+                if (group_elements.size() + super_cells[cell.id].size() > group_size && !group_elements.empty()) {
+                    groups.push_back({k, std::move(group_elements), backend});
+                    group_elements.clear();
+                }
+                for (auto gid: super_cells[cell.id]) {
+                    group_elements.push_back(gid);
+                }
+            }
+            if (group_elements.size()>=group_size) {
+                groups.push_back({k, std::move(group_elements), backend});
+                group_elements.clear();
+            }
+        }
+        if (!group_elements.empty()) {
+            groups.push_back({k, std::move(group_elements), backend});
+        }
+    }
+
+    domain_decomposition d;
+    d.num_domains = ctx->distributed->size();
+    d.domain_id = ctx->distributed->id();
+    d.num_local_cells = num_local_cells;
+    d.num_global_cells = rec.num_cells();
+    d.groups = std::move(groups);
+    d.gid_domain = std::move(gid_domain);
+
+    return d;
+}
+
+// Build the cell groups of the local domain, where domain i holds the
+// gids in [gid_divisions[i], gid_divisions[i+1]), except that cells connected
+// by gap junctions are all assigned to the domain of the smallest gid among
+// them.
+domain_decomposition partition_gid_ranges(
+    const recipe& rec,
+    const context& ctx,
+    const partition_hint_map& hint_map,
+    const std::vector<cell_gid_type>& gid_divisions)
+{
     struct partition_gid_domain {
         partition_gid_domain(gathered_vector<cell_gid_type> divs, unsigned domains):
             gids_by_rank(std::move(divs)), num_domains(domains)
@@ -45,28 +232,12 @@ domain_decomposition partition_load_balance(
         unsigned num_domains;
     };
 
-    struct cell_identifier {
-        cell_gid_type id;
-        bool is_super_cell;
-    };
-
     using util::make_span;
 
     unsigned num_domains = ctx->distributed->size();
     unsigned domain_id = ctx->distributed->id();
-    auto num_global_cells = rec.num_cells();
 
-    auto dom_size = [&](unsigned dom) -> cell_gid_type {
-        const cell_gid_type B = num_global_cells/num_domains;
-        const cell_gid_type R = num_global_cells - num_domains*B;
-        return B + (dom<R);
-    };
-
-    // Global load balance
-
-    std::vector<cell_gid_type> gid_divisions;
-    auto gid_part = make_partition(
-        gid_divisions, transform_view(make_span(num_domains), dom_size));
+    auto gid_part = util::partition_view(gid_divisions);
 
     // Local load balance
 
@@ -121,114 +292,193 @@ domain_decomposition partition_load_balance(
                 return cg.front() < gid_part[domain_id].first;
             }), super_cells.end());
 
-    // Collect local gids that belong to this rank, and sort gids into kind lists
-    // kind_lists maps a cell_kind to a vector of either:
-    // 1. gids of regular cells (in reg_cells)
-    // 2. indices of supercells (in super_cells)
+    // Collect local gids that belong to this rank.
+    std::vector<cell_gid_type> local_gids = reg_cells;
+    for (auto& cg: super_cells) {
+        util::append(local_gids, cg);
+    }
+    util::sort(local_gids);
 
-    std::vector<cell_gid_type> local_gids;
-    std::unordered_map<cell_kind, std::vector<cell_identifier>> kind_lists;
-    for (auto gid: reg_cells) {
-        local_gids.push_back(gid);
-        kind_lists[rec.get_cell_kind(gid)].push_back({gid, false});
+    // global all-to-all to gather a local copy of the global gid list on each node.
+    auto global_gids = ctx->distributed->gather_gids(local_gids);
+
+    return make_decomposition(rec, ctx, hint_map, reg_cells, super_cells,
+        partition_gid_domain(std::move(global_gids), num_domains));
+}
+
+// Divide the gids over the domains in contiguous ranges of the same number
+// of cells.
+std::vector<cell_gid_type> equal_count_divisions(cell_gid_type num_cells, unsigned num_domains) {
+    auto dom_size = [&](unsigned dom) -> cell_gid_type {
+        const cell_gid_type B = num_cells/num_domains;
+        const cell_gid_type R = num_cells - num_domains*B;
+        return B + (dom<R);
+    };
+
+    std::vector<cell_gid_type> gid_divisions;
+    util::make_partition(gid_divisions, util::transform_view(util::make_span(num_domains), dom_size));
+    return gid_divisions;
+}
+
+// Divide the gids over the domains in contiguous ranges of about the same
+// total cost, as given by recipe::get_cell_cost. Each range ends at the
+// gid for which the cumulative cost is closest to its share of the total.
+std::vector<cell_gid_type> equal_cost_divisions(const recipe& rec, unsigned num_domains) {
+    const cell_gid_type num_cells = rec.num_cells();
+
+    std::vector<double> cumulative(num_cells+1, 0.);
+    for (cell_gid_type gid = 0; gid<num_cells; ++gid) {
+        double cost = rec.get_cell_cost(gid);
+        if (!(cost>=0)) {
+            throw arbor_exception(util::pprintf("recipe::get_cell_cost(gid={}) -> {} is not a non-negative cost", gid, cost));
+        }
+        cumulative[gid+1] = cumulative[gid]+cost;
     }
 
-    for (unsigned i = 0; i < super_cells.size(); i++) {
-        auto kind = rec.get_cell_kind(super_cells[i].front());
-        for (auto gid: super_cells[i]) {
-            if (rec.get_cell_kind(gid) != kind) {
-                throw gj_kind_mismatch(gid, super_cells[i].front());
-            }
-            local_gids.push_back(gid);
+    const double total = cumulative.back();
+    if (total<=0) {
+        return equal_count_divisions(num_cells, num_domains);
+    }
+
+    std::vector<cell_gid_type> gid_divisions(num_domains+1, 0);
+    for (unsigned i = 1; i<num_domains; ++i) {
+        const double target = total*i/num_domains;
+        auto first = cumulative.begin()+gid_divisions[i-1];
+        cell_gid_type b = std::lower_bound(first, cumulative.end(), target)-cumulative.begin();
+        if (b>gid_divisions[i-1] && target-cumulative[b-1]<cumulative[b]-target) {
+            --b;
         }
-        kind_lists[kind].push_back({i, true});
+        gid_divisions[i] = std::min(b, num_cells);
     }
+    gid_divisions[num_domains] = num_cells;
+    return gid_divisions;
+}
+} // anonymous namespace
 
+domain_decomposition partition_load_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map)
+{
+    auto divisions = equal_count_divisions(rec.num_cells(), ctx->distributed->size());
+    return partition_gid_ranges(rec, ctx, hint_map, divisions);
+}
 
-    // Create a flat vector of the cell kinds present on this node,
-    // partitioned such that kinds for which GPU implementation are
-    // listed before the others. This is a very primitive attempt at
-    // scheduling; the cell_groups that run on the GPU will be executed
-    // before other cell_groups, which is likely to be more efficient.
-    //
-    // TODO: This creates an dependency between the load balancer and
-    // the threading internals. We need support for setting the priority
-    // of cell group updates according to rules such as the back end on
-    // which the cell group is running.
+domain_decomposition partition_cost_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map)
+{
+    auto divisions = equal_cost_divisions(rec, ctx->distributed->size());
+    return partition_gid_ranges(rec, ctx, hint_map, divisions);
+}
 
-    auto has_gpu_backend = [&ctx](cell_kind c) {
-        return cell_kind_supported(c, backend_kind::gpu, *ctx);
-    };
+domain_decomposition partition_graph_balance(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hint_map)
+{
+    const cell_gid_type num_cells = rec.num_cells();
+    const unsigned num_domains = ctx->distributed->size();
+    const int domain_id = ctx->distributed->id();
 
-    std::vector<cell_kind> kinds;
-    for (auto l: kind_lists) {
-        kinds.push_back(cell_kind(l.first));
-    }
-    std::partition(kinds.begin(), kinds.end(), has_gpu_backend);
+    auto check_gid = [num_cells](cell_gid_type gid, cell_gid_type on) {
+        if (gid>=num_cells) {
+            throw arbor_exception(util::pprintf("cell {} has a connection to cell {}, which is not in the model", on, gid));
+        }
+    };
 
-    std::vector<group_description> groups;
-    for (auto k: kinds) {
-        partition_hint hint;
-        if (auto opt_hint = util::value_by_key(hint_map, k)) {
-            hint = opt_hint.value();
-            if(!hint.cpu_group_size) {
-                throw arbor_exception(arb::util::pprintf("unable to perform load balancing because {} has invalid suggested cpu_cell_group size of {}", k, hint.cpu_group_size));
-            }
-            if(hint.prefer_gpu && !hint.gpu_group_size) {
-                throw arbor_exception(arb::util::pprintf("unable to perform load balancing because {} has invalid suggested gpu_cell_group size of {}", k, hint.gpu_group_size));
+    // Find the sets of cells connected by gap junctions, which must be
+    // placed on the same domain, by union-find. The root of each set is
+    // its smallest gid.
+    std::vector<cell_gid_type> root(num_cells);
+    std::iota(root.begin(), root.end(), 0);
+    auto find = [&root](cell_gid_type gid) {
+        while (root[gid]!=gid) {
+            gid = root[gid] = root[root[gid]];
+        }
+        return gid;
+    };
+    for (cell_gid_type gid = 0; gid<num_cells; ++gid) {
+        for (auto c: rec.gap_junctions_on(gid)) {
+            if (gid != c.local.gid && gid != c.peer.gid) {
+                throw bad_cell_description(cell_kind::cable, gid);
             }
+            check_gid(c.local.gid, gid);
+            check_gid(c.peer.gid, gid);
+            auto a = find(c.local.gid);
+            auto b = find(c.peer.gid);
+            root[std::max(a, b)] = std::min(a, b);
         }
+    }
 
-        backend_kind backend = backend_kind::multicore;
-        std::size_t group_size = hint.cpu_group_size;
-
-        if (hint.prefer_gpu && gpu_avail && has_gpu_backend(k)) {
-            backend = backend_kind::gpu;
-            group_size = hint.gpu_group_size;
+    // The vertices of the graph are the sets of gap junction connected
+    // cells, numbered in order of their smallest gid, and weighted by the
+    // total cost of their cells.
+    std::vector<cell_size_type> vertex(num_cells);
+    std::vector<cell_size_type> vertex_size;
+    std::vector<double> vertex_weights;
+    for (cell_gid_type gid = 0; gid<num_cells; ++gid) {
+        auto r = find(gid);
+        if (r==gid) {
+            vertex[gid] = vertex_weights.size();
+            vertex_weights.push_back(0);
+            vertex_size.push_back(0);
+        }
+        else {
+            vertex[gid] = vertex[r];
         }
 
-        std::vector<cell_gid_type> group_elements;
-        // group_elements are sorted such that the gids of all members of a super_cell are consecutive.
-        for (auto cell: kind_lists[k]) {
-            if (cell.is_super_cell == false) {
-                group_elements.push_back(cell.id);
-            } else {
-                if (group_elements.size() + super_cells[cell.id].size() > group_size && !group_elements.empty()) {
-                    groups.push_back({k, std::move(group_elements), backend});
-                    group_elements.clear();
-                }
-                for (auto gid: super_cells[cell.id]) {
-                    group_elements.push_back(gid);
-                }
-            }
-            if (group_elements.size()>=group_size) {
-                groups.push_back({k, std::move(group_elements), backend});
-                group_elements.clear();
-            }
+        double cost = rec.get_cell_cost(gid);
+        if (!(cost>=0)) {
+            throw arbor_exception(util::pprintf("recipe::get_cell_cost(gid={}) -> {} is not a non-negative cost", gid, cost));
         }
-        if (!group_elements.empty()) {
-            groups.push_back({k, std::move(group_elements), backend});
+        vertex_weights[vertex[gid]] += cost;
+        ++vertex_size[vertex[gid]];
+    }
+
+    // The edges are the connections between cells.
+    std::vector<std::pair<cell_size_type, cell_size_type>> edges;
+    for (cell_gid_type gid = 0; gid<num_cells; ++gid) {
+        for (auto c: rec.connections_on(gid)) {
+            check_gid(c.source.gid, gid);
+            edges.push_back({vertex[c.source.gid], vertex[gid]});
         }
     }
 
-    cell_size_type num_local_cells = local_gids.size();
+    auto graph = make_weighted_graph(std::move(vertex_weights), std::move(edges));
+    auto parts = partition_graph(graph, num_domains);
 
-    // Exchange gid list with all other nodes
+    // Every domain computes the same partition, so the domain of every gid
+    // is known locally, without communication.
+    auto domains = std::make_shared<std::vector<int>>(num_cells);
+    std::vector<cell_gid_type> reg_cells;
+    std::unordered_map<cell_size_type, std::vector<cell_gid_type>> super_cell_map;
+    for (cell_gid_type gid = 0; gid<num_cells; ++gid) {
+        auto v = vertex[gid];
+        int d = (*domains)[gid] = parts[v];
+        if (d!=domain_id) continue;
 
-    util::sort(local_gids);
+        if (vertex_size[v]==1) {
+            reg_cells.push_back(gid);
+        }
+        else {
+            super_cell_map[v].push_back(gid);
+        }
+    }
 
-    // global all-to-all to gather a local copy of the global gid list on each node.
-    auto global_gids = ctx->distributed->gather_gids(local_gids);
+    // Order the super cells by smallest gid.
+    std::vector<std::vector<cell_gid_type>> super_cells;
+    for (auto& kv: super_cell_map) {
+        super_cells.push_back(std::move(kv.second));
+    }
+    util::sort_by(super_cells, [](const auto& cg) { return cg.front(); });
 
-    domain_decomposition d;
-    d.num_domains = num_domains;
-    d.domain_id = domain_id;
-    d.num_local_cells = num_local_cells;
-    d.num_global_cells = num_global_cells;
-    d.groups = std::move(groups);
-    d.gid_domain = partition_gid_domain(std::move(global_gids), num_domains);
+    auto gid_domain = [domains](cell_gid_type gid) -> int {
+        return gid<domains->size()? (*domains)[gid]: -1;
+    };
 
-    return d;
+    return make_decomposition(rec, ctx, hint_map, reg_cells, super_cells, gid_domain);
 }
 
 } // namespace arb
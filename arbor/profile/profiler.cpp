@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <cstdio>
 #include <mutex>
 #include <ostream>
@@ -65,10 +66,16 @@ class recorder {
     // One accumulator for call count and wall time for each region.
     std::vector<profile_accumulator> accumulators_;
 
+    // The accumulated value of each counter.
+    std::vector<std::uint64_t> counters_;
+
 public:
     // Return a list of the accumulated call count and wall times for each region.
     const std::vector<profile_accumulator>& accumulators() const;
 
+    // Return the accumulated value of each counter.
+    const std::vector<std::uint64_t>& counters() const;
+
     // Start timing the region with index.
     // Throws std::runtime_error if already timing a region.
     void enter(region_id_type index);
@@ -77,7 +84,10 @@ public:
     // Throws std::runtime_error if not currently timing a region.
     void leave();
 
-    // Reset all of the accumulated call counts and times to zero.
+    // Add value to the counter with index.
+    void count(region_id_type index, std::uint64_t value);
+
+    // Reset all of the accumulated call counts, times and counters to zero.
     void clear();
 };
 
@@ -97,7 +107,12 @@ class profiler {
     // is used to index into region_names_.
     std::vector<std::string> region_names_;
 
-    // Used to protect name_index_, which is shared between all threads.
+    // Counters are named and indexed like regions.
+    std::unordered_map<const char*, region_id_type> counter_index_;
+    std::vector<std::string> counter_names_;
+
+    // Used to protect name_index_ and counter_index_, which are shared
+    // between all threads.
     std::mutex mutex_;
 
     // Flag to indicate whether the profiler has been initialized with the task_system
@@ -110,8 +125,10 @@ public:
     void enter(region_id_type index);
     void enter(const char* name);
     void leave();
+    void count(region_id_type index, std::uint64_t value);
     const std::vector<std::string>& regions() const;
     region_id_type region_index(const char* name);
+    region_id_type counter_index(const char* name);
     profile results() const;
 
     static profiler& get_global_profiler() {
@@ -166,9 +183,21 @@ void recorder::leave() {
     index_ = npos;
 }
 
+const std::vector<std::uint64_t>& recorder::counters() const {
+    return counters_;
+}
+
+void recorder::count(region_id_type index, std::uint64_t value) {
+    if (index>=counters_.size()) {
+        counters_.resize(index+1);
+    }
+    counters_[index] += value;
+}
+
 void recorder::clear() {
     index_ = npos;
     accumulators_.resize(0);
+    counters_.resize(0);
 }
 
 // profiler implementation
@@ -197,6 +226,11 @@ void profiler::leave() {
     recorders_[thread_ids_.at(std::this_thread::get_id())].leave();
 }
 
+void profiler::count(region_id_type index, std::uint64_t value) {
+    if (!init_) return;
+    recorders_[thread_ids_.at(std::this_thread::get_id())].count(index, value);
+}
+
 region_id_type profiler::region_index(const char* name) {
     // The name_index_ hash table is shared by all threads, so all access
     // has to be protected by a mutex.
@@ -211,6 +245,18 @@ region_id_type profiler::region_index(const char* name) {
     return it->second;
 }
 
+region_id_type profiler::counter_index(const char* name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = counter_index_.find(name);
+    if (it==counter_index_.end()) {
+        const auto index = counter_names_.size();
+        counter_index_[name] = index;
+        counter_names_.emplace_back(name);
+        return index;
+    }
+    return it->second;
+}
+
 // Used to prepare the profiler output for printing.
 // Perform a depth first traversal of a profile tree that:
 // - sorts the children of each node in ascending order of time taken;
@@ -247,6 +293,15 @@ profile profiler::results() const {
         }
     }
 
+    p.counter_names = counter_names_;
+    p.counter_values = std::vector<std::uint64_t>(counter_names_.size());
+    for (auto& r: recorders_) {
+        auto& counters = r.counters();
+        for (auto i: make_span(0, counters.size())) {
+            p.counter_values[i] += counters[i];
+        }
+    }
+
     p.num_threads = recorders_.size();
 
     return p;
@@ -343,6 +398,17 @@ void profiler_enter(region_id_type region_id) {
     profiler::get_global_profiler().enter(region_id);
 }
 
+region_id_type profiler_counter_id(const char* name) {
+    if (!is_valid_region_string(name)) {
+        throw std::runtime_error(std::string("'")+name+"' is not a valid profiler counter name.");
+    }
+    return profiler::get_global_profiler().counter_index(name);
+}
+
+void profiler_count(region_id_type counter_id, std::uint64_t value) {
+    profiler::get_global_profiler().count(counter_id, value);
+}
+
 void profiler_initialize(context& ctx) {
     profiler::get_global_profiler().initialize(ctx->thread_pool);
 }
@@ -356,6 +422,16 @@ std::ostream& operator<<(std::ostream& o, const profile& prof) {
     snprintf(buf, util::size(buf), "_p_ %-20s%12s%12s%12s%8s", "REGION", "CALLS", "THREAD", "WALL", "\%");
     o << buf;
     print(o, tree, tree.time, prof.num_threads, 0, "");
+
+    if (!prof.counter_names.empty()) {
+        snprintf(buf, util::size(buf), "\n\n_p_ %-44s%20s", "COUNTER", "TOTAL");
+        o << buf;
+        for (auto i: make_span(0, prof.counter_names.size())) {
+            snprintf(buf, util::size(buf), "\n_p_ %-44s%20llu",
+                prof.counter_names[i].c_str(), (unsigned long long)prof.counter_values[i]);
+            o << buf;
+        }
+    }
     return o;
 }
 
@@ -367,10 +443,12 @@ profile profiler_summary() {
 
 void profiler_leave() {}
 void profiler_enter(region_id_type) {}
+void profiler_count(region_id_type, std::uint64_t) {}
 profile profiler_summary();
 void profiler_print(const profile& prof, float threshold) {};
 profile profiler_summary() {return profile();}
 region_id_type profiler_region_id(const char*) {return 0;}
+region_id_type profiler_counter_id(const char*) {return 0;}
 std::ostream& operator<<(std::ostream& o, const profile&) {return o;}
 
 #endif // ARB_HAVE_PROFILING
@@ -14,10 +14,18 @@
     // leave a profling region
     #define PL arb::profile::profiler_leave
 
+    // add value to a profiler counter
+    #define PC(name, value) \
+        { \
+            static std::size_t counter_id_ = arb::profile::profiler_counter_id(#name); \
+            arb::profile::profiler_count(counter_id_, value); \
+        }
+
 #else
 
     #define PE(name)
     #define PL()
+    #define PC(name, value)
 
 #endif
 
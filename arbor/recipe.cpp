@@ -0,0 +1,11 @@
+#include <arbor/recipe.hpp>
+
+#include "cell_cost.hpp"
+
+namespace arb {
+
+double recipe::get_cell_cost(cell_gid_type gid) const {
+    return estimate_cell_cost(*this, gid, get_cell_kind(gid)).work;
+}
+
+} // namespace arb
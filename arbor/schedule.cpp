@@ -15,27 +15,35 @@ namespace arb {
 
 time_event_span regular_schedule_impl::events(time_type t0, time_type t1) {
     times_.clear();
+    append_events(t0, t1, times_);
+    return as_time_event_span(times_);
+}
 
+// The times in [t0, t1) are n·dt for n0 ≤ n < n1, where n0 and n1 are found
+// directly from t0 and t1, and are written in a loop free of branches.
+void regular_schedule_impl::append_events(time_type t0, time_type t1, std::vector<time_type>& out) {
     t0 = std::max(t0, t0_);
     t1 = std::min(t1, t1_);
 
     if (t1>t0) {
-        times_.reserve(1+std::size_t((t1-t0)*oodt_));
-
-        long long n = t0*oodt_;
-        time_type t = n*dt_;
-
-        while (t<t0) {
-            t = (++n)*dt_;
-        }
-
-        while (t<t1) {
-            times_.push_back(t);
-            t = (++n)*dt_;
+        const long long n0 = first_index(t0);
+        const long long count = first_index(t1)-n0;
+
+        const auto base = out.size();
+        out.resize(base+count);
+        time_type* times = out.data()+base;
+        for (long long k = 0; k<count; ++k) {
+            times[k] = (n0+k)*dt_;
         }
     }
+}
 
-    return as_time_event_span(times_);
+long long regular_schedule_impl::first_index(time_type t) const {
+    // The estimate from t/dt may be off by one either way with rounding.
+    long long n = t*oodt_;
+    while (n>0 && (n-1)*dt_>=t) --n;
+    while (n*dt_<t) ++n;
+    return n;
 }
 
 // Explicit schedule implementation.
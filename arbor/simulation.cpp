@@ -1,8 +1,14 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <set>
 #include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/context.hpp>
+#include <arbor/profile/timer.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/generic_event.hpp>
 #include <arbor/recipe.hpp>
@@ -12,6 +18,8 @@
 #include "cell_group.hpp"
 #include "cell_group_factory.hpp"
 #include "communication/communicator.hpp"
+#include "communication/spike_encoding.hpp"
+#include "event_calendar.hpp"
 #include "execution_context.hpp"
 #include "merge_events.hpp"
 #include "thread_private_spike_store.hpp"
@@ -21,6 +29,7 @@
 #include "util/maputil.hpp"
 #include "util/partition.hpp"
 #include "util/span.hpp"
+#include "util/strprintf.hpp"
 #include "profile/profiler_macro.hpp"
 
 namespace arb {
@@ -49,6 +58,73 @@ public:
     void exchange() { buffer_.exchange(); }
 };
 
+// The time for which a gather is in flight while the thread that started it
+// runs other tasks, such as the cell updates of the epoch, which is the
+// communication time hidden by the overlap.
+//
+// The gather is tested for completion by poll(), which the thread calls
+// between the cell groups it advances, as well as between tasks, so that
+// the time is measured to within the advance of one cell group. The time
+// is only counted up to the last test that finds the gather in flight.
+class gather_overlap {
+public:
+    template <typename T>
+    explicit gather_overlap(gather_request<T>& request):
+        test_([&request] { return request.test(); }),
+        t_last_(profile::timer<>::tic()),
+        previous_(current_)
+    {
+        current_ = this;
+    }
+
+    gather_overlap(const gather_overlap&) = delete;
+    gather_overlap& operator=(const gather_overlap&) = delete;
+
+    ~gather_overlap() {
+        current_ = previous_;
+    }
+
+    // The overlap of the gather started by this thread, if any.
+    static gather_overlap* current() { return current_; }
+
+    // Returns true once the gather is complete.
+    bool poll() {
+        if (done_) return true;
+
+        PE(communication_exchange_test);
+        done_ = test_();
+        PL();
+        if (!done_) {
+            hidden_ += profile::timer<>::toc(t_last_);
+            t_last_ = profile::timer<>::tic();
+        }
+        return done_;
+    }
+
+    double hidden() const { return hidden_; }
+
+private:
+    std::function<bool()> test_;
+    tick_type t_last_;
+    double hidden_ = 0;
+    bool done_ = false;
+    gather_overlap* previous_;
+
+    static thread_local gather_overlap* current_;
+};
+
+thread_local gather_overlap* gather_overlap::current_ = nullptr;
+
+// Run other tasks on this thread until the gather of request is complete,
+// or until there is nothing else to do, and add the time for which they hid
+// the communication to the profiler counter exchange_hidden_us.
+template <typename T>
+void overlap_gather(gather_request<T>& request, threading::task_system* ts) {
+    gather_overlap overlap(request);
+    while (!overlap.poll() && ts->try_run_task()) {}
+    PC(exchange_hidden_us, std::uint64_t(overlap.hidden()*1e6));
+}
+
 class simulation_state {
 public:
     simulation_state(const recipe& rec, const domain_decomposition& decomp, execution_context ctx);
@@ -68,6 +144,22 @@ public:
         return communicator_.num_spikes();
     }
 
+    const std::vector<double>& group_costs() const {
+        return group_cost_;
+    }
+
+    const std::vector<int>& group_owners() const {
+        return group_owner_;
+    }
+
+    void set_thread_rebalance_interval(time_type interval);
+
+    void set_event_lane_kind(event_lane_kind kind);
+
+    double domain_load_imbalance() const {
+        return load_imbalance_;
+    }
+
     void set_binning_policy(binning_kind policy, time_type bin_interval);
 
     void inject_events(const pse_vector& events);
@@ -80,6 +172,16 @@ private:
     // See comments on implementation for more information.
     void setup_events(time_type t_from, time_type time_to, std::size_t epoch_id);
 
+    // As setup_events, with the pending events of each cell kept in a
+    // calendar queue.
+    void setup_calendar_events(time_type t_from, time_type time_to, std::size_t epoch_id);
+
+    // Measure the load imbalance between domains, and with sticky scheduling
+    // reassign cell groups to threads, from the advance times of the cell
+    // groups since the last rebalance. Cells are not moved between cell
+    // groups or domains.
+    void rebalance_threads();
+
     std::vector<pse_vector>& event_lanes(std::size_t epoch_id) {
         return event_lanes_[epoch_id%2];
     }
@@ -105,24 +207,66 @@ private:
 
     // Pending events to be delivered.
     std::array<std::vector<pse_vector>, 2> event_lanes_;
-    std::vector<pse_vector> pending_events_;
+    // Events generated by the last spike exchange, by local cell.
+    cell_event_buffer pending_events_;
+    // Scratch space for sorting the pending events, partitioned by cell in
+    // the same way as pending_events_.
+    pse_vector sort_buffer_;
+    // With event_lane_kind::calendar, the pending events of each cell
+    // between epochs.
+    event_lane_kind lane_kind_ = event_lane_kind::sorted;
+    std::vector<event_calendar> calendars_;
+
+    // The number of bins of a calendar is enough to span the largest delay
+    // onto a local cell, up to this limit.
+    static constexpr unsigned max_calendar_bins = 32;
+
+    // Events added with inject_events, by local cell. These are merged with
+    // the pending events of the next epoch.
+    std::vector<pse_vector> injected_events_;
 
     // Sampler associations handles are managed by a helper class.
     util::handle_set<sampler_association_handle> sassoc_handles_;
 
+    // Assignment of cell groups to threads: either all groups are taken
+    // from one shared list, or each thread owns a list of groups
+    // (cell_group_scheduling::sticky).
+    threading::affinity_schedule group_schedule_;
+
+    // Wall time taken by each cell group to advance in the last epoch.
+    // Groups are scheduled in decreasing order of cost.
+    std::vector<double> group_cost_;
+
+    // Dynamic load balancing: every rebalance_interval_ of model time (if
+    // non-zero), the owners of the cell groups are reassigned by the total
+    // wall time taken by each group since the last rebalance, moving as few
+    // groups as possible away from the thread that first touched them.
+    distributed_context_handle distributed_;
+    bool sticky_;
+    std::vector<int> group_owner_;
+    std::vector<double> rebalance_cost_;
+    time_type rebalance_interval_ = 0;
+    time_type t_rebalance_ = 0;
+    double load_imbalance_ = 1;
+
+    // Cell groups are only reassigned if the busiest thread has at least
+    // this much more work than the mean.
+    static constexpr double rebalance_threshold = 1.1;
+
     // Apply a functional to each cell group in parallel.
     template <typename L>
     void foreach_group(L&& fn) {
-        threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
-            [&, fn = std::forward<L>(fn)](int i) { fn(cell_groups_[i]); });
+        foreach_group_index([&](cell_group_ptr& group, int) { fn(group); });
     }
 
     // Apply a functional to each cell group in parallel, supplying
     // the cell group pointer reference and index.
+    // Cell groups are coarse grained and can have very different costs,
+    // so each group is scheduled individually.
     template <typename L>
     void foreach_group_index(L&& fn) {
-        threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
-            [&, fn = std::forward<L>(fn)](int i) { fn(cell_groups_[i], i); });
+        group_schedule_.apply(task_system_.get(),
+            [&](int i) { fn(cell_groups_[i], i); });
     }
 };
 
@@ -134,7 +278,9 @@ simulation_state::simulation_state(
     local_spikes_(new spike_double_buffer(thread_private_spike_store(ctx.thread_pool),
                                           thread_private_spike_store(ctx.thread_pool))),
     communicator_(rec, decomp, ctx),
-    task_system_(ctx.thread_pool)
+    task_system_(ctx.thread_pool),
+    distributed_(ctx.distributed),
+    sticky_(ctx.group_scheduling==cell_group_scheduling::sticky)
 {
     const auto num_local_cells = communicator_.num_local_cells();
 
@@ -142,7 +288,8 @@ simulation_state::simulation_state(
     min_delay_ = communicator_.min_delay();
 
     // Initialize empty buffers for pending events for each local cell
-    pending_events_.resize(num_local_cells);
+    pending_events_.divisions.assign(num_local_cells+1, 0);
+    injected_events_.resize(num_local_cells);
 
     event_generators_.resize(num_local_cells);
     cell_local_size_type lidx = 0;
@@ -157,15 +304,40 @@ simulation_state::simulation_state(
         }
     }
 
+    const auto num_groups = decomp.groups.size();
+    const int num_threads = task_system_->get_num_threads();
+
+    // With sticky scheduling, the cell groups are initially divided into
+    // contiguous blocks, one per thread; otherwise all groups are taken
+    // from a single list.
+    group_owner_.assign(num_groups, 0);
+    if (sticky_) {
+        for (std::size_t i=0; i<num_groups; ++i) {
+            group_owner_[i] = i*num_threads/num_groups;
+        }
+    }
+    group_schedule_ = threading::affinity_schedule(group_owner_, num_threads);
+    group_cost_.assign(num_groups, 0.);
+    rebalance_cost_.assign(num_groups, 0.);
+
     // Generate the cell groups in parallel, with one task per cell group.
-    cell_groups_.resize(decomp.groups.size());
+    cell_groups_.resize(num_groups);
+    std::vector<int> constructed_by(num_groups);
     foreach_group_index(
         [&](cell_group_ptr& group, int i) {
             const auto& group_info = decomp.groups[i];
             auto factory = cell_kind_implementation(group_info.kind, group_info.backend, ctx);
             group = factory(group_info.gids, rec);
+            constructed_by[i] = std::max(0, task_system_->current_index());
         });
 
+    // The memory of a cell group is first touched by the thread that
+    // constructs it, which therefore becomes its owner.
+    if (sticky_) {
+        group_owner_ = std::move(constructed_by);
+        group_schedule_ = threading::affinity_schedule(group_owner_, num_threads);
+    }
+
     // Create event lane buffers.
     // There is one set for each epoch: current (0) and next (1).
     // For each epoch there is one lane for each cell in the cell group.
@@ -194,7 +366,11 @@ void simulation_state::reset() {
         }
     }
 
-    for (auto& lane: pending_events_) {
+    pending_events_.clear();
+    for (auto& cal: calendars_) {
+        cal.clear();
+    }
+    for (auto& lane: injected_events_) {
         lane.clear();
     }
 
@@ -202,6 +378,9 @@ void simulation_state::reset() {
 
     local_spikes_->current().clear();
     local_spikes_->previous().clear();
+
+    std::fill(rebalance_cost_.begin(), rebalance_cost_.end(), 0.);
+    t_rebalance_ = rebalance_interval_;
 }
 
 time_type simulation_state::run(time_type tfinal, time_type dt) {
@@ -217,7 +396,14 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
         foreach_group_index(
             [&](cell_group_ptr& group, int i) {
                 auto queues = util::subrange_view(event_lanes(epoch_.id), communicator_.group_queue_range(i));
+                auto t_start = profile::timer<>::tic();
                 group->advance(epoch_, dt, queues);
+                group_cost_[i] = profile::timer<>::toc(t_start);
+                rebalance_cost_[i] += group_cost_[i];
+
+                // Between cell groups, the thread running the spike exchange
+                // tests the gather for completion.
+                if (auto overlap = gather_overlap::current()) overlap->poll();
 
                 PE(advance_spikes);
                 local_spikes_->current().insert(group->spikes());
@@ -234,20 +420,39 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
         PE(communication_exchange_gatherlocal);
         auto local_spikes = local_spikes_->previous().gather();
         PL();
-        auto global_spikes = communicator_.exchange(local_spikes);
 
-        PE(communication_spikeio);
-        if (local_export_callback_) {
-            local_export_callback_(local_spikes);
+        // The gather of the spikes is started, and this thread returns to
+        // the cell updates until it is complete: the time spent waiting for
+        // it in finish_exchange is the communication time that is not hidden.
+        //
+        // The exchanged spikes are either spikes, or encoded spikes that
+        // are decoded only if they are exported.
+        auto exchange_and_walk = [&](auto request, auto&& decode) {
+            overlap_gather(request, task_system_.get());
+            const auto global_spikes = communicator_.finish_exchange(std::move(request));
+
+            PE(communication_spikeio);
+            if (local_export_callback_) {
+                local_export_callback_(local_spikes);
+            }
+            if (global_export_callback_) {
+                global_export_callback_(decode(global_spikes).values());
+            }
+            PL();
+
+            PE(communication_walkspikes);
+            communicator_.make_event_queues(global_spikes, pending_events_);
+            PL();
+        };
+
+        if (communicator_.encoding()==spike_encoding::compact) {
+            exchange_and_walk(communicator_.start_exchange_encoded(local_spikes),
+                [](const gathered_vector<std::uint8_t>& s) { return decode_spikes(s); });
         }
-        if (global_export_callback_) {
-            global_export_callback_(global_spikes.values());
+        else {
+            exchange_and_walk(communicator_.start_exchange(local_spikes),
+                [](const gathered_vector<spike>& s) -> const gathered_vector<spike>& { return s; });
         }
-        PL();
-
-        PE(communication_walkspikes);
-        communicator_.make_event_queues(global_spikes, pending_events_);
-        PL();
 
         const auto t0 = epoch_.tfinal;
         const auto t1 = std::min(tfinal, t0+t_interval);
@@ -264,6 +469,10 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
         // these buffers will store the new spikes generated in update_cells.
         local_spikes_->current().clear();
 
+        // start the most expensive cell groups first, going by the cost of
+        // the last epoch.
+        group_schedule_.order_by_cost(group_cost_);
+
         // run the tasks, overlapping if the threading model and number of
         // available threads permits it.
         threading::task_group g(task_system_.get());
@@ -275,12 +484,22 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
 
         tuntil = std::min(t_+t_interval, tfinal);
         epoch_.advance(tuntil);
+
+        // All domains reach the same epoch boundaries, so they take part
+        // in the collectives of rebalance_threads() together.
+        if (rebalance_interval_>0 && t_>=t_rebalance_) {
+            rebalance_threads();
+            t_rebalance_ = t_+rebalance_interval_;
+        }
     }
 
     // Run the exchange one last time to ensure that all spikes are output to file.
     local_spikes_->exchange();
     exchange();
 
+    // With sparse spike exchange the domains count their own spikes only.
+    communicator_.sum_spikes();
+
     return t_;
 }
 
@@ -301,6 +520,7 @@ auto split_sorted_range(Seq&& seq, const Value& v, Less cmp = Less{}) {
 //      event_lanes[epoch]: take all events ≥ t_from
 //      event_generators  : take all events < t_to
 //      pending_events    : take all events
+//      injected_events   : take all events
 
 // merge_cell_events() is a separate function for unit testing purposes.
 void merge_cell_events(
@@ -314,14 +534,21 @@ void merge_cell_events(
     PE(communication_enqueue_setup);
     new_events.clear();
     old_events = split_sorted_range(old_events, t_from, event_time_less()).second;
+
+    // Size the output for the old and pending events up front, so that
+    // once the lane has grown to its working size no further allocation
+    // is required.
+    new_events.reserve(old_events.size()+pending.size());
     PL();
 
     if (!generators.empty()) {
         PE(communication_enqueue_setup);
         // Tree-merge events in [t_from, t_to) from old, pending and generator events.
 
-        std::vector<event_span> spanbuf;
-        spanbuf.reserve(2+generators.size());
+        // The list of spans is kept between calls, so that it is allocated
+        // only as it grows.
+        thread_local std::vector<event_span> spanbuf;
+        spanbuf.clear();
 
         auto old_split = split_sorted_range(old_events, t_to, event_time_less());
         auto pending_split = split_sorted_range(pending, t_to, event_time_less());
@@ -354,19 +581,122 @@ void merge_cell_events(
 }
 
 void simulation_state::setup_events(time_type t_from, time_type t_to, std::size_t epoch) {
+    if (lane_kind_==event_lane_kind::calendar) {
+        setup_calendar_events(t_from, t_to, epoch);
+        return;
+    }
+
     const auto n = communicator_.num_local_cells();
+    sort_buffer_.resize(pending_events_.events.size());
     threading::parallel_for::apply(0, n, task_system_.get(),
         [&](cell_size_type i) {
             PE(communication_enqueue_sort);
-            util::sort(pending_events_[i]);
+            auto cell_events = pending_events_.cell(i);
+            sort_events(cell_events, sort_buffer_.data()+pending_events_.divisions[i]);
+            event_span pending = cell_events;
+
+            // Injected events are rare: they are merged with the pending
+            // events in the injected event buffer of the cell.
+            auto& injected = injected_events_[i];
+            if (!injected.empty()) {
+                util::sort(injected);
+                auto n = injected.size();
+                util::append(injected, pending);
+                std::inplace_merge(injected.begin(), injected.begin()+n, injected.end());
+                pending = util::range_pointer_view(injected);
+            }
             PL();
 
-            event_span pending = util::range_pointer_view(pending_events_[i]);
             event_span old_events = util::range_pointer_view(event_lanes(epoch)[i]);
 
             merge_cell_events(t_from, t_to, old_events, pending, event_generators_[i], event_lanes(epoch+1)[i]);
-            pending_events_[i].clear();
+            injected.clear();
             });
+    pending_events_.clear();
+}
+
+// Populate the event lanes for epoch+1 from the calendar queues: the
+// pending events and injected events are added to the calendar of their
+// cell, and the lane is filled with the events of the calendar and the
+// event generators in [t_from, t_to), which are then sorted. Unlike the
+// sorted lanes, the lane holds no events after t_to.
+void simulation_state::setup_calendar_events(time_type t_from, time_type t_to, std::size_t epoch) {
+    const auto n = communicator_.num_local_cells();
+    threading::parallel_for::apply(0, n, task_system_.get(),
+        [&](cell_size_type i) {
+            PE(communication_enqueue_calendar);
+            auto& calendar = calendars_[i];
+            calendar.push(pending_events_.cell(i));
+            calendar.push(injected_events_[i]);
+            injected_events_[i].clear();
+
+            auto& lane = event_lanes(epoch+1)[i];
+            lane.clear();
+            calendar.pop_before(t_from, t_to, lane);
+            for (auto& g: event_generators_[i]) {
+                event_span evs = g.events(t_from, t_to);
+                util::append(lane, evs);
+            }
+
+            // The upper half of the lane is scratch space for the sort.
+            const auto m = lane.size();
+            lane.resize(2*m);
+            sort_events(util::make_range(lane.data(), lane.data()+m), lane.data()+m);
+            lane.resize(m);
+            PL();
+        });
+    pending_events_.clear();
+}
+
+void simulation_state::set_event_lane_kind(event_lane_kind kind) {
+    if (t_>0) {
+        throw arbor_exception("the event lane kind can't be changed after the simulation has started");
+    }
+    if (kind==lane_kind_) return;
+
+    lane_kind_ = kind;
+    calendars_.clear();
+    if (kind==event_lane_kind::calendar) {
+        // Bins one epoch wide.
+        const time_type width = min_delay_/2;
+        const auto num_bins = std::min<double>(max_calendar_bins,
+            std::ceil(communicator_.local_max_delay()/width)+2);
+        calendars_.assign(communicator_.num_local_cells(), event_calendar(width, num_bins));
+    }
+}
+
+void simulation_state::set_thread_rebalance_interval(time_type interval) {
+    if (!(interval>=0)) {
+        throw arbor_exception(util::pprintf("invalid rebalance interval {}", interval));
+    }
+    rebalance_interval_ = interval;
+    t_rebalance_ = t_+interval;
+}
+
+void simulation_state::rebalance_threads() {
+    PE(rebalance);
+    double local_cost = 0;
+    for (auto c: rebalance_cost_) local_cost += c;
+
+    const double total_cost = distributed_->sum(local_cost);
+    const double max_cost = distributed_->max(local_cost);
+    load_imbalance_ = total_cost>0? max_cost*distributed_->size()/total_cost: 1.;
+
+    const int num_threads = task_system_->get_num_threads();
+    if (sticky_ && num_threads>1 && local_cost>0) {
+        std::vector<double> load(num_threads, 0.);
+        for (auto i: util::count_along(group_owner_)) {
+            load[group_owner_[i]] += rebalance_cost_[i];
+        }
+        const double max_load = *std::max_element(load.begin(), load.end());
+        if (max_load*num_threads>rebalance_threshold*local_cost) {
+            group_owner_ = threading::rebalance_owners(rebalance_cost_, std::move(group_owner_), num_threads);
+            group_schedule_ = threading::affinity_schedule(group_owner_, num_threads);
+        }
+    }
+
+    std::fill(rebalance_cost_.begin(), rebalance_cost_.end(), 0.);
+    PL();
 }
 
 sampler_association_handle simulation_state::add_sampler(
@@ -404,14 +734,14 @@ void simulation_state::set_binning_policy(binning_kind policy, time_type bin_int
 
 void simulation_state::inject_events(const pse_vector& events) {
     // Push all events that are to be delivered to local cells into the
-    // pending event list for the event's target cell.
+    // injected event list for the event's target cell.
     for (auto& e: events) {
         if (e.time<t_) {
             throw bad_event_time(e.time, t_);
         }
         // gid_to_local_ maps gid to index into local set of cells.
         if (auto lidx = util::value_by_key(gid_to_local_, e.target.gid)) {
-            pending_events_[*lidx].push_back(e);
+            injected_events_[*lidx].push_back(e);
         }
     }
 }
@@ -455,6 +785,26 @@ std::size_t simulation::num_spikes() const {
     return impl_->num_spikes();
 }
 
+std::vector<double> simulation::cell_group_costs() const {
+    return impl_->group_costs();
+}
+
+std::vector<int> simulation::cell_group_threads() const {
+    return impl_->group_owners();
+}
+
+void simulation::set_thread_rebalance_interval(time_type interval) {
+    impl_->set_thread_rebalance_interval(interval);
+}
+
+double simulation::domain_load_imbalance() const {
+    return impl_->domain_load_imbalance();
+}
+
+void simulation::set_event_lane_kind(event_lane_kind kind) {
+    impl_->set_event_lane_kind(kind);
+}
+
 void simulation::set_binning_policy(binning_kind policy, time_type bin_interval) {
     impl_->set_binning_policy(policy, bin_interval);
 }
@@ -33,11 +33,16 @@ cell_kind spike_source_cell_group::get_cell_kind() const {
 void spike_source_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) {
     PE(advance_sscell);
 
-    for (auto i: util::count_along(gids_)) {
-        const auto gid = gids_[i];
+    // Evaluate the schedules of all cells at once, then make the spikes
+    // from the flat buffer of times.
+    evaluate_schedules(time_sequences_, t_, ep.tfinal, spike_times_, spike_time_offsets_);
 
-        for (auto t: util::make_range(time_sequences_[i].events(t_, ep.tfinal))) {
-            spikes_.push_back({{gid, 0u}, t});
+    auto n = spikes_.size();
+    spikes_.resize(n+spike_times_.size());
+    for (auto i: util::count_along(gids_)) {
+        const cell_member_type source{gids_[i], 0u};
+        for (auto j = spike_time_offsets_[i]; j<spike_time_offsets_[i+1]; ++j) {
+            spikes_[n++] = {source, spike_times_[j]};
         }
     }
     t_ = ep.tfinal;
@@ -40,6 +40,11 @@ private:
     std::vector<spike> spikes_;
     std::vector<cell_gid_type> gids_;
     std::vector<schedule> time_sequences_;
+
+    // Spike times of the current epoch, with the times of the i-th cell in
+    // [spike_time_offsets_[i], spike_time_offsets_[i+1]).
+    std::vector<time_type> spike_times_;
+    std::vector<std::size_t> spike_time_offsets_;
 };
 
 } // namespace arb
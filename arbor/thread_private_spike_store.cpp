@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <utility>
 #include <vector>
 
 #include <arbor/common_types.hpp>
@@ -11,10 +13,17 @@ namespace arb {
 
 struct local_spike_store_type {
     threading::enumerable_thread_specific<std::vector<spike>> buffers_;
+    task_system_handle task_system_;
 
-    local_spike_store_type(const task_system_handle& ts): buffers_(ts) {};
+    local_spike_store_type(const task_system_handle& ts): buffers_(ts), task_system_(ts) {};
 };
 
+namespace {
+bool source_time_less(const spike& a, const spike& b) {
+    return a.source<b.source || (a.source==b.source && a.time<b.time);
+}
+} // anonymous namespace
+
 thread_private_spike_store::thread_private_spike_store(thread_private_spike_store&& t):
     impl_(std::move(t.impl_))
 {}
@@ -25,16 +34,46 @@ thread_private_spike_store::thread_private_spike_store(const task_system_handle&
 
 thread_private_spike_store::~thread_private_spike_store() {}
 
-std::vector<spike> thread_private_spike_store::gather() const {
-    std::vector<spike> spikes;
-    unsigned num_spikes = 0u;
-    for (auto& b: impl_->buffers_) {
+std::vector<spike> thread_private_spike_store::gather() {
+    auto& buffers = impl_->buffers_;
+
+    // Sort the buffer of each thread.
+    threading::parallel_for::apply(0, buffers.size(), 1, impl_->task_system_.get(),
+        [&buffers](int i) {
+            auto& b = *(buffers.begin()+i);
+            std::sort(b.begin(), b.end(), source_time_less);
+        });
+
+    // k-way merge of the sorted buffers into a single vector, using a heap
+    // of the unmerged remainder of each buffer, ordered by its first spike.
+    using range = std::pair<const spike*, const spike*>;
+    std::vector<range> heads;
+    std::size_t num_spikes = 0;
+    for (auto& b: buffers) {
         num_spikes += b.size();
+        if (!b.empty()) {
+            heads.push_back({b.data(), b.data()+b.size()});
+        }
     }
+
+    std::vector<spike> spikes;
     spikes.reserve(num_spikes);
 
-    for (auto& b: impl_->buffers_) {
-        spikes.insert(spikes.begin(), b.begin(), b.end());
+    auto later = [](const range& a, const range& b) { return source_time_less(*b.first, *a.first); };
+    std::make_heap(heads.begin(), heads.end(), later);
+    while (heads.size()>1) {
+        std::pop_heap(heads.begin(), heads.end(), later);
+        auto& r = heads.back();
+        spikes.push_back(*r.first++);
+        if (r.first==r.second) {
+            heads.pop_back();
+        }
+        else {
+            std::push_heap(heads.begin(), heads.end(), later);
+        }
+    }
+    if (!heads.empty()) {
+        spikes.insert(spikes.end(), heads.front().first, heads.front().second);
     }
 
     return spikes;
@@ -26,9 +26,10 @@ public :
     thread_private_spike_store(thread_private_spike_store&& t);
     thread_private_spike_store(const task_system_handle& ts);
 
-    /// Collate all of the individual buffers into a single vector of spikes.
-    /// Does not modify the buffer contents.
-    std::vector<spike> gather() const;
+    /// Collate all of the individual buffers into a single vector of spikes,
+    /// sorted by source and then time. The buffers are sorted in place, in
+    /// parallel, then merged; the spikes in the buffers are not changed.
+    std::vector<spike> gather();
 
     /// Return a reference to the thread private buffer of the calling thread
     std::vector<spike>& get();
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace arb {
+namespace threading {
+
+// Number of heap allocations made by the threading layer since the start of
+// the program: tasks too large for inline storage, and the growth of task
+// queues and task pools.
+std::size_t allocation_count();
+
+namespace impl {
+void count_allocation();
+} // namespace impl
+
+// A move-only, type-erased nullary callable: the unit of work scheduled by
+// the task_system.
+//
+// Unlike std::function, a task does not require the callable to be copyable.
+// Callables of up to task::inline_size bytes that can be moved without
+// throwing are stored in place; larger callables are allocated on the heap.
+// The inline size is chosen to fit the lambdas used with task_group and
+// parallel_for in the library.
+
+class task {
+public:
+    static constexpr std::size_t inline_size = 64;
+
+    task() = default;
+    task(std::nullptr_t) {}
+
+    template <
+        typename F,
+        typename D = std::decay_t<F>,
+        typename = std::enable_if_t<!std::is_same<D, task>::value>
+    >
+    task(F&& f) {
+        emplace<D>(std::forward<F>(f), stored_inline<D>{});
+    }
+
+    task(task&& other) noexcept {
+        if (other.ops_) {
+            other.ops_->move(&storage_, &other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    task& operator=(task&& other) noexcept {
+        if (this!=&other) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    task& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task() { reset(); }
+
+    explicit operator bool() const { return ops_; }
+
+    void operator()() { ops_->invoke(&storage_); }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    using storage_type = std::aligned_storage_t<inline_size, alignof(std::max_align_t)>;
+
+    template <typename D>
+    using stored_inline = std::integral_constant<bool,
+        sizeof(D)<=inline_size &&
+        alignof(D)<=alignof(storage_type) &&
+        std::is_nothrow_move_constructible<D>::value>;
+
+    struct ops_table {
+        void (*invoke)(void*);
+        // Move-construct into the first argument, destroying the second.
+        void (*move)(void*, void*);
+        void (*destroy)(void*);
+    };
+
+    template <typename D>
+    struct inline_ops {
+        static void invoke(void* p) { (*static_cast<D*>(p))(); }
+        static void move(void* to, void* from) {
+            D* f = static_cast<D*>(from);
+            new (to) D(std::move(*f));
+            f->~D();
+        }
+        static void destroy(void* p) { static_cast<D*>(p)->~D(); }
+
+        static constexpr ops_table table = {invoke, move, destroy};
+    };
+
+    template <typename D>
+    struct heap_ops {
+        static D*& ptr(void* p) { return *static_cast<D**>(p); }
+
+        static void invoke(void* p) { (*ptr(p))(); }
+        static void move(void* to, void* from) { new (to) D*(ptr(from)); }
+        static void destroy(void* p) { delete ptr(p); }
+
+        static constexpr ops_table table = {invoke, move, destroy};
+    };
+
+    template <typename D, typename F>
+    void emplace(F&& f, std::true_type) {
+        new (&storage_) D(std::forward<F>(f));
+        ops_ = &inline_ops<D>::table;
+    }
+
+    template <typename D, typename F>
+    void emplace(F&& f, std::false_type) {
+        impl::count_allocation();
+        new (&storage_) D*(new D(std::forward<F>(f)));
+        ops_ = &heap_ops<D>::table;
+    }
+
+    storage_type storage_;
+    const ops_table* ops_ = nullptr;
+};
+
+template <typename D>
+constexpr task::ops_table task::inline_ops<D>::table;
+
+template <typename D>
+constexpr task::ops_table task::heap_ops<D>::table;
+
+} // namespace threading
+} // namespace arb
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "threading/task.hpp"
+#include "util/padded_alloc.hpp"
+
+namespace arb {
+namespace threading {
+namespace impl {
+
+// Lock-free work-stealing deque of pointers to T, following
+//
+//     D. Chase and Y. Lev, "Dynamic circular work-stealing deque",
+//     SPAA 2005,
+//
+// with the memory orderings of
+//
+//     N. M. Lê et al., "Correct and efficient work-stealing for weak
+//     memory models", PPoPP 2013.
+//
+// Buffer slots are accessed with acquire/release rather than relaxed
+// ordering, which costs nothing on x86 and lets race detectors that do not
+// model fences see the hand-off of the pointed-to objects.
+//
+// The owning thread pushes and pops at the bottom of the deque (LIFO);
+// any other thread may steal from the top (FIFO). The deque does not take
+// ownership of the pointed-to objects.
+//
+// When the circular buffer is full it is replaced by one of twice the
+// size. Replaced buffers are kept until the deque is destroyed, as
+// concurrent thieves may still be reading from them.
+
+template <typename T>
+class task_deque {
+    using index_type = std::int64_t;
+
+    struct ring {
+        index_type capacity;
+        std::unique_ptr<std::atomic<T*>[]> data;
+
+        explicit ring(index_type n): capacity(n), data(new std::atomic<T*>[n]) {}
+
+        T* get(index_type i) const {
+            return data[i&(capacity-1)].load(std::memory_order_acquire);
+        }
+
+        void put(index_type i, T* x) {
+            data[i&(capacity-1)].store(x, std::memory_order_release);
+        }
+    };
+
+    // top_ and bottom_ are on separate cache lines: top_ is written by
+    // thieves, bottom_ by the owner.
+    alignas(64) std::atomic<index_type> top_{0};
+    alignas(64) std::atomic<index_type> bottom_{0};
+    std::atomic<ring*> ring_;
+
+    // All buffers allocated by the owner, including retired ones.
+    std::vector<std::unique_ptr<ring>> rings_;
+
+    ring* grow(ring* r, index_type t, index_type b) {
+        count_allocation();
+        rings_.emplace_back(new ring(2*r->capacity));
+        ring* g = rings_.back().get();
+        for (index_type i = t; i<b; ++i) {
+            g->put(i, r->get(i));
+        }
+        ring_.store(g, std::memory_order_release);
+        return g;
+    }
+
+public:
+    // Plain new does not honour the over-alignment of top_ and bottom_
+    // before C++17.
+    static void* operator new(std::size_t size) {
+        return util::padded_allocator<char>(alignof(task_deque)).allocate(size);
+    }
+
+    static void operator delete(void* p, std::size_t size) {
+        util::padded_allocator<char>(alignof(task_deque)).deallocate(static_cast<char*>(p), size);
+    }
+
+    // Initial capacity must be a power of two.
+    explicit task_deque(index_type capacity = 256) {
+        count_allocation();
+        rings_.emplace_back(new ring(capacity));
+        ring_.store(rings_.back().get(), std::memory_order_relaxed);
+    }
+
+    task_deque(const task_deque&) = delete;
+    task_deque& operator=(const task_deque&) = delete;
+
+    // Owner only: push x onto the bottom of the deque.
+    void push(T* x) {
+        index_type b = bottom_.load(std::memory_order_relaxed);
+        index_type t = top_.load(std::memory_order_acquire);
+        ring* r = ring_.load(std::memory_order_relaxed);
+        if (b-t>r->capacity-1) {
+            r = grow(r, t, b);
+        }
+        r->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b+1, std::memory_order_relaxed);
+    }
+
+    // Owner only: pop from the bottom of the deque, returning nullptr if empty.
+    T* pop() {
+        index_type b = bottom_.load(std::memory_order_relaxed)-1;
+        ring* r = ring_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        index_type t = top_.load(std::memory_order_relaxed);
+
+        T* x = nullptr;
+        if (t<=b) {
+            x = r->get(b);
+            if (t==b) {
+                // Last element: race against thieves for it.
+                if (!top_.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    x = nullptr;
+                }
+                bottom_.store(b+1, std::memory_order_relaxed);
+            }
+        }
+        else {
+            bottom_.store(b+1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // Any thread: steal from the top of the deque. Returns nullptr if the
+    // deque is empty or if another thread won the race for the element.
+    T* steal() {
+        index_type t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        index_type b = bottom_.load(std::memory_order_acquire);
+
+        if (t<b) {
+            ring* r = ring_.load(std::memory_order_acquire);
+            T* x = r->get(t);
+            if (!top_.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return x;
+        }
+        return nullptr;
+    }
+
+    // Any thread: a snapshot of whether the deque is empty.
+    bool empty() const {
+        index_type b = bottom_.load(std::memory_order_acquire);
+        index_type t = top_.load(std::memory_order_acquire);
+        return b<=t;
+    }
+};
+
+} // namespace impl
+} // namespace threading
+} // namespace arb
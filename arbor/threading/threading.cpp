@@ -1,32 +1,102 @@
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
 
 #include "threading.hpp"
+#include "hardware/affinity.hpp"
 
 using namespace arb::threading::impl;
 using namespace arb::threading;
 using namespace arb;
 
+namespace {
+std::atomic<std::size_t> num_allocations{0};
+}
+
+std::size_t arb::threading::allocation_count() {
+    return num_allocations.load(std::memory_order_relaxed);
+}
+
+void arb::threading::impl::count_allocation() {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+task_pool::task_pool(unsigned nthreads): local_(nthreads) {
+    for (auto& c: local_) {
+        c.free.reserve(2*batch_size);
+    }
+}
+
+void task_pool::grow() {
+    count_allocation();
+    blocks_.emplace_back(new task[block_size]);
+    shared_.reserve(blocks_.size()*block_size);
+    for (std::size_t i = 0; i<block_size; ++i) {
+        shared_.push_back(&blocks_.back()[i]);
+    }
+}
+
+task* task_pool::get(int i) {
+    if (i<0) {
+        lock p_lock{mutex_};
+        if (shared_.empty()) grow();
+        task* t = shared_.back();
+        shared_.pop_back();
+        return t;
+    }
+
+    auto& free = local_[i].free;
+    if (free.empty()) {
+        lock p_lock{mutex_};
+        if (shared_.size()<batch_size) grow();
+        free.insert(free.end(), shared_.end()-batch_size, shared_.end());
+        shared_.resize(shared_.size()-batch_size);
+    }
+    task* t = free.back();
+    free.pop_back();
+    return t;
+}
+
+void task_pool::put(int i, task* t) {
+    t->reset();
+    if (i<0) {
+        lock p_lock{mutex_};
+        shared_.push_back(t);
+        return;
+    }
+
+    auto& free = local_[i].free;
+    free.push_back(t);
+    if (free.size()==2*batch_size) {
+        lock p_lock{mutex_};
+        shared_.insert(shared_.end(), free.end()-batch_size, free.end());
+        free.resize(batch_size);
+    }
+}
+
 task notification_queue::try_pop() {
-    task tsk;
     lock q_lock{q_mutex_, std::try_to_lock};
     if (q_lock && !q_tasks_.empty()) {
-        tsk = std::move(q_tasks_.front());
-        q_tasks_.pop_front();
+        return q_tasks_.pop_front();
     }
-    return tsk;
+    return nullptr;
 }
 
 task notification_queue::pop() {
-    task tsk;
     lock q_lock{q_mutex_};
     while (q_tasks_.empty() && !quit_) {
         q_tasks_available_.wait(q_lock);
     }
     if (!q_tasks_.empty()) {
-        tsk = std::move(q_tasks_.front());
-        q_tasks_.pop_front();
+        return q_tasks_.pop_front();
     }
-    return tsk;
+    return nullptr;
 }
 
 bool notification_queue::try_push(task& tsk) {
@@ -34,7 +104,7 @@ bool notification_queue::try_push(task& tsk) {
         lock q_lock{q_mutex_, std::try_to_lock};
         if (!q_lock) return false;
         q_tasks_.push_back(std::move(tsk));
-        tsk = 0;
+        tsk = nullptr;
     }
     q_tasks_available_.notify_all();
     return true;
@@ -56,7 +126,147 @@ void notification_queue::quit() {
     q_tasks_available_.notify_all();
 }
 
+namespace {
+// Pool membership of the calling thread: the id of the task_system
+// and the index of the thread in that system's pool.
+thread_local std::uint64_t tl_system_id = 0;
+thread_local int tl_index = -1;
+
+std::atomic<std::uint64_t> next_system_id{1};
+
+// Cheap per-thread pseudo-random numbers for victim selection (xorshift32).
+unsigned next_random() {
+    thread_local unsigned state = 2463534242u
+        ^ unsigned(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    state ^= state<<13;
+    state ^= state>>17;
+    state ^= state<<5;
+    return state;
+}
+} // anonymous namespace
+
+int task_system::current_index() const {
+    if (tl_system_id==id_) return tl_index;
+
+    // The thread that constructed the task_system is thread 0 of the pool.
+    // Its thread-local cache may refer to another task_system created since.
+    auto it = thread_ids_.find(std::this_thread::get_id());
+    if (it!=thread_ids_.end() && it->second==0) {
+        tl_system_id = id_;
+        tl_index = 0;
+        return 0;
+    }
+    return -1;
+}
+
+task* task_system::ws_steal(int i) {
+    const int n = count_;
+    if (n==1) return nullptr;
+
+    // Visit every other deque once, starting from a random victim.
+    int v = next_random()%n;
+    for (int k = 0; k<n; ++k, v = (v+1)%n) {
+        if (v==i) continue;
+        if (task* t = deques_[v]->steal()) return t;
+    }
+    return nullptr;
+}
+
+task* task_system::ws_find_task(int i) {
+    task* t = nullptr;
+    if (i>=0) {
+        t = deques_[i]->pop();
+        if (t) return t;
+    }
+
+    if (inject_size_.load(std::memory_order_relaxed)) {
+        lock q_lock{inject_mutex_};
+        if (!inject_.empty()) {
+            --inject_size_;
+            return inject_.pop_front();
+        }
+    }
+
+    return ws_steal(i);
+}
+
+bool task_system::ws_has_work() const {
+    if (inject_size_.load()) return true;
+    for (auto& d: deques_) {
+        if (!d->empty()) return true;
+    }
+    return false;
+}
+
+// Park the calling worker until a task is pushed. Returns false if the
+// task_system is shutting down.
+bool task_system::ws_park() {
+    lock p_lock{park_mutex_};
+    if (quit_) return false;
+    auto epoch = park_epoch_;
+    num_parked_.fetch_add(1);
+    p_lock.unlock();
+
+    // A task pushed before the increment of num_parked_ is visible here;
+    // a task pushed after it will bump the epoch (see ws_notify).
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ws_has_work()) {
+        num_parked_.fetch_sub(1);
+        return true;
+    }
+
+    p_lock.lock();
+    park_cv_.wait(p_lock, [&] { return quit_ || park_epoch_!=epoch; });
+    num_parked_.fetch_sub(1);
+    return true;
+}
+
+void task_system::ws_notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_parked_.load(std::memory_order_relaxed)) {
+        {
+            lock p_lock{park_mutex_};
+            ++park_epoch_;
+        }
+        park_cv_.notify_one();
+    }
+}
+
+void task_system::ws_run_tasks_loop(int i) {
+    tl_system_id = id_;
+    tl_index = i;
+
+    while (true) {
+        task* t = ws_find_task(i);
+
+        // Make a second attempt at stealing before parking, as the
+        // random victims visited may have been busy.
+        if (!t) t = ws_steal(i);
+        if (t) {
+            ws_run(i, t);
+        }
+        else if (!ws_park()) {
+            break;
+        }
+    }
+}
+
+// Run a task taken from a deque on pool thread i, and return it to the pool.
+void task_system::ws_run(int i, task* t) {
+    try {
+        (*t)();
+    }
+    catch (...) {
+        pool_.put(i, t);
+        throw;
+    }
+    pool_.put(i, t);
+}
+
 void task_system::run_tasks_loop(int i){
+    tl_system_id = id_;
+    tl_index = i;
+
     while (true) {
         task tsk;
         for (unsigned n = 0; n != count_; n++) {
@@ -69,42 +279,105 @@ void task_system::run_tasks_loop(int i){
     }
 }
 
-void task_system::try_run_task() {
+bool task_system::try_run_task() {
+    if (scheduler_==task_scheduler::work_stealing) {
+        int i = current_index();
+        if (task* t = ws_find_task(i)) {
+            ws_run(i, t);
+            return true;
+        }
+        return false;
+    }
+
     auto nthreads = get_num_threads();
-    task tsk;
     for (int n = 0; n != nthreads; n++) {
-        tsk = q_[n % nthreads].try_pop();
-        if (tsk) {
+        if (task tsk = q_[n % nthreads].try_pop()) {
             tsk();
-            break;
+            return true;
         }
     }
+    return false;
 }
 
 // Default construct with one thread.
 task_system::task_system(): task_system(1) {}
 
-task_system::task_system(int nthreads): count_(nthreads), q_(nthreads) {
+task_system::task_system(int nthreads, task_scheduler scheduler, const std::vector<int>& placement):
+    count_(nthreads),
+    scheduler_(scheduler),
+    q_(scheduler==task_scheduler::shared_queue? nthreads: 0),
+    pool_(scheduler==task_scheduler::work_stealing && nthreads>0? nthreads: 0),
+    id_(next_system_id++),
+    placement_(nthreads>0? nthreads: 0, -1)
+{
     if (nthreads <= 0)
         throw std::runtime_error("Non-positive number of threads in thread pool");
+    if (!placement.empty() && placement.size()!=count_)
+        throw std::runtime_error("Thread placement does not match number of threads in thread pool");
+
+    // Only the worker threads are pinned: thread 0 belongs to the caller,
+    // which may outlive the task_system or destroy it from another thread.
+    auto pin = [&](unsigned i, std::thread& thread) {
+        if (!placement.empty() && placement[i]>=0 && hw::set_affinity(thread, {placement[i]})) {
+            placement_[i] = placement[i];
+        }
+    };
+
+    const bool ws = scheduler_==task_scheduler::work_stealing;
+    if (ws) {
+        for (unsigned i = 0; i < count_; i++) {
+            deques_.emplace_back(new impl::task_deque<task>());
+        }
+    }
 
     // Main thread
     auto tid = std::this_thread::get_id();
     thread_ids_[tid] = 0;
+    tl_system_id = id_;
+    tl_index = 0;
 
     for (unsigned i = 1; i < count_; i++) {
-        threads_.emplace_back([this, i]{run_tasks_loop(i);});
+        if (ws) {
+            threads_.emplace_back([this, i]{ws_run_tasks_loop(i);});
+        }
+        else {
+            threads_.emplace_back([this, i]{run_tasks_loop(i);});
+        }
         tid = threads_.back().get_id();
         thread_ids_[tid] = i;
+        pin(i, threads_.back());
     }
 }
 
 task_system::~task_system() {
+    if (scheduler_==task_scheduler::work_stealing) {
+        {
+            lock p_lock{park_mutex_};
+            quit_ = true;
+        }
+        park_cv_.notify_all();
+    }
     for (auto& e: q_) e.quit();
     for (auto& e: threads_) e.join();
 }
 
 void task_system::async(task tsk) {
+    if (scheduler_==task_scheduler::work_stealing) {
+        int i = current_index();
+        task* t = pool_.get(i);
+        *t = std::move(tsk);
+        if (i>=0) {
+            deques_[i]->push(t);
+        }
+        else {
+            lock q_lock{inject_mutex_};
+            inject_.push_back(std::move(t));
+            ++inject_size_;
+        }
+        ws_notify();
+        return;
+    }
+
     auto i = index_++;
 
     for (unsigned n = 0; n != count_; n++) {
@@ -113,6 +386,66 @@ void task_system::async(task tsk) {
     q_[i % count_].push(std::move(tsk));
 }
 
+affinity_schedule::affinity_schedule(const std::vector<int>& owner, int nthreads):
+    nthreads_(nthreads),
+    items_(owner.size()),
+    divisions_(nthreads+1, 0),
+    cursors_(new cursor[nthreads])
+{
+    // Counting sort of the indices by owner.
+    for (int t: owner) {
+        if (t<0 || t>=nthreads) {
+            throw std::runtime_error("Owner of index in affinity_schedule is not a thread of the pool");
+        }
+        ++divisions_[t+1];
+    }
+    for (int t = 0; t<nthreads; ++t) {
+        divisions_[t+1] += divisions_[t];
+    }
+    std::vector<std::size_t> pos(divisions_.begin(), divisions_.end()-1);
+    for (std::size_t i = 0; i<owner.size(); ++i) {
+        items_[pos[owner[i]]++] = i;
+    }
+}
+
+void affinity_schedule::order_by_cost(const std::vector<double>& cost) {
+    for (int t = 0; t<nthreads_; ++t) {
+        std::sort(items_.begin()+divisions_[t], items_.begin()+divisions_[t+1],
+            [&cost](int a, int b) { return cost[a]>cost[b] || (cost[a]==cost[b] && a<b); });
+    }
+}
+
+std::vector<int> arb::threading::rebalance_owners(const std::vector<double>& cost, std::vector<int> owner, int nthreads) {
+    std::vector<double> load(nthreads, 0.);
+    for (std::size_t i = 0; i<cost.size(); ++i) {
+        load[owner[i]] += cost[i];
+    }
+
+    // Each move reduces the sum of the squares of the loads, so there are
+    // only finitely many; they are bounded by the number of indices anyway.
+    for (std::size_t moves = 0; moves<cost.size(); ++moves) {
+        const int hi = std::max_element(load.begin(), load.end())-load.begin();
+        const int lo = std::min_element(load.begin(), load.end())-load.begin();
+        const double diff = load[hi]-load[lo];
+
+        // Moving index i from hi to lo reduces the larger of their loads if
+        // 0<cost[i]<diff, and the most if cost[i] is diff/2.
+        int best = -1;
+        for (std::size_t i = 0; i<cost.size(); ++i) {
+            if (owner[i]!=hi || !(cost[i]>0 && cost[i]<diff)) continue;
+            if (best<0 || std::abs(cost[i]-diff/2)<std::abs(cost[best]-diff/2)) {
+                best = i;
+            }
+        }
+        if (best<0) break;
+
+        owner[best] = lo;
+        load[hi] -= cost[best];
+        load[lo] += cost[best];
+    }
+    return owner;
+}
+
 int task_system::get_num_threads() const {
     return threads_.size() + 1;
 }
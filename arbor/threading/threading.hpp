@@ -5,15 +5,22 @@
 #include <atomic>
 #include <condition_variable>
 #include <cstddef>
-#include <deque>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 #include <utility>
 
+#include <arbor/context.hpp>
+
+#include "threading/task.hpp"
+#include "threading/task_deque.hpp"
+
 namespace arb {
 namespace threading {
 
@@ -23,13 +30,87 @@ class task_group;
 using std::mutex;
 using lock = std::unique_lock<mutex>;
 using std::condition_variable;
-using task = std::function<void()>;
 
 namespace impl {
+// FIFO on a circular buffer, which grows as required but never shrinks,
+// so that in steady state pushing and popping do not allocate.
+template <typename T>
+class ring_buffer {
+    std::vector<T> buf_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+
+    void grow() {
+        count_allocation();
+        const auto n = buf_.size();
+        std::vector<T> b(2*n);
+        for (std::size_t i = 0; i<size_; ++i) {
+            b[i] = std::move(buf_[(head_+i)&(n-1)]);
+        }
+        buf_.swap(b);
+        head_ = 0;
+    }
+
+public:
+    // Capacity must be a power of two.
+    explicit ring_buffer(std::size_t capacity = 64): buf_(capacity) {
+        count_allocation();
+    }
+
+    bool empty() const { return size_==0; }
+    std::size_t size() const { return size_; }
+
+    void push_back(T&& x) {
+        if (size_==buf_.size()) grow();
+        buf_[(head_+size_)&(buf_.size()-1)] = std::move(x);
+        ++size_;
+    }
+
+    T pop_front() {
+        T x = std::move(buf_[head_]);
+        head_ = (head_+1)&(buf_.size()-1);
+        --size_;
+        return x;
+    }
+};
+
+// Free list of tasks for the work-stealing scheduler, whose deques hold
+// pointers to tasks. Each thread in the pool keeps a private cache of free
+// tasks, which exchanges tasks in batches with a shared, mutex-protected
+// free list. Tasks are allocated in blocks when the shared list runs out.
+class task_pool {
+public:
+    explicit task_pool(unsigned nthreads);
+
+    // Take a free task, on pool thread i (or -1 for other threads).
+    task* get(int i);
+
+    // Reset a task and return it to the pool, on pool thread i (or -1).
+    void put(int i, task* t);
+
+private:
+    static constexpr std::size_t batch_size = 16;
+    static constexpr std::size_t block_size = 256;
+
+    struct cache {
+        std::vector<task*> free;
+        // Pad to avoid false sharing between the caches of different threads.
+        char pad[64-sizeof(std::vector<task*>)];
+    };
+
+    std::vector<cache> local_;
+    mutex mutex_;
+    std::vector<task*> shared_;
+    std::vector<std::unique_ptr<task[]>> blocks_;
+
+    // Add a block of tasks to the shared list; requires lock on mutex_.
+    void grow();
+};
+
 class notification_queue {
 private:
     // FIFO of pending tasks.
-    std::deque<task> q_tasks_;
+    ring_buffer<task> q_tasks_;
 
     // Lock and signal on task availability change this is the crucial bit.
     mutex q_mutex_;
@@ -52,10 +133,28 @@ public:
 };
 }// namespace impl
 
+// The task_system schedules tasks on a pool of threads, according to one
+// of two strategies:
+//
+// task_scheduler::shared_queue
+//     Each thread has a mutex-protected FIFO queue. Tasks are pushed
+//     round-robin onto the queues, and threads pop from their own queue,
+//     trying the other queues first if their own is locked or empty.
+//
+// task_scheduler::work_stealing
+//     Each thread owns a lock-free task_deque. A thread pushes the tasks it
+//     creates onto its own deque and pops from it in LIFO order; when its
+//     deque is empty it steals from the top of the deques of randomly
+//     chosen threads. Threads that find no work park on a condition
+//     variable until a new task is pushed. Tasks created by threads that
+//     are not part of the pool go through a shared injection queue.
+
 class task_system {
 private:
     unsigned count_;
 
+    task_scheduler scheduler_;
+
     std::vector<std::thread> threads_;
 
     // queue of tasks
@@ -67,10 +166,43 @@ private:
     // total number of tasks pushed in all queues
     std::atomic<unsigned> index_{0};
 
+    // Work-stealing state: one deque per thread, the injection queue for
+    // tasks from threads outside the pool, and the parking lot.
+    std::vector<std::unique_ptr<impl::task_deque<task>>> deques_;
+    impl::task_pool pool_;
+    impl::ring_buffer<task*> inject_;
+    mutex inject_mutex_;
+    std::atomic<std::size_t> inject_size_{0};
+
+    mutex park_mutex_;
+    condition_variable park_cv_;
+    std::atomic<unsigned> num_parked_{0};
+    std::uint64_t park_epoch_ = 0; // guarded by park_mutex_
+    bool quit_ = false;            // guarded by park_mutex_
+
+    // Unique identifier, used to recognise the calling thread's pool index.
+    std::uint64_t id_;
+
+    // The cpu to which each thread is pinned, or -1. Thread 0 is the thread
+    // that created the task_system, and is never pinned.
+    std::vector<int> placement_;
+
+    void ws_run_tasks_loop(int i);
+    void ws_run(int i, task* t);
+    task* ws_find_task(int i);
+    task* ws_steal(int i);
+    bool ws_has_work() const;
+    bool ws_park();
+    void ws_notify();
+
 public:
     task_system();
-    // Create nthreads-1 new c std threads
-    task_system(int nthreads);
+    // Create nthreads-1 new c std threads. If placement is not empty, worker
+    // thread i>0 is pinned to cpu placement[i], where placement[i]>=0; the
+    // calling thread, thread 0, keeps its affinity.
+    task_system(int nthreads,
+                task_scheduler scheduler = task_scheduler::shared_queue,
+                const std::vector<int>& placement = {});
 
     // task_system is a singleton.
     task_system(const task_system&) = delete;
@@ -86,11 +218,20 @@ public:
 
     // Request that the task_system attempts to find and run a _single_ task.
     // Will return without executing a task if no tasks available.
-    void try_run_task();
+    // Returns true if a task was run.
+    bool try_run_task();
 
     // Includes master thread.
     int get_num_threads() const;
 
+    // Index of the calling thread in the pool, or -1 if it is not part of the pool.
+    int current_index() const;
+
+    task_scheduler scheduler() const { return scheduler_; }
+
+    // The cpu to which each thread is pinned, or -1 if it is not pinned.
+    const std::vector<int>& placement() const { return placement_; }
+
     // Returns the thread_id map
     std::unordered_map<std::thread::id, std::size_t> get_thread_ids() const;
 };
@@ -126,8 +267,8 @@ private:
     std::atomic<std::size_t> in_flight_{0};
 
     // Set by run(), cleared by wait(). Used to check task completion status
-    // in destructor.
-    bool running_ = false;
+    // in destructor. Atomic, as tasks in the group may themselves call run().
+    std::atomic<bool> running_{false};
 
     // We use a raw pointer here instead of a shared_ptr to avoid a race condition
     // on the destruction of a task_system that would lead to a thread trying to join itself.
@@ -157,20 +298,12 @@ public:
                 exception_status_(ex)
         {}
 
-        wrap(wrap&& other):
+        wrap(wrap&& other) noexcept(std::is_nothrow_move_constructible<F>::value):
                 f_(std::move(other.f_)),
                 counter_(other.counter_),
                 exception_status_(other.exception_status_)
         {}
 
-        // std::function is not guaranteed to not copy the contents on move construction,
-        // but the class is safe because we don't call operator() more than once on the same wrapped task.
-        wrap(const wrap& other):
-                f_(other.f_),
-                counter_(other.counter_),
-                exception_status_(other.exception_status_)
-        {}
-
         void operator()() {
             if (!exception_status_) {
                 try {
@@ -194,7 +327,7 @@ public:
 
     template<typename F>
     void run(F&& f) {
-        running_ = true;
+        running_.store(true, std::memory_order_relaxed);
         ++in_flight_;
         task_system_->async(make_wrapped_function(std::forward<F>(f), in_flight_, exception_status_));
     }
@@ -202,9 +335,11 @@ public:
     // Wait till all tasks in this group are done.
     void wait() {
         while (in_flight_) {
-            task_system_->try_run_task();
+            // Yield if there is nothing to do while waiting for tasks of
+            // this group that are running on other threads.
+            if (!task_system_->try_run_task()) std::this_thread::yield();
         }
-        running_ = false;
+        running_.store(false, std::memory_order_relaxed);
 
         if (auto ex = exception_status_.reset()) {
             std::rethrow_exception(ex);
@@ -219,16 +354,145 @@ public:
 ///////////////////////////////////////////////////////////////////////
 // algorithms
 ///////////////////////////////////////////////////////////////////////
+
+// Apply f(i) for each i in [left, right) in parallel.
+//
+// The index range is split recursively in halves: each split hands the
+// upper half to the task system as a new task and continues with the lower
+// half, until a range is no longer than the grain size, at which point the
+// indices are processed in a serial loop. This keeps the number of tasks
+// proportional to (right-left)/grain, and distributes task creation over
+// the worker threads instead of enqueuing every task from the caller.
+//
+// A grain size of 1 is appropriate when the cost per index is large or very
+// uneven (e.g. one index per cell group); otherwise use the automatic grain
+// size, which aims for parallel_for::chunks_per_thread chunks per thread.
 struct parallel_for {
+    // Number of chunks per thread targeted by the automatic grain size:
+    // more than one chunk per thread gives some slack for load balance.
+    static constexpr int chunks_per_thread = 8;
+
+    static int auto_grain_size(int left, int right, const task_system* ts) {
+        const int n = right-left;
+        const int nchunks = chunks_per_thread*ts->get_num_threads();
+        return std::max(1, (n+nchunks-1)/nchunks);
+    }
+
+    template <typename F>
+    static void apply(int left, int right, int grain, task_system* ts, F f) {
+        if (left>=right) return;
+
+        grain = std::max(grain, 1);
+        if (right-left<=grain || ts->get_num_threads()==1) {
+            for (int i = left; i < right; ++i) f(i);
+            return;
+        }
+
+        task_group g(ts);
+        g.run([=, &g, &f] { split(left, right, grain, g, f); });
+        g.wait();
+    }
+
     template <typename F>
     static void apply(int left, int right, task_system* ts, F f) {
+        apply(left, right, auto_grain_size(left, right, ts), ts, std::move(f));
+    }
+
+private:
+    template <typename F>
+    static void split(int left, int right, int grain, task_group& g, const F& f) {
+        while (right-left>grain) {
+            int mid = left + (right-left)/2;
+            g.run([=, &g, &f] { split(mid, right, grain, g, f); });
+            right = mid;
+        }
+        for (int i = left; i < right; ++i) f(i);
+    }
+};
+
+// Apply f(i) for each i in [0, n) in parallel, where each index is owned by
+// one thread of the pool.
+//
+// Each thread first processes the indices it owns, in order, and then helps
+// the other threads by taking indices from the front of their lists. As
+// long as the load is balanced, an index is processed by the same thread
+// each time the schedule is applied, so that the data it touches stays in
+// that thread's caches and in the memory of its socket.
+//
+// If all indices are owned by one thread, the threads take indices from a
+// single list in order, i.e. a dynamic list schedule.
+//
+// A schedule must not be applied concurrently from more than one thread.
+class affinity_schedule {
+public:
+    affinity_schedule() = default;
+
+    // owner[i] is the pool index, in [0, nthreads), of the owner of index i.
+    affinity_schedule(const std::vector<int>& owner, int nthreads);
+
+    std::size_t size() const { return items_.size(); }
+
+    // Order the indices owned by each thread by decreasing cost[i]. A
+    // thread then starts with its most expensive index, and other threads
+    // help by taking the most expensive indices that have not been started
+    // (longest processing time first). Ties are kept in index order.
+    void order_by_cost(const std::vector<double>& cost);
+
+    template <typename F>
+    void apply(task_system* ts, F f) {
+        if (items_.empty()) return;
+
+        if (nthreads_==1 || ts->get_num_threads()==1) {
+            for (auto i: items_) f(i);
+            return;
+        }
+
+        for (int t = 0; t<nthreads_; ++t) {
+            cursors_[t].next.store(divisions_[t], std::memory_order_relaxed);
+        }
+
         task_group g(ts);
-        for (int i = left; i < right; ++i) {
-          g.run([=] {f(i);});
+        for (int t = 0; t<nthreads_; ++t) {
+            g.run([this, ts, &f] { work(ts->current_index(), f); });
         }
         g.wait();
     }
+
+private:
+    struct cursor {
+        std::atomic<std::size_t> next;
+        // Pad to avoid false sharing between the cursors of different threads.
+        char pad[64-sizeof(std::atomic<std::size_t>)];
+    };
+
+    int nthreads_ = 0;
+    // Indices grouped by owner: thread t owns items_[divisions_[t], divisions_[t+1]).
+    std::vector<int> items_;
+    std::vector<std::size_t> divisions_;
+    std::unique_ptr<cursor[]> cursors_;
+
+    template <typename F>
+    void work(int self, const F& f) {
+        const int first = self>=0 && self<nthreads_? self: 0;
+        for (int k = 0; k<nthreads_; ++k) {
+            const int t = (first+k)%nthreads_;
+            const auto end = divisions_[t+1];
+            std::size_t j;
+            while ((j = cursors_[t].next.fetch_add(1, std::memory_order_relaxed))<end) {
+                f(items_[j]);
+            }
+        }
+    }
 };
+
+// Reassign indices with the given costs among nthreads owners, so that the
+// total cost of each owner is about equal, while moving as few indices as
+// possible from their current owner: an index keeps the memory that its owner
+// touched first. While it reduces the larger of their total costs, the index
+// of the most loaded owner with cost closest to half the difference between
+// it and the least loaded owner is moved to the latter. Ties are broken by
+// index and by owner, so that the result is deterministic.
+std::vector<int> rebalance_owners(const std::vector<double>& cost, std::vector<int> owner, int nthreads);
 } // namespace threading
 
 using task_system_handle = std::shared_ptr<threading::task_system>;
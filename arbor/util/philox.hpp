@@ -0,0 +1,55 @@
+#pragma once
+
+/* Philox4x32-10 counter-based random number generator.
+ *
+ * Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11.
+ *
+ * The output is a pure function of a 128-bit counter and a 64-bit key, so
+ * that the random numbers of a stream are determined by their position in
+ * the stream alone, independent of the order in which they are drawn.
+ */
+
+#include <array>
+#include <cstdint>
+
+namespace arb {
+namespace util {
+
+using philox_block = std::array<std::uint32_t, 4>;
+using philox_key = std::array<std::uint32_t, 2>;
+
+namespace impl {
+    inline void philox_round(philox_block& c, const philox_key& k) {
+        constexpr std::uint64_t m0 = 0xD2511F53u;
+        constexpr std::uint64_t m1 = 0xCD9E8D57u;
+
+        const std::uint64_t p0 = m0*c[0];
+        const std::uint64_t p1 = m1*c[2];
+
+        c = {{std::uint32_t(p1>>32)^c[1]^k[0], std::uint32_t(p1),
+              std::uint32_t(p0>>32)^c[3]^k[1], std::uint32_t(p0)}};
+    }
+} // namespace impl
+
+inline philox_block philox4x32(philox_block c, philox_key k) {
+    constexpr std::uint32_t w0 = 0x9E3779B9u;
+    constexpr std::uint32_t w1 = 0xBB67AE85u;
+
+    impl::philox_round(c, k);
+    for (unsigned i=1; i<10; ++i) {
+        k[0] += w0;
+        k[1] += w1;
+        impl::philox_round(c, k);
+    }
+    return c;
+}
+
+// A uniformly distributed double in (0, 1] from the first two words of a
+// Philox block.
+inline double philox_uniform(const philox_block& b) {
+    const std::uint64_t bits = (std::uint64_t(b[0])<<32) | b[1];
+    return double((bits>>11)+1)/double(std::uint64_t(1)<<53);
+}
+
+} // namespace util
+} // namespace arb
@@ -45,6 +45,12 @@ struct bench_params {
     unsigned num_cells = 1000;       // Number of cells in model.
     arb::time_type duration = 100;          // Simulation duration in ms.
 
+    // Spike exchange between ranks: with hierarchical exchange, groups of
+    // ranks_per_node ranks are treated as nodes (0 for all the ranks that
+    // share memory).
+    arb::spike_exchange exchange = arb::spike_exchange::allgather;
+    unsigned ranks_per_node = 0;
+
     cell_params cell;                // Cell parameters for all cells in model.
     network_params network;          // Description of the network.
 
@@ -158,9 +164,21 @@ int main(int argc, char** argv) {
 
 #ifdef ARB_MPI_ENABLED
         arbenv::with_mpi guard(argc, argv, false);
+        int world_rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+        is_root = world_rank == 0;
+#endif
+        std::cout << sup::mask_stream(is_root);
+
+        // The parameters are read first, as they select the spike exchange
+        // of the context.
+        bench_params params = read_options(argc, argv);
+        resources.exchange = params.exchange;
+        resources.ranks_per_node = params.ranks_per_node;
+
+#ifdef ARB_MPI_ENABLED
         resources.gpu_id = arbenv::find_private_gpu(MPI_COMM_WORLD);
         auto context = arb::make_context(resources, MPI_COMM_WORLD);
-        is_root = arb::rank(context) == 0;
 #else
         resources.gpu_id = arbenv::default_gpu();
         auto context = arb::make_context(resources);
@@ -169,10 +187,6 @@ int main(int argc, char** argv) {
         profile::profiler_initialize(context);
 #endif
 
-        std::cout << sup::mask_stream(is_root);
-
-        bench_params params = read_options(argc, argv);
-
         std::cout << params << "\n";
 
         profile::meter_manager meters;
@@ -216,11 +230,25 @@ int main(int argc, char** argv) {
     }
 }
 
+const char* exchange_name(arb::spike_exchange e) {
+    switch (e) {
+    case arb::spike_exchange::allgather: return "allgather";
+    case arb::spike_exchange::sparse: return "sparse";
+    case arb::spike_exchange::hierarchical: return "hierarchical";
+    }
+    return "";
+}
+
 std::ostream& operator<<(std::ostream& o, const bench_params& p) {
     o << "benchmark parameters:\n"
       << "  name:          " << p.name << "\n"
       << "  num cells:     " << p.num_cells << "\n"
       << "  duration:      " << p.duration << " ms\n"
+      << "  exchange:      " << exchange_name(p.exchange);
+    if (p.exchange==arb::spike_exchange::hierarchical) {
+        o << ", " << p.ranks_per_node << " ranks per node";
+    }
+    o << "\n"
       << "  fan in:        " << p.network.fan_in << " connections/cell\n"
       << "  min delay:     " << p.network.min_delay << " ms\n"
       << "  spike freq:    " << p.cell.spike_freq_hz << " Hz\n"
@@ -264,6 +292,16 @@ bench_params read_options(int argc, char** argv) {
     param_from_json(params.network.fan_in, "fan-in", json);
     param_from_json(params.cell.realtime_ratio, "realtime-ratio", json);
     param_from_json(params.cell.spike_freq_hz, "spike-frequency", json);
+    param_from_json(params.ranks_per_node, "ranks-per-node", json);
+
+    std::string exchange = exchange_name(params.exchange);
+    param_from_json(exchange, "exchange", json);
+    for (auto e: {arb::spike_exchange::allgather, arb::spike_exchange::sparse, arb::spike_exchange::hierarchical}) {
+        if (exchange==exchange_name(e)) params.exchange = e;
+    }
+    if (exchange!=exchange_name(params.exchange)) {
+        throw std::runtime_error("Unknown spike exchange: "+exchange);
+    }
 
     for (auto it=json.begin(); it!=json.end(); ++it) {
         std::cout << "  Warning: unused input parameter: \"" << it.key() << "\"\n";
@@ -3,6 +3,7 @@
 #include <string>
 
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
 #include <arbor/context.hpp>
 #include <arbor/version.hpp>
@@ -35,13 +36,16 @@ std::ostream& operator<<(std::ostream& o, const context_shim& ctx) {
 struct proc_allocation_shim {
     arb::util::optional<int> gpu_id = {};
     int num_threads = 1;
+    arb::thread_affinity affinity = arb::thread_affinity::none;
+    std::vector<int> cores;
 
-    proc_allocation_shim(int threads, pybind11::object gpu) {
+    proc_allocation_shim(int threads, pybind11::object gpu, pybind11::object affinity) {
         set_num_threads(threads);
         set_gpu_id(gpu);
+        set_affinity(affinity);
     }
 
-    proc_allocation_shim(): proc_allocation_shim(1, pybind11::none()) {}
+    proc_allocation_shim(): proc_allocation_shim(1, pybind11::none(), pybind11::none()) {}
 
     // getter and setter (in order to assert when being set)
     void set_gpu_id(pybind11::object gpu) {
@@ -53,18 +57,61 @@ struct proc_allocation_shim {
         num_threads = threads;
     };
 
+    // The affinity is one of None, 'compact', 'scatter', or a list of cpu ids.
+    void set_affinity(pybind11::object a) {
+        const char* err = "affinity must be None, 'compact', 'scatter', or a list of non-negative cpu ids";
+        cores.clear();
+        if (a.is_none()) {
+            affinity = arb::thread_affinity::none;
+        }
+        else if (pybind11::isinstance<pybind11::str>(a)) {
+            auto name = a.cast<std::string>();
+            pyarb::assert_throw(name=="compact" || name=="scatter", err);
+            affinity = name=="compact"? arb::thread_affinity::compact: arb::thread_affinity::scatter;
+        }
+        else {
+            try {
+                cores = a.cast<std::vector<int>>();
+            }
+            catch (pybind11::cast_error&) {
+                throw pyarb_error(err);
+            }
+            pyarb::assert_throw(!cores.empty(), err);
+            for (int c: cores) pyarb::assert_throw(c>=0, err);
+            affinity = arb::thread_affinity::list;
+        }
+    }
+
+    pybind11::object get_affinity() const {
+        switch (affinity) {
+        case arb::thread_affinity::compact: return pybind11::str("compact");
+        case arb::thread_affinity::scatter: return pybind11::str("scatter");
+        case arb::thread_affinity::list:    return pybind11::cast(cores);
+        default:                            return pybind11::none();
+        }
+    }
+
     arb::util::optional<int> get_gpu_id() const { return gpu_id; }
     int get_num_threads() const { return num_threads; }
     bool has_gpu() const { return bool(gpu_id); }
 
     // helper function to use arb::make_context(arb::proc_allocation)
     arb::proc_allocation allocation() const {
-        return arb::proc_allocation(num_threads, gpu_id.value_or(-1));
+        arb::proc_allocation alloc(num_threads, gpu_id.value_or(-1));
+        alloc.affinity = affinity;
+        alloc.cores = cores;
+        return alloc;
     }
 };
 
 std::ostream& operator<<(std::ostream& o, const proc_allocation_shim& alloc) {
-    return o << "<arbor.proc_allocation: threads " << alloc.num_threads << ", gpu_id " << alloc.gpu_id << ">";
+    o << "<arbor.proc_allocation: threads " << alloc.num_threads << ", gpu_id " << alloc.gpu_id << ", affinity ";
+    switch (alloc.affinity) {
+    case arb::thread_affinity::compact: return o << "compact>";
+    case arb::thread_affinity::scatter: return o << "scatter>";
+    case arb::thread_affinity::list:    return o << "[" << util::csv(alloc.cores) << "]>";
+    default:                            return o << "None>";
+    }
 }
 
 void register_contexts(pybind11::module& m) {
@@ -75,16 +122,20 @@ void register_contexts(pybind11::module& m) {
     pybind11::class_<proc_allocation_shim> proc_allocation(m, "proc_allocation",
         "Enumerates the computational resources on a node to be used for simulation.");
     proc_allocation
-        .def(pybind11::init<int, pybind11::object>(),
-            "threads"_a=1, "gpu_id"_a=pybind11::none(),
+        .def(pybind11::init<int, pybind11::object, pybind11::object>(),
+            "threads"_a=1, "gpu_id"_a=pybind11::none(), "affinity"_a=pybind11::none(),
             "Construct an allocation with arguments:\n"
-            "  threads: The number of threads available locally for execution, 1 by default.\n"
-            "  gpu_id:  The identifier of the GPU to use, None by default.\n")
+            "  threads:  The number of threads available locally for execution, 1 by default.\n"
+            "  gpu_id:   The identifier of the GPU to use, None by default.\n"
+            "  affinity: The pinning of threads to cpus, None by default.\n")
         .def_property("threads", &proc_allocation_shim::get_num_threads, &proc_allocation_shim::set_num_threads,
             "The number of threads available locally for execution.")
         .def_property("gpu_id", &proc_allocation_shim::get_gpu_id, &proc_allocation_shim::set_gpu_id,
             "The identifier of the GPU to use.\n"
             "Corresponds to the integer parameter used to identify GPUs in CUDA API calls.")
+        .def_property("affinity", &proc_allocation_shim::get_affinity, &proc_allocation_shim::set_affinity,
+            "The pinning of threads to cpus: None (not pinned), 'compact', 'scatter',\n"
+            "or a list of cpu ids, where thread i is pinned to cpu affinity[i%len(affinity)].")
         .def_property_readonly("has_gpu", &proc_allocation_shim::has_gpu,
             "Whether a GPU is being used (True/False).")
         .def("__str__",  util::to_string<proc_allocation_shim>)
@@ -159,6 +210,8 @@ void register_contexts(pybind11::module& m) {
             "Whether the context has a GPU.")
         .def_property_readonly("threads", [](const context_shim& ctx){return arb::num_threads(ctx.context);},
             "The number of threads in the context's thread pool.")
+        .def_property_readonly("placement", [](const context_shim& ctx){return arb::thread_placement(ctx.context);},
+            "The cpu to which each thread of the thread pool is pinned, or -1 if not pinned.")
         .def_property_readonly("ranks", [](const context_shim& ctx){return arb::num_ranks(ctx.context);},
             "The number of distributed domains (equivalent to the number of MPI ranks).")
         .def_property_readonly("rank", [](const context_shim& ctx){return arb::rank(ctx.context);},
@@ -72,6 +72,8 @@ void register_domain_decomposition(pybind11::module& m) {
                                         "Whether GPU usage is preferred.")
         .def_property_readonly_static("max_size",  [](pybind11::object) { return arb::partition_hint::max_size; },
                                         "Get the maximum size of cell groups.")
+        .def_property_readonly_static("auto_size",  [](pybind11::object) { return arb::partition_hint::auto_size; },
+                                        "Use as cpu_group_size to choose the size of cell groups automatically.")
         .def("__str__",  &ph_string)
         .def("__repr__", &ph_string);
 
@@ -87,6 +87,31 @@ class Contexts(unittest.TestCase):
         self.assertEqual(ctx.ranks, 1)
         self.assertEqual(ctx.rank, 0)
 
+    def test_affinity(self):
+        alloc = arb.proc_allocation(threads = 2)
+
+        # test that by default threads are not pinned
+        self.assertEqual(alloc.affinity, None)
+        self.assertEqual(arb.context(alloc).placement, [-1, -1])
+
+        alloc.affinity = 'compact'
+        self.assertEqual(alloc.affinity, 'compact')
+        self.assertEqual(len(arb.context(alloc).placement), 2)
+        alloc.affinity = 'scatter'
+        self.assertEqual(alloc.affinity, 'scatter')
+        alloc.affinity = [0]
+        self.assertEqual(alloc.affinity, [0])
+
+        with self.assertRaisesRegex(RuntimeError,
+            "affinity must be None, 'compact', 'scatter', or a list of non-negative cpu ids"):
+            alloc.affinity = 'spread'
+        with self.assertRaisesRegex(RuntimeError,
+            "affinity must be None, 'compact', 'scatter', or a list of non-negative cpu ids"):
+            alloc.affinity = [-1]
+        with self.assertRaisesRegex(RuntimeError,
+            "affinity must be None, 'compact', 'scatter', or a list of non-negative cpu ids"):
+            alloc.affinity = []
+
 def suite():
     # specify class and test functions in tuple (here: all tests starting with 'test' from class Contexts
     suite = unittest.makeSuite(Contexts, ('test'))
@@ -0,0 +1,109 @@
+// Compare serial and parallel generation of the post-synaptic events from a
+// set of global spikes, as performed by communicator::make_event_queues.
+//
+// With one thread, the communicator looks up the spikes in the connections
+// of all the cells in a single task; with more threads, the local cells are
+// divided into one block per thread, and the spikes are looked up in the
+// connections of each block by its own task, writing only the events of its
+// own cells.
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <arbor/context.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/communicator.hpp"
+#include "communication/gathered_vector.hpp"
+#include "execution_context.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace arb;
+
+// Cells with a fixed number of incoming connections from random sources.
+class random_recipe: public recipe {
+public:
+    random_recipe(cell_size_type ncells, unsigned ncons): ncells_(ncells), ncons_(ncons) {}
+
+    cell_size_type num_cells() const override { return ncells_; }
+
+    util::unique_any get_cell_description(cell_gid_type) const override { return {}; }
+
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::spike_source; }
+
+    std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+        std::mt19937 gen(gid);
+        std::uniform_int_distribution<cell_gid_type> src_dist(0, ncells_-1);
+
+        std::vector<cell_connection> conns;
+        for (unsigned i = 0; i<ncons_; ++i) {
+            conns.push_back({{src_dist(gen), 0}, {gid, i}, 1.f, 1.f});
+        }
+        return conns;
+    }
+
+private:
+    cell_size_type ncells_;
+    unsigned ncons_;
+};
+
+void make_event_queues(benchmark::State& state) {
+    const cell_size_type ncells = 10000;
+    const std::size_t nspikes = state.range(0);
+    const unsigned ncons = state.range(1);
+    const unsigned nthreads = state.range(2);
+
+    execution_context ctx(proc_allocation(nthreads, -1));
+    random_recipe rec(ncells, ncons);
+
+    // All cells in a single group on a single domain.
+    domain_decomposition decomp;
+    decomp.num_domains = 1;
+    decomp.domain_id = 0;
+    decomp.num_local_cells = ncells;
+    decomp.num_global_cells = ncells;
+    decomp.gid_domain = [](cell_gid_type) { return 0; };
+    std::vector<cell_gid_type> gids(ncells);
+    std::iota(gids.begin(), gids.end(), 0);
+    decomp.groups.push_back({cell_kind::spike_source, std::move(gids), backend_kind::multicore});
+
+    communicator comm(rec, decomp, ctx);
+
+    // Spikes from random sources, sorted by source.
+    std::mt19937 gen;
+    std::uniform_int_distribution<cell_gid_type> src_dist(0, ncells-1);
+    std::uniform_real_distribution<time_type> time_dist(0, 1);
+    std::vector<spike> spikes;
+    for (std::size_t i = 0; i<nspikes; ++i) {
+        spikes.push_back({{src_dist(gen), 0}, time_dist(gen)});
+    }
+    std::sort(spikes.begin(), spikes.end(),
+        [](const spike& a, const spike& b) { return a.source<b.source; });
+    gathered_vector<spike> global_spikes(std::move(spikes), {0u, unsigned(nspikes)});
+
+    cell_event_buffer queues;
+    while (state.KeepRunning()) {
+        comm.make_event_queues(global_spikes, queues);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations()*nspikes);
+}
+
+void event_generation_args(benchmark::internal::Benchmark *b) {
+    for (int nthreads: {1, 2, 4, 8}) {
+        for (int nspikes: {1000, 10000, 100000}) {
+            for (int ncons: {10, 100}) {
+                b->Args({nspikes, ncons, nthreads});
+            }
+        }
+    }
+}
+
+BENCHMARK(make_event_queues)->Apply(event_generation_args)->UseRealTime();
+
+BENCHMARK_MAIN();
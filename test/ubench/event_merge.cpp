@@ -0,0 +1,152 @@
+// Compare methods for merging the sorted event sequences of one cell, as
+// performed by tree_merge_events when a cell has event generators: the
+// tournament tree that tree_merge_events used to be based on, the current
+// tree_merge_events, which chooses a two-way merge cascade or a loser tree
+// by the number of sequences, and the loser tree on its own.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "merge_events.hpp"
+#include "util/rangeutil.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace arb;
+
+// The tournament tree previously used by tree_merge_events: a heap of
+// (sequence, event) pairs, in which every node holds the winner of the
+// match between its children, with exhausted sequences represented by an
+// event at terminal_time.
+class tourney_tree {
+    using key_val = std::pair<unsigned, spike_event>;
+
+public:
+    tourney_tree(std::vector<event_span>& input): input_(input), n_lanes_(input.size()) {
+        leaves_ = 1;
+        while (leaves_<n_lanes_) leaves_ *= 2;
+        nodes_ = 2*leaves_-1;
+        heap_.resize(nodes_);
+        for (unsigned i=0; i<leaves_; ++i) {
+            heap_[leaf(i)] = key_val(i, i<n_lanes_ && !input[i].empty()? input[i].front(): terminal());
+        }
+        setup(0);
+    }
+
+    bool empty() const { return heap_[0].second.time==terminal_time; }
+    spike_event head() const { return heap_[0].second; }
+
+    void pop() {
+        unsigned lane = heap_[0].first;
+        unsigned i = leaf(lane);
+        auto& in = input_[lane];
+        if (!in.empty()) ++in.left;
+        heap_[i].second = in.empty()? terminal(): in.front();
+        while ((i=parent(i))) merge_up(i);
+        merge_up(0);
+    }
+
+private:
+    static spike_event terminal() { return {{0, 0}, terminal_time, 0}; }
+
+    void setup(unsigned i) {
+        if (i>=leaves_-1) return;
+        setup(2*i+1);
+        setup(2*i+2);
+        merge_up(i);
+    }
+    void merge_up(unsigned i) {
+        auto l = 2*i+1, r = 2*i+2;
+        heap_[i] = heap_[l].second<heap_[r].second? heap_[l]: heap_[r];
+    }
+    unsigned parent(unsigned i) const { return (i-1)>>1; }
+    unsigned leaf(unsigned i) const { return i+leaves_-1; }
+
+    std::vector<key_val> heap_;
+    std::vector<event_span>& input_;
+    unsigned leaves_, nodes_, n_lanes_;
+};
+
+// k sorted sequences of events with delivery times in [0, 1), as from k
+// event generators.
+std::vector<pse_vector> make_sequences(unsigned k, unsigned n) {
+    std::mt19937 gen;
+    std::uniform_real_distribution<time_type> time_dist(0, 1);
+
+    std::vector<pse_vector> seqs(k);
+    for (unsigned i=0; i<k; ++i) {
+        for (unsigned j=0; j<n; ++j) {
+            seqs[i].push_back({{0, i}, time_dist(gen), 1.f});
+        }
+        util::sort(seqs[i]);
+    }
+    return seqs;
+}
+
+std::vector<event_span> make_spans(const std::vector<pse_vector>& seqs) {
+    std::vector<event_span> spans;
+    for (auto& s: seqs) spans.push_back(util::range_pointer_view(s));
+    return spans;
+}
+
+// The number of sequences and of events per sequence are given by the
+// first and second arguments.
+
+void merge_tourney(benchmark::State& state) {
+    auto seqs = make_sequences(state.range(0), state.range(1));
+    pse_vector out;
+    while (state.KeepRunning()) {
+        out.clear();
+        auto spans = make_spans(seqs);
+        tourney_tree tree(spans);
+        while (!tree.empty()) {
+            out.push_back(tree.head());
+            tree.pop();
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+void merge_tree_merge_events(benchmark::State& state) {
+    auto seqs = make_sequences(state.range(0), state.range(1));
+    pse_vector out;
+    while (state.KeepRunning()) {
+        out.clear();
+        auto spans = make_spans(seqs);
+        tree_merge_events(spans, out);
+        benchmark::ClobberMemory();
+    }
+}
+
+void merge_loser_tree(benchmark::State& state) {
+    auto seqs = make_sequences(state.range(0), state.range(1));
+    pse_vector out;
+    while (state.KeepRunning()) {
+        out.clear();
+        auto spans = make_spans(seqs);
+        impl::loser_tree tree(spans);
+        while (!tree.empty()) {
+            out.push_back(tree.head());
+            tree.pop();
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+void merge_arguments(benchmark::internal::Benchmark* b) {
+    for (int k: {2, 3, 4, 8, 16, 64, 256, 1024}) {
+        for (int n: {16, 256}) {
+            b->Args({k, n});
+        }
+    }
+}
+
+BENCHMARK(merge_tourney)->Apply(merge_arguments);
+BENCHMARK(merge_tree_merge_events)->Apply(merge_arguments);
+BENCHMARK(merge_loser_tree)->Apply(merge_arguments);
+
+BENCHMARK_MAIN();
@@ -11,6 +11,7 @@
 // a deliverable event.
 
 #include <algorithm>
+#include <cmath>
 #include <random>
 #include <vector>
 #include <algorithm>
@@ -19,6 +20,8 @@
 
 #include "event_queue.hpp"
 #include "backends/event.hpp"
+#include "merge_events.hpp"
+#include "util/rangeutil.hpp"
 
 using namespace arb;
 
@@ -190,6 +193,68 @@ void n_vector(benchmark::State& state) {
     }
 }
 
+// Sort the pending events of each cell, as in simulation::setup_events,
+// stored contiguously by cell in one buffer.
+//
+// The number of events per cell (the fan-in over one epoch) is either
+// Poisson distributed about the mean (0), or log-normal with the same mean
+// (1), where a few cells receive many more events than the rest. The events
+// are delivered at spike times on a grid of 0.025 ms in an epoch of 0.5 ms,
+// plus a delay uniform in [1, 5) ms.
+//
+// The sort is std::sort (0) or sort_events (1).
+void sort_lanes(benchmark::State& state) {
+    const std::size_t ncells = state.range(0);
+    const double fan_in = state.range(1);
+    const bool heavy_tail = state.range(2);
+    const bool radix = state.range(3);
+
+    std::mt19937 gen;
+    std::poisson_distribution<std::size_t> poisson(fan_in);
+    // The mean of the log-normal distribution is exp(mu+sigma^2/2).
+    const double sigma = 1;
+    std::lognormal_distribution<double> lognormal(std::log(fan_in)-sigma*sigma/2, sigma);
+    std::uniform_int_distribution<int> step(0, 19);
+    std::uniform_real_distribution<double> delay(1, 5);
+
+    std::vector<std::size_t> divisions(1, 0);
+    std::vector<spike_event> input;
+    for (std::size_t i=0; i<ncells; ++i) {
+        std::size_t n = heavy_tail? std::size_t(lognormal(gen)): poisson(gen);
+        for (std::size_t j=0; j<n; ++j) {
+            input.push_back({{cell_gid_type(i), cell_lid_type(j%10)}, time_type(0.025*step(gen)+delay(gen)), 1.f});
+        }
+        divisions.push_back(input.size());
+    }
+
+    std::vector<spike_event> events(input.size());
+    std::vector<spike_event> scratch(input.size());
+    while (state.KeepRunning()) {
+        std::copy(input.begin(), input.end(), events.begin());
+        for (std::size_t i=0; i<ncells; ++i) {
+            auto lane = util::make_range(events.data()+divisions[i], events.data()+divisions[i+1]);
+            if (radix) {
+                sort_events(lane, scratch.data()+divisions[i]);
+            }
+            else {
+                std::sort(lane.begin(), lane.end());
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations()*input.size());
+}
+
+void sort_lanes_arguments(benchmark::internal::Benchmark* b) {
+    for (auto fan_in: {16, 64, 256, 1024, 4096}) {
+        for (auto heavy_tail: {0, 1}) {
+            for (auto radix: {0, 1}) {
+                b->Args({1000, fan_in, heavy_tail, radix});
+            }
+        }
+    }
+}
+
 void run_custom_arguments(benchmark::internal::Benchmark* b) {
     for (auto ncells: {1, 10, 100, 1000, 10000}) {
         for (auto ev_per_cell: {128, 256, 512, 1024, 2048, 4096}) {
@@ -202,5 +267,6 @@ void run_custom_arguments(benchmark::internal::Benchmark* b) {
 BENCHMARK(single_queue)->Apply(run_custom_arguments);
 BENCHMARK(n_queue)->Apply(run_custom_arguments);
 BENCHMARK(n_vector)->Apply(run_custom_arguments);
+BENCHMARK(sort_lanes)->Apply(sort_lanes_arguments);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,141 @@
+// Compare methods for staging the events of the cells of a cable cell group
+// for delivery in an epoch: the method mc_cell_group::advance used to
+// follow, which orders the cells by integration domain in every epoch,
+// merges the events of the cells of each integration domain one cell at a
+// time with std::inplace_merge, and copies the staged events to the lowered
+// cell, against event_stager.
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+#include <arbor/spike_event.hpp>
+#include <arbor/util/lexcmp_def.hpp>
+
+#include "backends/event.hpp"
+#include "cell_group.hpp"
+#include "event_stager.hpp"
+#include "util/rangeutil.hpp"
+#include "util/span.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace arb {
+ARB_DEFINE_LEXICOGRAPHIC_ORDERING(arb::target_handle,(a.mech_id,a.mech_index,a.intdom_index),(b.mech_id,b.mech_index,b.intdom_index))
+ARB_DEFINE_LEXICOGRAPHIC_ORDERING(arb::deliverable_event,(a.time,a.handle,a.weight),(b.time,b.handle,b.weight))
+}
+
+using namespace arb;
+
+// Events are delivered in an epoch of 0.5 ms; the lanes also hold events of
+// the next epoch.
+constexpr time_type tfinal = 0.5;
+
+struct group {
+    std::vector<fvm_index_type> cell_to_intdom;
+    std::vector<pse_vector> lanes;
+    std::size_t num_events = 0;
+};
+
+// The number of cells, the number of cells per integration domain, and the
+// mean number of events per cell in the epoch are given by the arguments.
+group make_group(unsigned ncells, unsigned cells_per_intdom, unsigned nevents) {
+    std::mt19937 gen(ncells);
+    std::uniform_real_distribution<time_type> time_dist(0, 2*tfinal);
+
+    group g;
+    for (unsigned i=0; i<ncells; ++i) {
+        // Cells of an integration domain are not contiguous in the group.
+        g.cell_to_intdom.push_back((i*7)%ncells/cells_per_intdom);
+    }
+    g.lanes.resize(ncells);
+    for (unsigned i=0; i<ncells; ++i) {
+        for (unsigned j=0; j<2*nevents; ++j) {
+            g.lanes[i].push_back({{i, j}, time_dist(gen), 1.f});
+        }
+        util::sort(g.lanes[i]);
+        for (auto& e: g.lanes[i]) g.num_events += e.time<tfinal;
+    }
+    return g;
+}
+
+deliverable_event to_event(const group& g, cell_size_type i, const spike_event& e) {
+    return deliverable_event(e.time, target_handle(0, e.target.index, g.cell_to_intdom[i]), e.weight);
+}
+
+void staging_inplace_merge(benchmark::State& state) {
+    auto g = make_group(state.range(0), state.range(1), state.range(2));
+    auto lanes = util::subrange_view(g.lanes, 0, g.lanes.size());
+    std::vector<deliverable_event> staged_events;
+
+    while (state.KeepRunning()) {
+        staged_events.clear();
+
+        std::vector<cell_size_type> idx_sorted_by_intdom(g.cell_to_intdom.size());
+        std::iota(idx_sorted_by_intdom.begin(), idx_sorted_by_intdom.end(), 0);
+        util::sort_by(idx_sorted_by_intdom, [&](cell_size_type i) { return g.cell_to_intdom[i]; });
+
+        fvm_index_type ev_begin = 0, ev_mid = 0, ev_end = 0;
+        fvm_index_type prev_intdom = -1;
+        for (auto i: util::count_along(g.lanes)) {
+            unsigned count_staged = 0;
+
+            auto lid = idx_sorted_by_intdom[i];
+            auto curr_intdom = g.cell_to_intdom[lid];
+
+            for (auto e: lanes[lid]) {
+                if (e.time>=tfinal) break;
+                staged_events.push_back(to_event(g, lid, e));
+                count_staged++;
+            }
+
+            ev_end += count_staged;
+
+            if (curr_intdom != prev_intdom) {
+                ev_begin = ev_end - count_staged;
+                prev_intdom = curr_intdom;
+            }
+            else {
+                std::inplace_merge(staged_events.begin() + ev_begin,
+                                   staged_events.begin() + ev_mid,
+                                   staged_events.begin() + ev_end);
+            }
+
+            ev_mid = ev_end;
+        }
+
+        // The staged events were passed by value to the lowered cell.
+        auto copy = staged_events;
+        benchmark::DoNotOptimize(copy.data());
+    }
+    state.SetItemsProcessed(state.iterations()*g.num_events);
+}
+
+void staging_event_stager(benchmark::State& state) {
+    auto g = make_group(state.range(0), state.range(1), state.range(2));
+    auto lanes = util::subrange_view(g.lanes, 0, g.lanes.size());
+    event_stager stager(g.cell_to_intdom);
+
+    while (state.KeepRunning()) {
+        auto& staged = stager.stage(lanes, tfinal,
+            [&](cell_size_type i, const spike_event& e) { return to_event(g, i, e); });
+        benchmark::DoNotOptimize(staged.data());
+    }
+    state.SetItemsProcessed(state.iterations()*g.num_events);
+}
+
+void staging_arguments(benchmark::internal::Benchmark* b) {
+    for (int per_intdom: {1, 4, 64}) {
+        for (int nevents: {10, 100}) {
+            b->Args({256, per_intdom, nevents});
+        }
+    }
+}
+
+BENCHMARK(staging_inplace_merge)->Apply(staging_arguments);
+BENCHMARK(staging_event_stager)->Apply(staging_arguments);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,82 @@
+// Compare the generation of the events of many Poisson inputs to one cell:
+// one poisson_generator per input, the sequences of which are merged by
+// tree_merge_events as in the simulation, against a single
+// poisson_population_generator for all the inputs.
+
+#include <random>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/event_generator.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "merge_events.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace arb;
+
+// Events are generated for 50 epochs of 0.5 ms.
+constexpr time_type epoch = 0.5;
+constexpr unsigned num_epochs = 50;
+
+// The number of inputs and the rate of each input in Hz are given by the
+// first and second arguments.
+
+void poisson_generators(benchmark::State& state) {
+    const unsigned n = state.range(0);
+    const time_type rate_kHz = state.range(1)*1e-3;
+
+    std::vector<event_generator> gens;
+    for (unsigned i=0; i<n; ++i) {
+        gens.push_back(poisson_generator({0, i}, 1.f, 0, rate_kHz, std::mt19937_64(i)));
+    }
+
+    std::vector<event_span> spans;
+    pse_vector out;
+    while (state.KeepRunning()) {
+        for (auto& g: gens) g.reset();
+        for (unsigned e=0; e<num_epochs; ++e) {
+            spans.clear();
+            for (auto& g: gens) {
+                event_span evs = g.events(e*epoch, (e+1)*epoch);
+                spans.push_back(evs);
+            }
+            out.clear();
+            tree_merge_events(spans, out);
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+void poisson_population(benchmark::State& state) {
+    const unsigned n = state.range(0);
+    const time_type rate_kHz = state.range(1)*1e-3;
+
+    std::vector<poisson_population_generator::input> inputs;
+    for (unsigned i=0; i<n; ++i) {
+        inputs.push_back({{0, i}, 1.f, rate_kHz});
+    }
+    event_generator gen = poisson_population_generator(inputs, 0);
+
+    while (state.KeepRunning()) {
+        gen.reset();
+        for (unsigned e=0; e<num_epochs; ++e) {
+            benchmark::DoNotOptimize(gen.events(e*epoch, (e+1)*epoch));
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+void poisson_arguments(benchmark::internal::Benchmark* b) {
+    for (int n: {16, 256, 1024, 4096}) {
+        for (int rate_Hz: {10, 100}) {
+            b->Args({n, rate_Hz});
+        }
+    }
+}
+
+BENCHMARK(poisson_generators)->Apply(poisson_arguments);
+BENCHMARK(poisson_population)->Apply(poisson_arguments);
+
+BENCHMARK_MAIN();
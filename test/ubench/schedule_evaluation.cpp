@@ -0,0 +1,90 @@
+// Compare the evaluation of the schedules of many spike sources in one
+// epoch: one call to schedule::events per schedule, with the times copied
+// to a spike per time, as spike_source_cell_group did, against
+// evaluate_schedules into one flat buffer.
+
+#include <random>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/schedule.hpp>
+#include <arbor/spike.hpp>
+
+#include "util/rangeutil.hpp"
+#include "util/span.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace arb;
+
+// Schedules are evaluated for 50 epochs of 0.5 ms.
+constexpr time_type epoch = 0.5;
+constexpr unsigned num_epochs = 50;
+
+// The first argument is the number of schedules; the second selects
+// regular schedules with a period of 0.1 ms (0) or 0.01 ms (1), or Poisson
+// schedules with a rate of 10 kHz (2).
+std::vector<schedule> make_schedules(unsigned n, int kind) {
+    std::vector<schedule> scheds;
+    for (unsigned i=0; i<n; ++i) {
+        scheds.push_back(
+            kind==0? regular_schedule(0.01*(i%10), 0.1):
+            kind==1? regular_schedule(0.001*(i%10), 0.01):
+            poisson_schedule(10., std::mt19937_64(i)));
+    }
+    return scheds;
+}
+
+void schedule_events(benchmark::State& state) {
+    auto scheds = make_schedules(state.range(0), state.range(1));
+    std::vector<spike> spikes;
+
+    while (state.KeepRunning()) {
+        for (auto& s: scheds) s.reset();
+        for (unsigned e=0; e<num_epochs; ++e) {
+            spikes.clear();
+            for (auto i: util::count_along(scheds)) {
+                for (auto t: util::make_range(scheds[i].events(e*epoch, (e+1)*epoch))) {
+                    spikes.push_back({{cell_gid_type(i), 0u}, t});
+                }
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+void evaluate_schedules(benchmark::State& state) {
+    auto scheds = make_schedules(state.range(0), state.range(1));
+    std::vector<spike> spikes;
+    std::vector<time_type> times;
+    std::vector<std::size_t> offsets;
+
+    while (state.KeepRunning()) {
+        for (auto& s: scheds) s.reset();
+        for (unsigned e=0; e<num_epochs; ++e) {
+            evaluate_schedules(scheds, e*epoch, (e+1)*epoch, times, offsets);
+            spikes.resize(times.size());
+            std::size_t k = 0;
+            for (auto i: util::count_along(scheds)) {
+                const cell_member_type source{cell_gid_type(i), 0u};
+                for (auto j = offsets[i]; j<offsets[i+1]; ++j) {
+                    spikes[k++] = {source, times[j]};
+                }
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+void schedule_arguments(benchmark::internal::Benchmark* b) {
+    for (int kind: {0, 1, 2}) {
+        for (int n: {16, 256, 4096}) {
+            b->Args({n, kind});
+        }
+    }
+}
+
+BENCHMARK(schedule_events)->Apply(schedule_arguments);
+BENCHMARK(evaluate_schedules)->Apply(schedule_arguments);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,118 @@
+// Compare the exchange of spikes and the generation of the events of the
+// exchanged spikes, for raw spikes and for spikes in the compact encoding,
+// where the spikes are decoded as the events are generated.
+//
+// With a local context there is no communication: the benchmark measures
+// the cost of encoding and decoding, which must be won back by the smaller
+// volume of spikes exchanged between domains.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/communicator.hpp"
+#include "communication/spike_encoding.hpp"
+#include "execution_context.hpp"
+#include "util/rangeutil.hpp"
+#include "util/span.hpp"
+#include "util/strprintf.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace arb;
+
+// 1000 local cells, each with 100 connections from random sources among
+// num_source_cells cells.
+constexpr cell_size_type num_local_cells = 1000;
+constexpr cell_size_type fan_in = 100;
+constexpr cell_size_type num_source_cells = 100000;
+
+class random_recipe: public recipe {
+public:
+    cell_size_type num_cells() const override { return num_source_cells; }
+    util::unique_any get_cell_description(cell_gid_type) const override { return {}; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::cable; }
+
+    std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+        std::mt19937 gen(gid);
+        std::uniform_int_distribution<cell_gid_type> source_dist(0, num_source_cells-1);
+        std::vector<cell_connection> cons;
+        for (auto i: util::make_span(fan_in)) {
+            cons.push_back(cell_connection({source_dist(gen), 0}, {gid, i}, 1.f, 2.f));
+        }
+        return cons;
+    }
+};
+
+struct model {
+    random_recipe rec;
+    execution_context ctx;
+    domain_decomposition dom_dec;
+    std::vector<spike> spikes;
+
+    // Every cell in 1 of every n fires once, in an epoch of 1 ms at time t.
+    model(unsigned n, time_type t, spike_encoding encoding) {
+        ctx.encoding = encoding;
+
+        dom_dec.num_domains = 1;
+        dom_dec.domain_id = 0;
+        dom_dec.num_local_cells = num_local_cells;
+        dom_dec.num_global_cells = num_source_cells;
+        dom_dec.gid_domain = [](cell_gid_type) { return 0; };
+        dom_dec.groups.push_back({cell_kind::cable, util::assign_from(util::make_span(num_local_cells)), backend_kind::multicore});
+
+        std::mt19937 gen(n);
+        std::uniform_real_distribution<time_type> time_dist(t, t+1);
+        for (cell_gid_type gid = 0; gid<num_source_cells; gid += n) {
+            spikes.push_back({{gid, 0}, time_dist(gen)});
+        }
+    }
+};
+
+void exchange_raw(benchmark::State& state) {
+    model m(state.range(0), state.range(1), spike_encoding::raw);
+    communicator comm(m.rec, m.dom_dec, m.ctx);
+    cell_event_buffer queues;
+
+    while (state.KeepRunning()) {
+        auto global_spikes = comm.exchange(m.spikes);
+        comm.make_event_queues(global_spikes, queues);
+        benchmark::DoNotOptimize(queues.events.data());
+    }
+    state.SetLabel(util::strprintf("%zu bytes/spike", sizeof(spike)).c_str());
+    state.SetItemsProcessed(state.iterations()*m.spikes.size());
+}
+
+void exchange_compact(benchmark::State& state) {
+    model m(state.range(0), state.range(1), spike_encoding::compact);
+    communicator comm(m.rec, m.dom_dec, m.ctx);
+    cell_event_buffer queues;
+    std::size_t bytes = 0;
+
+    while (state.KeepRunning()) {
+        auto encoded = comm.exchange_encoded(m.spikes);
+        comm.make_event_queues(encoded, queues);
+        benchmark::DoNotOptimize(queues.events.data());
+        bytes = encoded.size();
+    }
+    state.SetLabel(util::strprintf("%.2f bytes/spike", double(bytes)/m.spikes.size()).c_str());
+    state.SetItemsProcessed(state.iterations()*m.spikes.size());
+}
+
+void exchange_arguments(benchmark::internal::Benchmark* b) {
+    for (int t: {10, 1000}) {
+        for (int n: {1, 10, 100}) {
+            b->Args({n, t});
+        }
+    }
+}
+
+BENCHMARK(exchange_raw)->Apply(exchange_arguments);
+BENCHMARK(exchange_compact)->Apply(exchange_arguments);
+
+BENCHMARK_MAIN();
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 #include <arbor/version.hpp>
 
@@ -39,5 +40,93 @@ void us_per_task(benchmark::internal::Benchmark *b) {
     }
 }
 
+// Compare the per-index cost of parallel_for with one task per index
+// (grain size 1) against the automatically chunked version, for a loop
+// body that does very little work, as in simulation_state::setup_events
+// with many cells and few events.
+
+void parallel_for_grain(benchmark::State& state) {
+    const int n = state.range(0);
+    const int grain = state.range(1);
+    const unsigned nthreads = state.range(2);
+
+    arb::threading::task_system ts(nthreads);
+    std::vector<double> v(n, 1.);
+
+    while (state.KeepRunning()) {
+        auto body = [&](int i) { v[i] = 0.5*v[i]+1.; };
+        if (grain>0) {
+            arb::threading::parallel_for::apply(0, n, grain, &ts, body);
+        }
+        else {
+            arb::threading::parallel_for::apply(0, n, &ts, body);
+        }
+        benchmark::DoNotOptimize(v.data());
+    }
+    state.SetItemsProcessed(state.iterations()*n);
+}
+
+void grain_args(benchmark::internal::Benchmark *b) {
+    for (unsigned nthreads: {2u, 4u, 8u}) {
+        for (int n: {1000, 100000}) {
+            // grain 0 selects the automatic grain size.
+            for (int grain: {1, 16, 256, 0}) {
+                b->Args({n, grain, int(nthreads)});
+            }
+        }
+    }
+}
+
+// Compare the shared_queue and work_stealing schedulers on a workload that
+// resembles an epoch of simulation_state::run: one long task (the spike
+// exchange) runs alongside a parallel_for over cell groups of uneven cost,
+// each of which runs a short nested parallel_for.
+
+void spin(unsigned n) {
+    volatile unsigned x = 0;
+    for (unsigned i = 0; i<n; ++i) x += i;
+}
+
+void scheduler_uneven(benchmark::State& state) {
+    const unsigned nthreads = state.range(0);
+    const auto scheduler = state.range(1)?
+        arb::task_scheduler::work_stealing:
+        arb::task_scheduler::shared_queue;
+    const int ngroups = state.range(2);
+
+    arb::threading::task_system ts(nthreads, scheduler);
+
+    // Group costs follow a heavy-tailed distribution: every 16th group
+    // is 20 times more expensive than the others.
+    std::vector<unsigned> cost(ngroups);
+    for (int i = 0; i<ngroups; ++i) cost[i] = i%16? 1000: 20000;
+
+    while (state.KeepRunning()) {
+        arb::threading::task_group g(&ts);
+        g.run([&] { spin(20000); });
+        g.run([&] {
+            arb::threading::parallel_for::apply(0, ngroups, 1, &ts,
+                [&](int i) {
+                    arb::threading::parallel_for::apply(0, 4, 1, &ts,
+                        [&](int) { spin(cost[i]/4); });
+                });
+        });
+        g.wait();
+    }
+    state.SetItemsProcessed(state.iterations()*ngroups);
+}
+
+void scheduler_args(benchmark::internal::Benchmark *b) {
+    for (int nthreads: {1, 2, 4, 8}) {
+        for (int ngroups: {64, 4096}) {
+            for (int ws: {0, 1}) {
+                b->Args({nthreads, ws, ngroups});
+            }
+        }
+    }
+}
+
 BENCHMARK(task_test)->Apply(us_per_task);
+BENCHMARK(parallel_for_grain)->Apply(grain_args)->UseRealTime();
+BENCHMARK(scheduler_uneven)->Apply(scheduler_args)->UseRealTime();
 BENCHMARK_MAIN();
@@ -1,7 +1,9 @@
 #include "../gtest.h"
 #include "test.hpp"
 
+#include <algorithm>
 #include <stdexcept>
+#include <tuple>
 #include <vector>
 
 #include <arbor/domain_decomposition.hpp>
@@ -10,6 +12,7 @@
 #include <threading/threading.hpp>
 
 #include "communication/communicator.hpp"
+#include "communication/spike_encoding.hpp"
 #include "execution_context.hpp"
 #include "util/filter.hpp"
 #include "util/rangeutil.hpp"
@@ -340,7 +343,7 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
     }
 
     // generate the events
-    std::vector<arb::pse_vector> queues(C.num_local_cells());
+    cell_event_buffer queues;
     C.make_event_queues(global_spikes, queues);
 
     // Assert that all the correct events were generated.
@@ -353,7 +356,7 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
         if (f(src)) {
             auto expected = expected_event_ring(gid, D.num_global_cells);
             auto grp = group_map[gid];
-            auto& q = queues[grp];
+            auto q = queues.cell(grp);
             if (std::find(q.begin(), q.end(), expected)==q.end()) {
                 return ::testing::AssertionFailure()
                     << "expected event " << expected << " was not found";
@@ -365,8 +368,7 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
     // Assert that only the expected events were produced. The preceding test
     // showed that all expected events were generated, so this only requires
     // that the number of generated events is as expected.
-    int num_events = std::accumulate(queues.begin(), queues.end(), 0,
-            [](int l, decltype(queues.front())& r){return l + r.size();});
+    int num_events = queues.events.size();
 
     if (expected_count!=num_events) {
         return ::testing::AssertionFailure() <<
@@ -431,9 +433,9 @@ test_all2all(const domain_decomposition& D, communicator& C, F&& f) {
     }
 
     // generate the events
-    std::vector<arb::pse_vector> queues(C.num_local_cells());
+    cell_event_buffer queues;
     C.make_event_queues(global_spikes, queues);
-    if (queues.size() != D.groups.size()) { // one queue for each cell group
+    if (queues.num_cells() != D.groups.size()) { // one queue for each cell group
         return ::testing::AssertionFailure()
             << "expect one event queue for each cell group";
     }
@@ -445,7 +447,7 @@ test_all2all(const domain_decomposition& D, communicator& C, F&& f) {
     int expected_count = 0;
     for (auto gid: gids) {
         // get the event queue that this gid belongs to
-        auto& q = queues[group_map[gid]];
+        auto q = queues.cell(group_map[gid]);
         for (auto src: spike_gids) {
             auto expected = expected_event_all2all(gid, src);
             if (std::find(q.begin(), q.end(), expected)==q.end()) {
@@ -460,8 +462,7 @@ test_all2all(const domain_decomposition& D, communicator& C, F&& f) {
     // Assert that only the expected events were produced. The preceding test
     // showed that all expected events were generated, so this only requires
     // that the number of generated events is as expected.
-    int num_events = std::accumulate(queues.begin(), queues.end(), 0,
-            [](int l, decltype(queues.front())& r){return l + r.size();});
+    int num_events = queues.events.size();
 
     if (expected_count!=num_events) {
         return ::testing::AssertionFailure() <<
@@ -497,3 +498,128 @@ TEST(communicator, all2all)
     // odd-numbered cells fire
     EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return g%2==1;}));
 }
+
+TEST(communicator, all2all_threads)
+{
+    // The events are generated by one task per thread, for disjoint blocks
+    // of local cells; there are more threads than cell groups on a domain.
+    auto ctx = *g_context;
+    ctx.thread_pool = std::make_shared<threading::task_system>(4);
+
+    unsigned N = ctx.distributed->size();
+    auto R = all2all_recipe(3*N);
+    const auto D = partition_load_balance(R, g_context);
+    auto C = communicator(R, D, ctx);
+
+    EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return true;}));
+    EXPECT_TRUE(test_all2all(D, C, [](cell_gid_type g){return g%3==1;}));
+}
+
+// With sparse spike exchange, each domain receives only the spikes from the
+// sources of its connections, which must generate the same events as the
+// spikes of an allgather exchange.
+template <typename F>
+::testing::AssertionResult
+test_sparse(const domain_decomposition& D, communicator& A, communicator& S, F&& f) {
+    using util::transform_view;
+    using util::assign_from;
+    using util::filter;
+
+    auto gids = get_gids(D);
+    std::vector<spike> local_spikes = assign_from(transform_view(filter(gids, f), make_spike));
+    std::reverse(local_spikes.begin(), local_spikes.end());
+
+    auto all_spikes = A.exchange(local_spikes);
+    auto sparse_spikes = S.exchange(local_spikes);
+    if (sparse_spikes.size()>all_spikes.size()) {
+        return ::testing::AssertionFailure() << "sparse exchange received "
+            << sparse_spikes.size() << " spikes, more than the "
+            << all_spikes.size() << " spikes in total";
+    }
+
+    cell_event_buffer expected, queues;
+    A.make_event_queues(all_spikes, expected);
+    S.make_event_queues(sparse_spikes, queues);
+
+    auto event_less = [](const spike_event& a, const spike_event& b) {
+        return std::tie(a.target, a.time, a.weight)<std::tie(b.target, b.time, b.weight);
+    };
+    for (auto i: util::make_span(0, D.num_local_cells)) {
+        std::vector<spike_event> e = assign_from(expected.cell(i));
+        std::vector<spike_event> q = assign_from(queues.cell(i));
+        util::sort(e, event_less);
+        util::sort(q, event_less);
+        if (e!=q) {
+            return ::testing::AssertionFailure() << "events for local cell " << i
+                << " differ: " << q.size() << " events, expected " << e.size();
+        }
+    }
+
+    return ::testing::AssertionSuccess();
+}
+
+TEST(communicator, sparse_ring)
+{
+    unsigned N = g_context->distributed->size();
+    auto R = ring_recipe(10*N);
+    const auto D = partition_load_balance(R, g_context);
+
+    auto ctx = *g_context;
+    ctx.exchange = spike_exchange::sparse;
+    auto A = communicator(R, D, *g_context);
+    auto S = communicator(R, D, ctx);
+
+    EXPECT_TRUE(test_sparse(D, A, S, [](cell_gid_type g){return true;}));
+    EXPECT_TRUE(test_sparse(D, A, S, [](cell_gid_type g){return (g+1)%10 == 0u;}));
+    EXPECT_TRUE(test_sparse(D, A, S, [](cell_gid_type g){return g%2==1;}));
+    EXPECT_TRUE(test_sparse(D, A, S, [](cell_gid_type g){return false;}));
+
+    // The spikes of all domains are counted once summed.
+    auto num_cells = 10*N;
+    S.sum_spikes();
+    EXPECT_EQ(num_cells+num_cells/10+num_cells/2, S.num_spikes());
+    EXPECT_EQ(A.num_spikes(), S.num_spikes());
+}
+
+TEST(communicator, sparse_all2all)
+{
+    unsigned N = g_context->distributed->size();
+    auto R = all2all_recipe(3*N);
+    const auto D = partition_load_balance(R, g_context);
+
+    auto ctx = *g_context;
+    ctx.exchange = spike_exchange::sparse;
+    ctx.thread_pool = std::make_shared<threading::task_system>(4);
+    auto A = communicator(R, D, *g_context);
+    auto S = communicator(R, D, ctx);
+
+    EXPECT_TRUE(test_sparse(D, A, S, [](cell_gid_type g){return true;}));
+    EXPECT_TRUE(test_sparse(D, A, S, [](cell_gid_type g){return g==0u;}));
+    EXPECT_TRUE(test_sparse(D, A, S, [](cell_gid_type g){return g%3==1;}));
+}
+
+TEST(communicator, compact_encoding)
+{
+    unsigned N = g_context->distributed->size();
+    auto R = all2all_recipe(3*N);
+    const auto D = partition_load_balance(R, g_context);
+
+    auto ctx = *g_context;
+    ctx.encoding = spike_encoding::compact;
+    auto A = communicator(R, D, *g_context);
+    auto C = communicator(R, D, ctx);
+
+    for (auto f: {+[](cell_gid_type g){return true;}, +[](cell_gid_type g){return g%3==1;}}) {
+        std::vector<spike> local_spikes = util::assign_from(util::transform_view(util::filter(get_gids(D), f), make_spike));
+
+        auto all_spikes = A.exchange(local_spikes);
+        auto encoded = C.exchange_encoded(local_spikes);
+        EXPECT_EQ(all_spikes.values(), decode_spikes(encoded).values());
+
+        cell_event_buffer expected, queues;
+        A.make_event_queues(all_spikes, expected);
+        C.make_event_queues(encoded, queues);
+        EXPECT_EQ(expected.events, queues.events);
+    }
+    EXPECT_EQ(A.num_spikes(), C.num_spikes());
+}
@@ -3,11 +3,14 @@
 #include "../gtest.h"
 #include "test.hpp"
 
+#include <cstdint>
 #include <cstring>
 #include <vector>
 
 #include <communication/mpi.hpp>
+#include <distributed_context.hpp>
 #include <util/rangeutil.hpp>
+#include <util/span.hpp>
 
 using namespace arb;
 
@@ -94,6 +97,56 @@ TEST(mpi, gather_all_with_partition) {
     EXPECT_EQ(expected_divisions, gathered.partition());
 }
 
+TEST(mpi, gather_all_request) {
+    int id = mpi::rank(MPI_COMM_WORLD);
+    int size = mpi::size(MPI_COMM_WORLD);
+
+    // rank i contributes i+1 items.
+    std::vector<big_thing> data;
+    for (int j = 0; j<=id; ++j) {
+        data.push_back(id*10+j);
+    }
+
+    std::vector<big_thing> expected_values;
+    std::vector<unsigned> expected_divisions = {0};
+    for (int i = 0; i<size; ++i) {
+        for (int j = 0; j<=i; ++j) {
+            expected_values.push_back(i*10+j);
+        }
+        expected_divisions.push_back(expected_values.size());
+    }
+
+    // Complete with wait() alone.
+    {
+        mpi::gather_all_request<big_thing> request(data, MPI_COMM_WORLD);
+        auto gathered = request.wait();
+
+        EXPECT_EQ(expected_values, gathered.values());
+        EXPECT_EQ(expected_divisions, gathered.partition());
+    }
+
+    // Make progress with test() until complete, then wait().
+    {
+        mpi::gather_all_request<big_thing> request(data, MPI_COMM_WORLD);
+        while (!request.test()) {}
+        EXPECT_TRUE(request.test());
+        auto gathered = request.wait();
+
+        EXPECT_EQ(expected_values, gathered.values());
+        EXPECT_EQ(expected_divisions, gathered.partition());
+    }
+
+    // Through the type-erased gather_request.
+    {
+        gather_request<big_thing> request = mpi::gather_all_request<big_thing>(data, MPI_COMM_WORLD);
+        request.test();
+        auto gathered = request.wait();
+
+        EXPECT_EQ(expected_values, gathered.values());
+        EXPECT_EQ(expected_divisions, gathered.partition());
+    }
+}
+
 TEST(mpi, gather_string) {
     int id = mpi::rank(MPI_COMM_WORLD);
     int size = mpi::size(MPI_COMM_WORLD);
@@ -140,4 +193,49 @@ TEST(mpi, gather) {
     }
 }
 
+TEST(mpi, node_context) {
+    int size = mpi::size(MPI_COMM_WORLD);
+
+    // All ranks that share memory, one rank per node, and two ranks per node.
+    for (unsigned ranks_per_node: {0u, 1u, 2u}) {
+        auto ctx = make_mpi_node_context(MPI_COMM_WORLD, ranks_per_node);
+        int id = ctx->id();
+        EXPECT_EQ(size, ctx->size());
+        EXPECT_EQ(0, ctx->min(id));
+        EXPECT_EQ(size-1, ctx->max(id));
+
+        // Repeat with increasing numbers of spikes, so that the shared
+        // buffers are reallocated.
+        for (int n: {1, 3, 100}) {
+            // Domain i contributes (i%3)*n spikes.
+            std::vector<spike> local;
+            for (int j = 0; j<(id%3)*n; ++j) {
+                local.push_back(spike({cell_gid_type(id), cell_lid_type(j)}, float(j)));
+            }
+
+            std::vector<spike> expected_values;
+            std::vector<unsigned> expected_divisions = {0};
+            for (int i = 0; i<size; ++i) {
+                for (int j = 0; j<(i%3)*n; ++j) {
+                    expected_values.push_back(spike({cell_gid_type(i), cell_lid_type(j)}, float(j)));
+                }
+                expected_divisions.push_back(expected_values.size());
+            }
+
+            auto gathered = ctx->gather_spikes(local);
+            EXPECT_EQ(expected_values, gathered.values());
+            EXPECT_EQ(expected_divisions, gathered.partition());
+
+            std::vector<std::uint8_t> bytes(id%3*n, std::uint8_t(id));
+            auto gathered_bytes = ctx->start_gather_bytes(bytes).wait();
+            EXPECT_EQ(expected_divisions, gathered_bytes.partition());
+            for (int i = 0; i<size; ++i) {
+                for (auto j: util::make_span(gathered_bytes.partition()[i], gathered_bytes.partition()[i+1])) {
+                    EXPECT_EQ(std::uint8_t(i), gathered_bytes.values()[j]);
+                }
+            }
+        }
+    }
+}
+
 #endif // TEST_MPI
@@ -0,0 +1,95 @@
+#include "../gtest.h"
+
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+
+#include "hardware/affinity.hpp"
+#include "threading/threading.hpp"
+
+using namespace arb;
+using hw::cpu_info;
+
+namespace {
+// Two sockets of two cores with two hardware threads each, numbered in the
+// usual Linux fashion: the second hardware thread of every core comes after
+// the first hardware thread of all cores.
+std::vector<cpu_info> two_socket_topology() {
+    return {
+        {0, 0, 0}, {1, 0, 1}, {2, 1, 0}, {3, 1, 1},
+        {4, 0, 0}, {5, 0, 1}, {6, 1, 0}, {7, 1, 1}
+    };
+}
+}
+
+TEST(affinity, place_none) {
+    auto p = hw::place_threads(3, thread_affinity::none, two_socket_topology());
+    EXPECT_EQ((std::vector<int>{-1, -1, -1}), p);
+}
+
+TEST(affinity, place_compact) {
+    auto p = hw::place_threads(10, thread_affinity::compact, two_socket_topology());
+    EXPECT_EQ((std::vector<int>{0, 4, 1, 5, 2, 6, 3, 7, 0, 4}), p);
+}
+
+TEST(affinity, place_scatter) {
+    auto p = hw::place_threads(10, thread_affinity::scatter, two_socket_topology());
+    EXPECT_EQ((std::vector<int>{0, 2, 1, 3, 4, 6, 5, 7, 0, 2}), p);
+}
+
+TEST(affinity, place_list) {
+    auto p = hw::place_threads(5, thread_affinity::list, two_socket_topology(), {7, 3});
+    EXPECT_EQ((std::vector<int>{7, 3, 7, 3, 7}), p);
+
+    EXPECT_THROW(hw::place_threads(2, thread_affinity::list, two_socket_topology(), {}), arbor_exception);
+    EXPECT_THROW(hw::place_threads(2, thread_affinity::list, two_socket_topology(), {1, 8}), arbor_exception);
+
+    // Without affinity information, the list is taken as is.
+    EXPECT_EQ((std::vector<int>{8, 8}), hw::place_threads(2, thread_affinity::list, {}, {8}));
+}
+
+TEST(affinity, pinned_task_system) {
+    auto cpus = hw::get_affinity();
+    if (cpus.empty()) return; // affinity not supported on this platform
+
+    const int nthreads = 4;
+    std::vector<int> placement;
+    for (int i = 0; i<nthreads; ++i) {
+        placement.push_back(cpus[i%cpus.size()]);
+    }
+
+    // Only the worker threads are pinned: the calling thread keeps its affinity.
+    auto expected = placement;
+    expected[0] = -1;
+    {
+        threading::task_system ts(nthreads, task_scheduler::shared_queue, placement);
+        EXPECT_EQ(expected, ts.placement());
+        EXPECT_EQ(cpus, hw::get_affinity());
+    }
+
+    placement[1] = -1;
+    expected[1] = -1;
+    threading::task_system ts(nthreads, task_scheduler::work_stealing, placement);
+    EXPECT_EQ(expected, ts.placement());
+    EXPECT_EQ(cpus, hw::get_affinity());
+}
+
+TEST(affinity, context) {
+    proc_allocation resources(3, -1);
+    EXPECT_EQ((std::vector<int>{-1, -1, -1}), thread_placement(make_context(resources)));
+
+    auto cpus = hw::get_affinity();
+    if (cpus.empty()) return;
+
+    resources.affinity = thread_affinity::list;
+    resources.cores = {cpus.back()};
+    EXPECT_EQ((std::vector<int>{-1, cpus.back(), cpus.back()}), thread_placement(make_context(resources)));
+
+    resources.affinity = thread_affinity::compact;
+    auto placement = thread_placement(make_context(resources));
+    EXPECT_EQ(-1, placement[0]);
+    for (unsigned i = 1; i<placement.size(); ++i) {
+        EXPECT_NE(-1, placement[i]);
+    }
+}
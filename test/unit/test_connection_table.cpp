@@ -0,0 +1,84 @@
+#include "../gtest.h"
+
+#include <vector>
+
+#include "communication/connection_table.hpp"
+#include "connection.hpp"
+
+using namespace arb;
+
+namespace {
+std::vector<local_connection> as_vector(connection_table::range r) {
+    return std::vector<local_connection>(r.first, r.second);
+}
+}
+
+TEST(connection_table, empty) {
+    connection_table t;
+    EXPECT_EQ(0u, t.size());
+    EXPECT_TRUE(as_vector(t.connections_from({0, 0})).empty());
+
+    connection_table u(std::vector<connection>{});
+    EXPECT_EQ(0u, u.num_sources());
+    EXPECT_TRUE(as_vector(u.connections_from({0, 0})).empty());
+}
+
+TEST(connection_table, fan_out) {
+    // Sources with sparse gids, and several connections from some sources.
+    std::vector<connection> cons = {
+        {{1000000, 0}, {5, 1}, 0.5f, 2.f, 3},
+        {{7, 2},       {6, 0}, 1.0f, 1.f, 4},
+        {{1000000, 0}, {8, 2}, 1.5f, 4.f, 0},
+        {{7, 1},       {6, 3}, 2.0f, 4.f, 4},
+        {{1000000, 0}, {5, 0}, 2.5f, 6.f, 3},
+    };
+    connection_table t(cons);
+
+    EXPECT_EQ(5u, t.size());
+    EXPECT_EQ(3u, t.num_sources());
+
+    auto fan = as_vector(t.connections_from({1000000, 0}));
+    ASSERT_EQ(3u, fan.size());
+    float total_weight = 0;
+    for (auto& c: fan) {
+        total_weight += c.weight;
+        EXPECT_EQ(c.delay, 2*c.weight+1);
+        EXPECT_EQ(c.index_on_domain==0, c.target==2u);
+    }
+    EXPECT_EQ(4.5f, total_weight);
+
+    fan = as_vector(t.connections_from({7, 1}));
+    ASSERT_EQ(1u, fan.size());
+    EXPECT_EQ(3u, fan[0].target);
+    EXPECT_EQ(4u, fan[0].index_on_domain);
+    EXPECT_EQ(2.0f, fan[0].weight);
+    EXPECT_EQ(4.f, fan[0].delay);
+
+    EXPECT_TRUE(as_vector(t.connections_from({7, 0})).empty());
+    EXPECT_TRUE(as_vector(t.connections_from({1000000, 1})).empty());
+    EXPECT_TRUE(as_vector(t.connections_from({0, 0})).empty());
+
+    // The reserved source has no connections.
+    EXPECT_TRUE(as_vector(t.connections_from({cell_gid_type(-1), cell_lid_type(-1)})).empty());
+}
+
+TEST(connection_table, many_sources) {
+    std::vector<connection> cons;
+    for (cell_gid_type gid = 0; gid<1000; ++gid) {
+        for (unsigned i = 0; i<gid%3; ++i) {
+            cons.push_back({{3*gid, 0}, {gid, i}, float(gid), 1.f, gid});
+        }
+    }
+    connection_table t(cons);
+    EXPECT_EQ(cons.size(), t.size());
+
+    for (cell_gid_type gid = 0; gid<1000; ++gid) {
+        auto fan = as_vector(t.connections_from({3*gid, 0}));
+        ASSERT_EQ(gid%3, fan.size());
+        for (auto& c: fan) {
+            EXPECT_EQ(gid, c.index_on_domain);
+            EXPECT_EQ(float(gid), c.weight);
+        }
+        EXPECT_TRUE(as_vector(t.connections_from({3*gid+1, 0})).empty());
+    }
+}
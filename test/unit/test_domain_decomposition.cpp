@@ -1,7 +1,9 @@
 #include "../gtest.h"
 
+#include <algorithm>
 #include <stdexcept>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/load_balance.hpp>
@@ -110,6 +112,91 @@ namespace {
     private:
         cell_size_type size_ = 15;
     };
+
+    // Cable cells with a soma and a dendrite of ncv compartments with
+    // passive membrane.
+    class dendrite_recipe: public recipe {
+    public:
+        dendrite_recipe(cell_size_type n, unsigned ncv): size_(n), ncv_(ncv) {}
+
+        cell_size_type num_cells() const override {
+            return size_;
+        }
+
+        arb::util::unique_any get_cell_description(cell_gid_type) const override {
+            cable_cell c;
+            c.add_soma(6);
+            if (ncv_) {
+                auto dend = c.add_cable(0, section_kind::dendrite, 0.5, 0.5, 200);
+                dend->set_compartments(ncv_);
+                dend->add_mechanism("pas");
+            }
+            return {std::move(c)};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::cable;
+        }
+
+    private:
+        cell_size_type size_;
+        unsigned ncv_;
+    };
+
+    // Spike source cells with a cost given per gid.
+    class weighted_recipe: public recipe {
+    public:
+        weighted_recipe(std::vector<double> costs): costs_(std::move(costs)) {}
+
+        cell_size_type num_cells() const override {
+            return costs_.size();
+        }
+
+        arb::util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::spike_source;
+        }
+
+        double get_cell_cost(cell_gid_type gid) const override {
+            return costs_[gid];
+        }
+
+    private:
+        std::vector<double> costs_;
+    };
+
+    // Spike source cells in two populations, of the cells with even and odd
+    // gid, with all-to-all connections within each population.
+    class parity_recipe: public recipe {
+    public:
+        parity_recipe(cell_size_type n): size_(n) {}
+
+        cell_size_type num_cells() const override {
+            return size_;
+        }
+
+        arb::util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::spike_source;
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            std::vector<cell_connection> conns;
+            for (cell_gid_type src = gid%2; src<size_; src += 2) {
+                if (src!=gid) conns.push_back({{src, 0}, {gid, 0}, 1.f, 1.f});
+            }
+            return conns;
+        }
+
+    private:
+        cell_size_type size_;
+    };
 }
 
 // test assumes one domain
@@ -353,3 +440,130 @@ TEST(domain_decomposition, compulsory_groups)
     EXPECT_EQ(expected_groups2, D2.groups[0].gids);
 
 }
+
+TEST(domain_decomposition, auto_group_size)
+{
+    partition_hint_map hints;
+    hints[cell_kind::cable].cpu_group_size = partition_hint::auto_size;
+    hints[cell_kind::cable].prefer_gpu = false;
+
+    auto group_sizes = [&](const recipe& rec, unsigned nthreads) {
+        proc_allocation resources(nthreads, -1);
+        auto D = partition_load_balance(rec, make_context(resources), hints);
+        std::vector<std::size_t> sizes;
+        for (auto& g: D.groups) sizes.push_back(g.gids.size());
+        return sizes;
+    };
+
+    // Single compartment cells: the number of groups is limited by the number
+    // of threads (four groups per thread).
+    EXPECT_EQ(std::vector<std::size_t>(4, 250), group_sizes(dendrite_recipe(1000, 0), 1));
+    EXPECT_EQ(std::vector<std::size_t>(8, 125), group_sizes(dendrite_recipe(1000, 0), 2));
+
+    // ... but groups are not made smaller than is required to fill SIMD
+    // vectors.
+    EXPECT_EQ(std::vector<std::size_t>(2, 32), group_sizes(dendrite_recipe(64, 0), 4));
+
+    // Large cells: the group size is limited by the cache footprint.
+    auto sizes = group_sizes(dendrite_recipe(1000, 200), 1);
+    EXPECT_LT(4u, sizes.size());
+    EXPECT_LT(1u, sizes.front());
+
+    // Very large cells go in a group of their own.
+    EXPECT_EQ(std::vector<std::size_t>(10, 1), group_sizes(dendrite_recipe(10, 10000), 1));
+}
+
+TEST(domain_decomposition, cell_cost)
+{
+    // The default cost of a cable cell grows with the number of compartments.
+    dendrite_recipe small(1, 10), large(1, 100);
+    EXPECT_LT(0., small.get_cell_cost(0));
+    EXPECT_LT(small.get_cell_cost(0), large.get_cell_cost(0));
+}
+
+TEST(domain_decomposition, cost_balance)
+{
+    // The dry run context places the local domain first of num_domains, so
+    // the number of local cells gives the end of its range of gids.
+    auto num_local_cells = [](const recipe& rec, unsigned num_domains, bool by_cost) {
+        auto ctx = make_context(proc_allocation(1, -1), dry_run_info(num_domains, rec.num_cells()));
+        auto D = by_cost? partition_cost_balance(rec, ctx): partition_load_balance(rec, ctx);
+        return D.num_local_cells;
+    };
+
+    // Cells of equal cost: the same partition as partition_load_balance.
+    weighted_recipe uniform(std::vector<double>(10, 1.));
+    EXPECT_EQ(5u, num_local_cells(uniform, 2, false));
+    EXPECT_EQ(5u, num_local_cells(uniform, 2, true));
+    EXPECT_EQ(3u, num_local_cells(uniform, 3, true));
+
+    // Expensive cells first: fewer cells in the first domain.
+    weighted_recipe skewed({4, 4, 1, 1, 1, 1, 1, 1, 1, 1});
+    EXPECT_EQ(5u, num_local_cells(skewed, 2, false));
+    EXPECT_EQ(2u, num_local_cells(skewed, 2, true));
+    EXPECT_EQ(1u, num_local_cells(skewed, 4, true));
+
+    // Without cost information, fall back to equal numbers of cells.
+    weighted_recipe free(std::vector<double>(10, 0.));
+    EXPECT_EQ(5u, num_local_cells(free, 2, true));
+
+    weighted_recipe invalid({1, -1});
+    EXPECT_THROW(num_local_cells(invalid, 2, true), arbor_exception);
+
+    // On a single domain all cells are local, and the cell groups are the
+    // same as those of partition_load_balance.
+    auto ctx = make_context();
+    auto D1 = partition_load_balance(skewed, ctx);
+    auto D2 = partition_cost_balance(skewed, ctx);
+    ASSERT_EQ(D1.groups.size(), D2.groups.size());
+    for (auto i: make_span(D1.groups.size())) {
+        EXPECT_EQ(D1.groups[i].gids, D2.groups[i].gids);
+    }
+}
+
+TEST(domain_decomposition, graph_balance)
+{
+    // Populations that are not contiguous in gid are kept on one domain.
+    parity_recipe rec(20);
+    auto D = partition_graph_balance(rec, make_context(proc_allocation(1, -1), dry_run_info(2, 20)));
+
+    EXPECT_EQ(2, D.num_domains);
+    EXPECT_EQ(10u, D.num_local_cells);
+    EXPECT_EQ(20u, D.num_global_cells);
+    for (auto gid: make_span(2, 20)) {
+        EXPECT_EQ(D.gid_domain(gid-2), D.gid_domain(gid));
+    }
+    EXPECT_NE(D.gid_domain(0), D.gid_domain(1));
+    EXPECT_EQ(-1, D.gid_domain(20));
+
+    for (auto& g: D.groups) {
+        for (auto gid: g.gids) {
+            EXPECT_EQ(D.domain_id, D.gid_domain(gid));
+        }
+    }
+
+    // Cells connected by gap junctions are on the same domain, and in the
+    // same cell group.
+    gap_recipe grec;
+    partition_hint_map hints;
+    hints[cell_kind::cable].cpu_group_size = 1;
+    hints[cell_kind::cable].prefer_gpu = false;
+    auto G = partition_graph_balance(grec, make_context(proc_allocation(1, -1), dry_run_info(3, 15)), hints);
+    for (auto gid: make_span(15)) {
+        for (auto c: grec.gap_junctions_on(gid)) {
+            EXPECT_EQ(G.gid_domain(c.local.gid), G.gid_domain(c.peer.gid));
+        }
+    }
+    for (auto& g: G.groups) {
+        for (auto gid: g.gids) {
+            for (auto c: grec.gap_junctions_on(gid)) {
+                auto other = c.local.gid==gid? c.peer.gid: c.local.gid;
+                EXPECT_NE(g.gids.end(), std::find(g.gids.begin(), g.gids.end(), other));
+            }
+        }
+    }
+
+    // On a single domain, all cells are local.
+    auto S = partition_graph_balance(grec, make_context());
+    EXPECT_EQ(15u, S.num_local_cells);
+}
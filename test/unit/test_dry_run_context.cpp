@@ -4,6 +4,7 @@
 #include "../gtest.h"
 
 #include <distributed_context.hpp>
+#include <arbor/arbexcept.hpp>
 #include <arbor/spike.hpp>
 
 // Test that there are no errors constructing a distributed_context from a dry_run_context
@@ -98,6 +99,24 @@ TEST(dry_run_context, gather_spikes)
     EXPECT_EQ(part[4], spikes.size()*4);
 }
 
+TEST(dry_run_context, start_gather_spikes)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
+
+    std::vector<arb::spike> spikes = {
+        {{0u,3u}, 42.f},
+        {{2u,1u}, 42.f},
+    };
+
+    auto expected = ctx->gather_spikes(spikes);
+    auto request = ctx->start_gather_spikes(spikes);
+    EXPECT_TRUE(request.test());
+    auto s = request.wait();
+
+    EXPECT_EQ(expected.values(), s.values());
+    EXPECT_EQ(expected.partition(), s.partition());
+}
+
 TEST(dry_run_context, gather_gids)
 {
     distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
@@ -117,3 +136,11 @@ TEST(dry_run_context, gather_gids)
     EXPECT_EQ(part[3], gids.size()*3);
     EXPECT_EQ(part[4], gids.size()*4);
 }
+
+TEST(dry_run_context, exchange_spikes)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(num_ranks, num_cells_per_rank);
+
+    std::vector<arb::spike> spikes = {{{0u, 0u}, 1.f}};
+    EXPECT_THROW(ctx->exchange_spikes(spikes, {0u, 1u}, {{1}, {1}}), arb::arbor_exception);
+}
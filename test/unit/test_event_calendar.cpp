@@ -0,0 +1,106 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <arbor/spike_event.hpp>
+
+#include "event_calendar.hpp"
+#include "util/rangeutil.hpp"
+
+using namespace arb;
+
+namespace {
+pse_vector sorted(pse_vector v) {
+    util::sort(v);
+    return v;
+}
+}
+
+TEST(event_calendar, empty) {
+    event_calendar c(0.5, 4);
+    EXPECT_TRUE(c.empty());
+
+    pse_vector out;
+    c.pop_before(0, 10, out);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(event_calendar, pop) {
+    // Bins of width 0.5 spanning 2 ms.
+    event_calendar c(0.5, 4);
+
+    pse_vector events = {
+        {{0, 0}, 0.2, 1},
+        {{0, 1}, 0.7, 1},
+        {{0, 2}, 0.6, 1},
+        {{0, 3}, 1.9, 1},
+        {{0, 4}, 2.1, 1}, // shares a bin with the event at 0.2
+        {{0, 5}, 9.6, 1}, // shares a bin with the event at 1.6
+        {{0, 6}, 0.5, 1},
+    };
+    c.push(events);
+    EXPECT_EQ(events.size(), c.size());
+
+    pse_vector out;
+    c.pop_before(0, 0.5, out);
+    EXPECT_EQ((pse_vector{events[0]}), out);
+
+    // Windows need not be aligned with the bins.
+    out.clear();
+    c.pop_before(0.5, 0.65, out);
+    EXPECT_EQ((pse_vector{events[6], events[2]}), sorted(out));
+
+    out.clear();
+    c.pop_before(0.65, 2.5, out);
+    EXPECT_EQ((pse_vector{events[1], events[3], events[4]}), sorted(out));
+    EXPECT_EQ(1u, c.size());
+
+    // A window longer than the span of the calendar visits every bin once.
+    out.clear();
+    c.pop_before(2.5, 20, out);
+    EXPECT_EQ((pse_vector{events[5]}), out);
+    EXPECT_TRUE(c.empty());
+}
+
+TEST(event_calendar, epochs) {
+    // Events pushed with a delay of between 1 and 3 ms, taken an epoch
+    // of 0.5 ms at a time, come out in the same epochs as with a sorted list.
+    std::mt19937 G;
+    std::uniform_real_distribution<time_type> delay(1, 3);
+
+    const time_type width = 0.5;
+    event_calendar c(width, 8);
+    pse_vector all;
+    for (unsigned epoch=0; epoch<40; ++epoch) {
+        const time_type t_from = epoch*width;
+        const time_type t_to = t_from+width;
+
+        pse_vector out;
+        c.pop_before(t_from, t_to, out);
+
+        pse_vector expected;
+        std::copy_if(all.begin(), all.end(), std::back_inserter(expected),
+            [=](const spike_event& e) { return e.time>=t_from && e.time<t_to; });
+        EXPECT_EQ(sorted(expected), sorted(out));
+
+        for (unsigned i=0; i<20; ++i) {
+            spike_event e{{epoch, i}, t_to+delay(G), 1};
+            all.push_back(e);
+            c.push(e);
+        }
+    }
+}
+
+TEST(event_calendar, clear) {
+    event_calendar c(1, 2);
+    c.push(spike_event{{0, 0}, 1, 1});
+    c.push(spike_event{{0, 0}, 10, 1});
+    c.clear();
+    EXPECT_TRUE(c.empty());
+
+    pse_vector out;
+    c.pop_before(0, 20, out);
+    EXPECT_TRUE(out.empty());
+}
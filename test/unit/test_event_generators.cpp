@@ -1,5 +1,10 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
 #include <arbor/event_generator.hpp>
 #include <arbor/spike_event.hpp>
 
@@ -124,3 +129,59 @@ TEST(event_generators, poisson) {
     EXPECT_EQ(int1, int2);
 }
 
+
+TEST(event_generators, poisson_population) {
+    std::vector<poisson_population_generator::input> inputs;
+    for (unsigned i=0; i<20; ++i) {
+        inputs.push_back({{7, i}, float(i), time_type(0.5+0.25*i)});
+    }
+    // An input that never fires.
+    inputs.push_back({{7, 20}, 1.f, 0});
+
+    const time_type tstart = 1, tstop = 90, tend = 100;
+    event_generator gen = poisson_population_generator(inputs, 42, tstart, tstop);
+
+    pse_vector all = as_vector(gen.events(0, tend));
+    EXPECT_TRUE(std::is_sorted(all.begin(), all.end()));
+    ASSERT_FALSE(all.empty());
+    EXPECT_LE(tstart, all.front().time);
+    EXPECT_GT(tstop, all.back().time);
+
+    // The number of events of each input is close to rate×duration.
+    std::vector<unsigned> count(inputs.size());
+    for (auto& e: all) {
+        ASSERT_EQ(7u, e.target.gid);
+        EXPECT_EQ(float(e.target.index), e.weight);
+        ++count[e.target.index];
+    }
+    for (unsigned i=0; i<inputs.size(); ++i) {
+        double expected = inputs[i].rate_kHz*(tstop-tstart);
+        EXPECT_NEAR(expected, count[i], 5*std::sqrt(expected)+1e-9);
+    }
+
+    // The same events are generated after reset, by a copy, and when the
+    // time is divided into different intervals.
+    gen.reset();
+    EXPECT_EQ(all, as_vector(gen.events(0, tend)));
+
+    gen.reset();
+    const event_generator& gen_ref = gen;
+    event_generator copy = gen_ref;
+    pse_vector split;
+    for (time_type t = 0; t<tend; t += 0.7) {
+        util::append(split, as_vector(copy.events(t, std::min(t+time_type(0.7), tend))));
+    }
+    EXPECT_EQ(all, split);
+
+    // Events before t0 are skipped.
+    gen.reset();
+    pse_vector late = as_vector(gen.events(50, tend));
+    pse_vector expected_late;
+    std::copy_if(all.begin(), all.end(), std::back_inserter(expected_late),
+        [](const spike_event& e) { return e.time>=50; });
+    EXPECT_EQ(expected_late, late);
+
+    // A different seed gives different events.
+    event_generator other = poisson_population_generator(inputs, 43, tstart, tstop);
+    EXPECT_NE(all, as_vector(other.events(0, tend)));
+}
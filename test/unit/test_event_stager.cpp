@@ -0,0 +1,95 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "backends/event.hpp"
+#include "event_stager.hpp"
+#include "util/rangeutil.hpp"
+
+using namespace arb;
+
+namespace {
+    // The lane of cell i has events for targets (i, j), and the staged
+    // event has the cell index as its mechanism id, and the intdom of the
+    // cell as its intdom index.
+    struct to_event {
+        const std::vector<fvm_index_type>& cell_to_intdom;
+
+        deliverable_event operator()(cell_size_type i, const spike_event& e) const {
+            return deliverable_event(e.time, target_handle(i, e.target.index, cell_to_intdom[i]), e.weight);
+        }
+    };
+
+    bool time_less(const deliverable_event& a, const deliverable_event& b) {
+        return a.time<b.time;
+    }
+}
+
+TEST(event_stager, no_lanes) {
+    std::vector<fvm_index_type> cell_to_intdom = {0, 1};
+    event_stager stager(cell_to_intdom);
+
+    std::vector<pse_vector> lanes;
+    auto& staged = stager.stage(util::subrange_view(lanes, 0, 0), 10, to_event{cell_to_intdom});
+    EXPECT_TRUE(staged.empty());
+}
+
+TEST(event_stager, order) {
+    // Integration domains shared by several cells, in no particular order,
+    // and a cell with no events.
+    std::vector<fvm_index_type> cell_to_intdom = {2, 0, 2, 1, 0, 2, 2, 3};
+    const unsigned n = cell_to_intdom.size();
+    const time_type tfinal = 5;
+
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<time_type> time_dist(0, 8);
+    std::vector<pse_vector> lanes(n);
+    for (unsigned i=0; i<n; ++i) {
+        if (i==4) continue;
+        for (unsigned j=0; j<20+3*i; ++j) {
+            lanes[i].push_back({{i, j}, time_dist(gen), float(j)});
+        }
+        util::sort(lanes[i]);
+    }
+    // Events at the same time on different cells of an integration domain.
+    lanes[2].push_back({{2, 100}, 4.f, 1.f});
+    lanes[5].push_back({{5, 100}, 4.f, 1.f});
+    util::sort(lanes[2]);
+    util::sort(lanes[5]);
+
+    event_stager stager(cell_to_intdom);
+    for (int rep=0; rep<2; ++rep) {
+        auto& staged = stager.stage(util::subrange_view(lanes, 0, n), tfinal, to_event{cell_to_intdom});
+
+        // All events before tfinal, ordered by intdom, then by time.
+        std::vector<deliverable_event> expected;
+        for (unsigned i=0; i<n; ++i) {
+            for (auto& e: lanes[i]) {
+                if (e.time<tfinal) expected.push_back(to_event{cell_to_intdom}(i, e));
+            }
+        }
+        std::stable_sort(expected.begin(), expected.end(),
+            [](const deliverable_event& a, const deliverable_event& b) {
+                return a.handle.intdom_index<b.handle.intdom_index ||
+                       (a.handle.intdom_index==b.handle.intdom_index && a.time<b.time);
+            });
+
+        ASSERT_EQ(expected.size(), staged.size());
+        for (unsigned k=0; k<staged.size(); ++k) {
+            EXPECT_EQ(expected[k].handle.intdom_index, staged[k].handle.intdom_index);
+            EXPECT_EQ(expected[k].time, staged[k].time);
+        }
+
+        // Each integration domain is sorted by time.
+        for (unsigned k=1; k<staged.size(); ++k) {
+            if (staged[k].handle.intdom_index==staged[k-1].handle.intdom_index) {
+                EXPECT_FALSE(time_less(staged[k], staged[k-1]));
+            }
+        }
+    }
+}
@@ -1,5 +1,12 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/lif_cell.hpp>
 #include <arbor/load_balance.hpp>
@@ -9,6 +16,7 @@
 #include <arbor/spike_source_cell.hpp>
 
 #include "lif_cell_group.hpp"
+#include "util/span.hpp"
 
 using namespace arb;
 // Simple ring network of LIF neurons.
@@ -225,3 +233,364 @@ TEST(lif_cell_group, ring)
     }
 }
 
+
+TEST(lif_cell_group, ring_thread_domains)
+{
+    // The ring of lif_cell_group.ring, distributed over the domains of
+    // a thread context.
+    cell_size_type num_lif_cells = 99;
+    time_type simulation_time = 100;
+    auto recipe = ring_recipe(num_lif_cells, 1000, 1);
+
+    std::vector<spike> spikes;
+    std::vector<std::uint64_t> num_spikes(3);
+    run_thread_domains(proc_allocation(2, -1), 3, [&](const context& ctx) {
+        auto decomp = partition_load_balance(recipe, ctx);
+        simulation sim(recipe, decomp, ctx);
+
+        if (rank(ctx)==0) {
+            sim.set_global_spike_callback(
+                [&spikes](const std::vector<spike>& s) {
+                    spikes.insert(spikes.end(), s.begin(), s.end());
+                }
+            );
+        }
+        sim.run(simulation_time, 0.01);
+        num_spikes[rank(ctx)] = sim.num_spikes();
+    });
+
+    EXPECT_EQ(num_lif_cells+1u, spikes.size());
+    for (auto n: num_spikes) {
+        EXPECT_EQ(spikes.size(), n);
+    }
+    for (auto& spike: spikes) {
+        EXPECT_EQ(spike.source.gid, spike.time);
+    }
+}
+
+
+TEST(lif_cell_group, ring_sticky_groups)
+{
+    // Spikes must not depend on how cell groups are assigned to threads.
+    auto run_ring = [](cell_group_scheduling scheduling) {
+        proc_allocation resources(4, -1);
+        resources.group_scheduling = scheduling;
+        auto context = make_context(resources);
+        auto recipe = ring_recipe(99, 1000, 1);
+        auto decomp = partition_load_balance(recipe, context);
+        simulation sim(recipe, decomp, context);
+
+        std::vector<spike> spikes;
+        sim.set_global_spike_callback(
+            [&spikes](const std::vector<spike>& s) {
+                spikes.insert(spikes.end(), s.begin(), s.end());
+            });
+        sim.run(100, 0.01);
+
+        std::sort(spikes.begin(), spikes.end(),
+            [](const spike& a, const spike& b) { return a.source<b.source || (a.source==b.source && a.time<b.time); });
+        return spikes;
+    };
+
+    auto expected = run_ring(cell_group_scheduling::dynamic);
+    auto spikes = run_ring(cell_group_scheduling::sticky);
+
+    EXPECT_EQ(100u, expected.size());
+    ASSERT_EQ(expected.size(), spikes.size());
+    for (std::size_t i = 0; i<spikes.size(); ++i) {
+        EXPECT_EQ(expected[i].source, spikes[i].source);
+        EXPECT_EQ(expected[i].time, spikes[i].time);
+    }
+}
+
+TEST(lif_cell_group, cell_group_costs)
+{
+    proc_allocation resources(2, -1);
+    auto context = make_context(resources);
+    auto recipe = ring_recipe(9, 1000, 1);
+    auto decomp = partition_load_balance(recipe, context);
+    simulation sim(recipe, decomp, context);
+
+    auto costs = sim.cell_group_costs();
+    ASSERT_EQ(decomp.groups.size(), costs.size());
+    for (auto c: costs) {
+        EXPECT_EQ(0., c);
+    }
+
+    sim.run(10, 0.01);
+    costs = sim.cell_group_costs();
+    ASSERT_EQ(decomp.groups.size(), costs.size());
+    for (auto c: costs) {
+        EXPECT_LE(0., c);
+    }
+}
+
+namespace {
+    double thread_cpu_time() {
+        timespec t;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+        return t.tv_sec+1e-9*t.tv_nsec;
+    }
+
+    // Busy wait for the given number of seconds of cpu time of the thread,
+    // so that the wall time taken grows in proportion with the load on
+    // the machine.
+    void spin(double seconds) {
+        auto t0 = thread_cpu_time();
+        while (thread_cpu_time()-t0<seconds) {}
+    }
+
+    // A schedule with no events, which takes cost seconds to evaluate, and
+    // records the gid of its cell each time it is evaluated.
+    struct cost_schedule {
+        cell_gid_type gid;
+        double cost;
+        std::vector<cell_gid_type>* log;
+
+        time_event_span events(time_type, time_type) {
+            spin(cost);
+            log->push_back(gid);
+            return {nullptr, nullptr};
+        }
+
+        void reset() {}
+    };
+
+    // Unconnected spike source cells, in which the schedule of cell gid
+    // takes 5(gid+1) ms to evaluate.
+    class cost_recipe: public arb::recipe {
+    public:
+        cost_recipe(cell_size_type n, std::vector<cell_gid_type>* log): n_(n), log_(log) {}
+
+        cell_size_type num_cells() const override { return n_; }
+        cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::spike_source; }
+        cell_size_type num_sources(cell_gid_type) const override { return 1; }
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            return spike_source_cell{schedule(cost_schedule{gid, 5e-3*(gid+1), log_})};
+        }
+
+    private:
+        cell_size_type n_;
+        std::vector<cell_gid_type>* log_;
+    };
+}
+
+TEST(lif_cell_group, cell_group_cost_order)
+{
+    // With one thread, the cell groups are advanced one after the other: in
+    // the first epoch in order of gid, then in decreasing order of the cost
+    // measured in the previous epoch.
+    std::vector<cell_gid_type> log;
+    auto context = make_context(proc_allocation(1, -1));
+    auto recipe = cost_recipe(4, &log);
+    auto decomp = partition_load_balance(recipe, context);
+    ASSERT_EQ(4u, decomp.groups.size());
+    simulation sim(recipe, decomp, context);
+
+    // Without connections, each call to run is one epoch.
+    for (time_type t: {1, 2, 3}) {
+        sim.run(t, 0.01);
+    }
+
+    ASSERT_EQ(12u, log.size());
+    EXPECT_EQ((std::vector<cell_gid_type>{0, 1, 2, 3}), std::vector<cell_gid_type>(log.begin(), log.begin()+4));
+    EXPECT_EQ((std::vector<cell_gid_type>{3, 2, 1, 0}), std::vector<cell_gid_type>(log.begin()+4, log.begin()+8));
+    EXPECT_EQ((std::vector<cell_gid_type>{3, 2, 1, 0}), std::vector<cell_gid_type>(log.begin()+8, log.end()));
+}
+
+TEST(lif_cell_group, rebalance)
+{
+    // Rebalancing must not change the spikes, and a single domain is always
+    // balanced with itself.
+    auto run_ring = [](cell_group_scheduling scheduling, time_type interval) {
+        proc_allocation resources(4, -1);
+        resources.group_scheduling = scheduling;
+        auto context = make_context(resources);
+        auto recipe = ring_recipe(99, 1000, 1);
+        auto decomp = partition_load_balance(recipe, context);
+        simulation sim(recipe, decomp, context);
+        sim.set_thread_rebalance_interval(interval);
+
+        std::size_t num_spikes = 0;
+        sim.set_global_spike_callback(
+            [&num_spikes](const std::vector<spike>& s) { num_spikes += s.size(); });
+        sim.run(100, 0.01);
+
+        EXPECT_EQ(1., sim.domain_load_imbalance());
+        EXPECT_THROW(sim.set_thread_rebalance_interval(-1), arbor_exception);
+        return num_spikes;
+    };
+
+    EXPECT_EQ(100u, run_ring(cell_group_scheduling::dynamic, 0));
+    EXPECT_EQ(100u, run_ring(cell_group_scheduling::dynamic, 5));
+    EXPECT_EQ(100u, run_ring(cell_group_scheduling::sticky, 5));
+    EXPECT_EQ(100u, run_ring(cell_group_scheduling::sticky, 0.1));
+}
+
+namespace {
+    // The schedule inner, which takes *cost seconds to evaluate.
+    struct costly_schedule {
+        schedule inner;
+        const double* cost;
+
+        time_event_span events(time_type t0, time_type t1) {
+            spin(*cost);
+            return inner.events(t0, t1);
+        }
+
+        void reset() { inner.reset(); }
+    };
+
+    // Spike source cells 0..n-1, each connected to one of the lif cells
+    // n..2n-1. The schedule of source gid takes (*cost)[gid] seconds to
+    // evaluate.
+    class costly_recipe: public arb::recipe {
+    public:
+        costly_recipe(cell_size_type n, const std::vector<double>* cost): n_(n), cost_(cost) {}
+
+        cell_size_type num_cells() const override { return 2*n_; }
+        cell_kind get_cell_kind(cell_gid_type gid) const override {
+            return gid<n_? cell_kind::spike_source: cell_kind::lif;
+        }
+        cell_size_type num_sources(cell_gid_type) const override { return 1; }
+        cell_size_type num_targets(cell_gid_type gid) const override { return gid<n_? 0: 1; }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            if (gid<n_) return {};
+            return {cell_connection({gid-n_, 0}, {gid, 0}, 1000, 1)};
+        }
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            if (gid<n_) {
+                return spike_source_cell{schedule(costly_schedule{regular_schedule(5), &(*cost_)[gid]})};
+            }
+            return lif_cell();
+        }
+
+    private:
+        cell_size_type n_;
+        const std::vector<double>* cost_;
+    };
+}
+
+TEST(lif_cell_group, rebalance_skewed_costs)
+{
+    // With sticky scheduling, the spike sources owned by the thread with the
+    // most of them are made expensive: rebalancing moves some of them to the
+    // other thread, and does not change the spikes.
+    const cell_size_type n = 8;
+    struct result {
+        std::vector<int> owners_before, owners_after;
+        std::vector<bool> expensive;
+        std::vector<spike> spikes;
+    };
+
+    auto run = [&](time_type interval) {
+        proc_allocation resources(2, -1);
+        resources.group_scheduling = cell_group_scheduling::sticky;
+        auto context = make_context(resources);
+        std::vector<double> cost(2*n, 0.);
+        costly_recipe recipe(n, &cost);
+        auto decomp = partition_load_balance(recipe, context);
+        simulation sim(recipe, decomp, context);
+        sim.set_thread_rebalance_interval(interval);
+
+        result r;
+        r.owners_before = sim.cell_group_threads();
+        const auto num_groups = decomp.groups.size();
+        EXPECT_EQ(2*n, num_groups);
+
+        std::vector<int> num_sources(2, 0);
+        for (auto i: util::make_span(num_groups)) {
+            if (decomp.groups[i].kind==cell_kind::spike_source) ++num_sources[r.owners_before[i]];
+        }
+        const int busy = num_sources[1]>num_sources[0];
+        for (auto i: util::make_span(num_groups)) {
+            const auto& g = decomp.groups[i];
+            r.expensive.push_back(g.kind==cell_kind::spike_source && r.owners_before[i]==busy);
+            if (r.expensive.back()) cost[g.gids[0]] = 0.5e-3;
+        }
+
+        sim.set_global_spike_callback(
+            [&r](const std::vector<spike>& s) { r.spikes.insert(r.spikes.end(), s.begin(), s.end()); });
+        sim.run(20, 0.01);
+        r.owners_after = sim.cell_group_threads();
+
+        std::sort(r.spikes.begin(), r.spikes.end(),
+            [](const spike& a, const spike& b) { return a.source<b.source || (a.source==b.source && a.time<b.time); });
+        return r;
+    };
+
+    auto expected = run(0);
+    EXPECT_EQ(expected.owners_before, expected.owners_after);
+
+    auto r = run(5);
+    EXPECT_NE(r.owners_before, r.owners_after);
+
+    // Both threads own some of the expensive groups.
+    std::vector<int> num_expensive(2, 0);
+    for (auto i: util::count_along(r.owners_after)) {
+        if (r.expensive[i]) ++num_expensive[r.owners_after[i]];
+    }
+    EXPECT_LT(0, num_expensive[0]);
+    EXPECT_LT(0, num_expensive[1]);
+
+    // Each source spikes every 5 ms, and so does the lif cell it drives.
+    EXPECT_EQ(2*n*4, expected.spikes.size());
+    ASSERT_EQ(expected.spikes.size(), r.spikes.size());
+    for (auto i: util::count_along(r.spikes)) {
+        EXPECT_EQ(expected.spikes[i].source, r.spikes[i].source);
+        EXPECT_EQ(expected.spikes[i].time, r.spikes[i].time);
+    }
+}
+
+TEST(lif_cell_group, calendar_event_lanes)
+{
+    // Keeping the pending events in calendar queues must not change the
+    // spikes.
+    auto run_ring = [](event_lane_kind kind) {
+        auto context = make_context(proc_allocation(2, -1));
+        auto recipe = ring_recipe(99, 1000, 1);
+        auto decomp = partition_load_balance(recipe, context);
+        simulation sim(recipe, decomp, context);
+        sim.set_event_lane_kind(kind);
+
+        std::vector<spike> spikes;
+        sim.set_global_spike_callback(
+            [&spikes](const std::vector<spike>& s) { spikes.insert(spikes.end(), s.begin(), s.end()); });
+        sim.run(100, 0.01);
+
+        EXPECT_THROW(sim.set_event_lane_kind(event_lane_kind::sorted), arbor_exception);
+        std::sort(spikes.begin(), spikes.end(),
+            [](const spike& a, const spike& b) { return a.time<b.time; });
+        return spikes;
+    };
+
+    auto expected = run_ring(event_lane_kind::sorted);
+    auto spikes = run_ring(event_lane_kind::calendar);
+    ASSERT_EQ(100u, expected.size());
+    ASSERT_EQ(expected.size(), spikes.size());
+    for (std::size_t i=0; i<spikes.size(); ++i) {
+        EXPECT_EQ(expected[i].source, spikes[i].source);
+        EXPECT_EQ(expected[i].time, spikes[i].time);
+    }
+
+    // Injected events far beyond the span of the calendar bins are kept
+    // until they are due, also over successive calls to run.
+    path_recipe recipe(2, 1000, 0.1);
+    auto context = make_context();
+    auto decomp = partition_load_balance(recipe, context);
+    simulation sim(recipe, decomp, context);
+    sim.set_event_lane_kind(event_lane_kind::calendar);
+
+    sim.inject_events({{{0, 0}, 1, 1000}, {{0, 0}, 1.1, 1000}, {{0, 0}, 50, 1000}});
+    sim.run(20, 0.01);
+    EXPECT_EQ(2u, sim.num_spikes());
+    sim.run(100, 0.01);
+    EXPECT_EQ(4u, sim.num_spikes());
+
+    // After reset, the kind can be changed again.
+    sim.reset();
+    sim.set_event_lane_kind(event_lane_kind::sorted);
+}
@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <vector>
 
 #include "../gtest.h"
@@ -78,6 +79,26 @@ TEST(local_context, gather_spikes)
     EXPECT_EQ(part[1], spikes.size());
 }
 
+TEST(local_context, start_gather)
+{
+    arb::local_context ctx;
+
+    std::vector<arb::spike> spikes = {
+        {{0u,3u}, 42.f},
+        {{1u,2u}, 42.f},
+    };
+    auto request = ctx.start_gather_spikes(spikes);
+    EXPECT_TRUE(request.test());
+    auto s = request.wait();
+    EXPECT_EQ(s.values(), spikes);
+    EXPECT_EQ(s.partition(), (std::vector<unsigned>{0u, 2u}));
+
+    std::vector<std::uint8_t> bytes = {1, 2, 3};
+    auto b = ctx.start_gather_bytes(bytes).wait();
+    EXPECT_EQ(b.values(), bytes);
+    EXPECT_EQ(b.partition(), (std::vector<unsigned>{0u, 3u}));
+}
+
 TEST(local_context, gather_gids)
 {
     arb::local_context ctx;
@@ -93,3 +114,25 @@ TEST(local_context, gather_gids)
     EXPECT_EQ(part[0], 0u);
     EXPECT_EQ(part[1], gids.size());
 }
+
+TEST(local_context, exchange_spikes)
+{
+    arb::local_context ctx;
+    using svec = std::vector<arb::spike>;
+
+    svec spikes = {
+        {{0u,3u}, 42.f},
+        {{1u,2u}, 42.f},
+        {{2u,1u}, 42.f},
+    };
+
+    // The domain sends to and receives from itself.
+    auto s = ctx.exchange_spikes(spikes, {0u, 3u}, {{0}, {0}});
+    EXPECT_EQ(s.values(), spikes);
+    EXPECT_EQ(s.partition(), (std::vector<unsigned>{0u, 3u}));
+
+    // No neighbours.
+    s = ctx.exchange_spikes({}, {0u}, {});
+    EXPECT_EQ(0u, s.size());
+    EXPECT_EQ(s.partition(), (std::vector<unsigned>{0u}));
+}
@@ -1,5 +1,6 @@
 #include "../gtest.h"
 
+#include <random>
 #include <vector>
 
 #include <arbor/event_generator.hpp>
@@ -179,8 +180,8 @@ TEST(merge_events, X)
     EXPECT_EQ(expected, lf);
 }
 
-// Test the tournament tree for merging two small sequences 
-TEST(merge_events, tourney_seq)
+// Test the loser tree for merging two small sequences
+TEST(merge_events, loser_tree_seq)
 {
     pse_vector evs1 = {
         {{0, 0}, 1, 1},
@@ -204,7 +205,7 @@ TEST(merge_events, tourney_seq)
     std::vector<event_span> spans;
     spans.emplace_back(g1.events(0, terminal_time));
     spans.emplace_back(g2.events(0, terminal_time));
-    impl::tourney_tree tree(spans);
+    impl::loser_tree tree(spans);
 
     pse_vector lf;
     while (!tree.empty()) {
@@ -220,13 +221,13 @@ TEST(merge_events, tourney_seq)
     EXPECT_EQ(expected, lf);
 }
 
-// Test the tournament tree on a large set of Poisson generators.
-TEST(merge_events, tourney_poisson)
+// Test the loser tree on a large set of Poisson generators.
+TEST(merge_events, loser_tree_poisson)
 {
     using rndgen = std::mt19937_64;
     // Number of poisson generators.
-    // Not a power of 2, so that there will be "null" leaf nodes in the
-    // tournament tree.
+    // Not a power of 2, so that the leaves of the loser tree are on two
+    // levels.
     auto ngen = 100u;
     time_type tfinal = 10;
     time_type t0 = 0;
@@ -251,25 +252,116 @@ TEST(merge_events, tourney_poisson)
         util::append(expected, evs);
 
         // Reset the generator so that it is ready to generate the same
-        // events again for the tournament tree test.
+        // events again for the loser tree test.
         gen.reset();
     }
     // Manually sort the expected events.
     util::sort(expected);
 
-    // Generate output using tournament tree in lf.
+    // Generate output using loser tree in lf.
     std::vector<event_span> spans;
     for (auto& gen: generators) {
         spans.emplace_back(gen.events(t0, tfinal));
     }
-    impl::tourney_tree tree(spans);
+    impl::loser_tree tree(spans);
     pse_vector lf;
     while (!tree.empty()) {
         lf.push_back(tree.head());
         tree.pop();
     }
 
-    // Test output of tournament tree.
+    // Test output of loser tree.
     EXPECT_TRUE(std::is_sorted(lf.begin(), lf.end()));
     EXPECT_EQ(lf, expected);
 }
+
+// Test that sort_events gives the same order as std::sort, for lanes on
+// either side of the radix sort threshold, with many events with the same
+// delivery time.
+TEST(sort_events, order)
+{
+    std::mt19937 G;
+    std::uniform_int_distribution<cell_lid_type> target(0, 9);
+    std::uniform_int_distribution<int> step(0, 99);
+    std::uniform_real_distribution<float> weight(0, 1);
+
+    for (std::size_t n: {std::size_t{0}, std::size_t{1}, std::size_t{10}, radix_sort_threshold-1, radix_sort_threshold, std::size_t{1000}, std::size_t{20000}}) {
+        pse_vector events;
+        for (std::size_t i=0; i<n; ++i) {
+            // Delivery times on a grid of 0.025 ms after 10 ms, as from spikes
+            // with a fixed time step.
+            events.push_back({{0, target(G)}, time_type(10+0.025*step(G)), weight(G)});
+        }
+
+        auto expected = events;
+        util::sort(expected);
+
+        pse_vector scratch(n);
+        sort_events(util::range_pointer_view(events), scratch.data());
+        EXPECT_EQ(expected, events);
+    }
+
+    // Continuous delivery times.
+    {
+        std::uniform_real_distribution<time_type> time(0, 5);
+        pse_vector events;
+        for (std::size_t i=0; i<5000; ++i) {
+            events.push_back({{0, target(G)}, time(G), weight(G)});
+        }
+        auto expected = events;
+        util::sort(expected);
+
+        pse_vector scratch(events.size());
+        sort_events(util::range_pointer_view(events), scratch.data());
+        EXPECT_EQ(expected, events);
+    }
+
+    // All events at the same time.
+    pse_vector events;
+    for (std::size_t i=0; i<1000; ++i) {
+        events.push_back({{0, target(G)}, 3., weight(G)});
+    }
+    auto expected = events;
+    util::sort(expected);
+
+    pse_vector scratch(events.size());
+    sort_events(util::range_pointer_view(events), scratch.data());
+    EXPECT_EQ(expected, events);
+}
+
+// Test tree_merge_events for each of the ways it merges, by the number of
+// non-empty sources.
+TEST(merge_events, tree_merge)
+{
+    std::mt19937 G;
+    std::uniform_int_distribution<int> step(0, 49);
+    std::uniform_int_distribution<cell_lid_type> target(0, 3);
+
+    for (unsigned k: {0u, 1u, 2u, 3u, 4u, 5u, 17u}) {
+        std::vector<pse_vector> lanes(k);
+        for (unsigned i=0; i<k; ++i) {
+            // Sources of different lengths, on a coarse time grid for ties.
+            for (unsigned j=0; j<10*i+3; ++j) {
+                lanes[i].push_back({{0, target(G)}, 0.5f*step(G), float(i)});
+            }
+            util::sort(lanes[i]);
+        }
+
+        std::vector<event_span> spans;
+        pse_vector expected;
+        for (auto& l: lanes) {
+            spans.push_back(util::range_pointer_view(l));
+            util::append(expected, l);
+            // Empty sources are ignored.
+            spans.push_back({});
+        }
+        util::sort(expected);
+
+        // Events are appended to the output.
+        pse_vector out = {{{1, 0}, -1, 0}};
+        expected.insert(expected.begin(), out.front());
+
+        tree_merge_events(spans, out);
+        EXPECT_EQ(expected, out);
+    }
+}
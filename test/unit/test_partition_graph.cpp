@@ -0,0 +1,116 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "partition_graph.hpp"
+
+using namespace arb;
+
+namespace {
+using edge_list = std::vector<std::pair<cell_size_type, cell_size_type>>;
+
+std::vector<double> part_loads(const weighted_graph& g, const std::vector<unsigned>& parts, unsigned num_parts) {
+    std::vector<double> load(num_parts, 0);
+    for (cell_size_type v = 0; v<g.size(); ++v) {
+        load[parts[v]] += g.vertex_weights[v];
+    }
+    return load;
+}
+
+// Two clusters of n vertices, connected all-to-all, with the vertices of
+// the clusters interleaved.
+weighted_graph interleaved_clusters(cell_size_type n) {
+    edge_list edges;
+    for (cell_size_type i = 0; i<2*n; ++i) {
+        for (cell_size_type j = i+2; j<2*n; j += 2) {
+            edges.push_back({i, j});
+        }
+    }
+    return make_weighted_graph(std::vector<double>(2*n, 1.), edges);
+}
+}
+
+TEST(partition_graph, make_graph) {
+    // Parallel edges are merged, self-loops dropped.
+    auto g = make_weighted_graph({1, 2, 3}, {{0, 1}, {1, 0}, {1, 2}, {2, 2}});
+
+    EXPECT_EQ(3u, g.size());
+    EXPECT_EQ((std::vector<std::size_t>{0, 1, 3, 4}), g.offsets);
+    EXPECT_EQ((std::vector<cell_size_type>{1, 0, 2, 1}), g.adjacency);
+    EXPECT_EQ((std::vector<double>{2, 2, 1, 1}), g.edge_weights);
+}
+
+TEST(partition_graph, trivial) {
+    auto g = interleaved_clusters(5);
+    EXPECT_EQ(std::vector<unsigned>(10, 0), partition_graph(g, 1));
+
+    EXPECT_TRUE(partition_graph(make_weighted_graph({}, {}), 4).empty());
+}
+
+TEST(partition_graph, clusters) {
+    // The clusters are found, although they are interleaved.
+    auto g = interleaved_clusters(10);
+    auto parts = partition_graph(g, 2);
+
+    EXPECT_EQ(0., edge_cut(g, parts));
+    EXPECT_EQ((std::vector<double>{10, 10}), part_loads(g, parts, 2));
+    for (cell_size_type v = 2; v<g.size(); ++v) {
+        EXPECT_EQ(parts[v-2], parts[v]);
+    }
+
+    // The same graph gives the same partition.
+    EXPECT_EQ(parts, partition_graph(g, 2));
+}
+
+TEST(partition_graph, ring) {
+    const cell_size_type n = 1000;
+    const unsigned num_parts = 7;
+
+    // A ring, with the vertices numbered in a scrambled order, so that
+    // contiguous ranges of vertices are not contiguous arcs of the ring.
+    auto label = [](cell_size_type i) { return (i*367)%n; };
+    edge_list edges;
+    for (cell_size_type i = 0; i<n; ++i) {
+        edges.push_back({label(i), label((i+1)%n)});
+    }
+    auto g = make_weighted_graph(std::vector<double>(n, 1.), edges);
+
+    std::vector<unsigned> contiguous;
+    for (cell_size_type v = 0; v<n; ++v) {
+        contiguous.push_back(v*num_parts/n);
+    }
+
+    auto parts = partition_graph(g, num_parts);
+    EXPECT_LT(edge_cut(g, parts), edge_cut(g, contiguous)/10);
+
+    for (auto l: part_loads(g, parts, num_parts)) {
+        EXPECT_LE(l, 1.05*n/num_parts);
+    }
+}
+
+TEST(partition_graph, balance) {
+    // Vertices of varying weight, and no edges.
+    std::vector<double> weights;
+    for (unsigned i = 0; i<100; ++i) {
+        weights.push_back(1+i%7);
+    }
+    auto g = make_weighted_graph(weights, {});
+    double total = 0;
+    for (auto w: weights) total += w;
+
+    auto parts = partition_graph(g, 4);
+    for (auto l: part_loads(g, parts, 4)) {
+        EXPECT_LE(l, 1.05*total/4);
+    }
+
+    // A vertex heavier than the mean load of a part gets a part of its own.
+    weights.assign(10, 1.);
+    weights[3] = 20;
+    g = make_weighted_graph(weights, {{3, 4}, {4, 5}});
+    parts = partition_graph(g, 2);
+    for (cell_size_type v = 0; v<g.size(); ++v) {
+        EXPECT_EQ(v==3, parts[v]==parts[3]);
+    }
+}
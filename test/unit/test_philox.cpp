@@ -0,0 +1,26 @@
+#include "../gtest.h"
+
+#include "util/philox.hpp"
+
+using namespace arb;
+using util::philox_block;
+using util::philox_key;
+
+// Known answers from the Random123 distribution.
+TEST(philox, known_answers) {
+    EXPECT_EQ((philox_block{{0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u}}),
+        util::philox4x32({{0u, 0u, 0u, 0u}}, {{0u, 0u}}));
+
+    EXPECT_EQ((philox_block{{0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu}}),
+        util::philox4x32({{0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}}, {{0xffffffffu, 0xffffffffu}}));
+
+    EXPECT_EQ((philox_block{{0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}}),
+        util::philox4x32({{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}}, {{0xa4093822u, 0x299f31d0u}}));
+}
+
+TEST(philox, uniform) {
+    EXPECT_EQ(1., util::philox_uniform({{0xffffffffu, 0xffffffffu, 0u, 0u}}));
+    double u = util::philox_uniform({{0u, 0u, 0u, 0u}});
+    EXPECT_LT(0., u);
+    EXPECT_GT(1e-15, u);
+}
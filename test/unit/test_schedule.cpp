@@ -348,3 +348,63 @@ TEST(schedule, poisson_offset_reset) {
     run_reset_check(poisson_schedule(3.3, 9.1, G), 1, 10, 7);
 }
 
+
+// A schedule without append_events, for which the times are copied from
+// events.
+struct times_only_schedule {
+    explicit_schedule_impl impl;
+
+    void reset() { impl.reset(); }
+    time_event_span events(time_type t0, time_type t1) { return impl.events(t0, t1); }
+};
+
+TEST(schedule, append_events) {
+    std::mt19937_64 G(23);
+    std::vector<schedule> scheds = {
+        regular_schedule(0.25),
+        regular_schedule(0.3, 0.1, 4.2),
+        explicit_schedule({0.1, 0.7, 1.3, 2.9}),
+        poisson_schedule(5., G),
+        schedule(times_only_schedule{explicit_schedule_impl(std::vector<time_type>{0.5, 1.5})}),
+        schedule()
+    };
+
+    // Appending the times of an interval gives the times from events, after
+    // any times already in the output.
+    for (auto s: scheds) {
+        schedule copy = s;
+        std::vector<time_type> appended = {-1};
+        std::vector<time_type> expected = {-1};
+        for (time_type t = 0; t<5; t += 0.35) {
+            s.append_events(t, t+time_type(0.35), appended);
+            util::append(expected, as_vector(copy.events(t, t+time_type(0.35))));
+        }
+        EXPECT_EQ(expected, appended);
+    }
+}
+
+TEST(schedule, evaluate_schedules) {
+    std::mt19937_64 G(29);
+    std::vector<schedule> scheds = {
+        regular_schedule(0.25),
+        explicit_schedule({0.1, 0.7, 1.3, 2.9}),
+        schedule(),
+        poisson_schedule(2., G),
+        regular_schedule(1.5, 0.1, 1.8)
+    };
+    std::vector<schedule> copies = scheds;
+
+    std::vector<time_type> times = {42};
+    std::vector<std::size_t> offsets = {3, 4};
+    for (auto ival: {std::make_pair(0.f, 1.f), std::make_pair(1.f, 1.f), std::make_pair(1.2f, 3.f)}) {
+        evaluate_schedules(scheds, ival.first, ival.second, times, offsets);
+
+        ASSERT_EQ(scheds.size()+1, offsets.size());
+        EXPECT_EQ(0u, offsets.front());
+        EXPECT_EQ(times.size(), offsets.back());
+        for (unsigned i=0; i<scheds.size(); ++i) {
+            std::vector<time_type> part(times.begin()+offsets[i], times.begin()+offsets[i+1]);
+            EXPECT_EQ(as_vector(copies[i].events(ival.first, ival.second)), part);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#include "../gtest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+#include "communication/spike_encoding.hpp"
+#include "util/rangeutil.hpp"
+
+using namespace arb;
+
+namespace {
+    std::vector<spike> decode(const std::vector<std::uint8_t>& bytes) {
+        std::vector<spike> spikes;
+        auto end = for_each_encoded_spike(bytes.data(), [&](const spike& s) { spikes.push_back(s); });
+        EXPECT_EQ(bytes.data()+bytes.size(), end);
+        return spikes;
+    }
+}
+
+TEST(spike_encoding, empty) {
+    std::vector<std::uint8_t> bytes;
+    encode_spikes({}, bytes);
+
+    EXPECT_EQ(1u, bytes.size());
+    EXPECT_EQ(0u, encoded_spike_count(bytes.data()));
+    EXPECT_TRUE(decode(bytes).empty());
+}
+
+TEST(spike_encoding, round_trip) {
+    std::vector<spike> spikes = {
+        {{0u, 0u}, 0.f},
+        {{0u, 3u}, -0.f},
+        {{7u, 0u}, 1e-30f},
+        {{7u, 0u}, 12.5f},
+        {{200u, 1u}, 0.25f},
+        {{4000000000u, 1000000u}, 1e30f},
+    };
+
+    std::vector<std::uint8_t> bytes;
+    encode_spikes(spikes, bytes);
+    EXPECT_EQ(spikes.size(), encoded_spike_count(bytes.data()));
+
+    auto decoded = decode(bytes);
+    ASSERT_EQ(spikes.size(), decoded.size());
+    for (std::size_t i = 0; i<spikes.size(); ++i) {
+        EXPECT_EQ(spikes[i].source, decoded[i].source);
+        // Times are compared bitwise: the encoding is exact.
+        EXPECT_EQ(0, std::memcmp(&spikes[i].time, &decoded[i].time, sizeof(time_type)));
+    }
+}
+
+TEST(spike_encoding, compact) {
+    // The spikes of 1000 cells with consecutive gids, in an epoch of 1 ms
+    // late in a simulation.
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<time_type> time_dist(1000.f, 1001.f);
+    std::vector<spike> spikes;
+    for (cell_gid_type gid = 0; gid<1000; ++gid) {
+        if (gid%3) spikes.push_back({{gid, 0u}, time_dist(gen)});
+    }
+
+    std::vector<std::uint8_t> bytes;
+    encode_spikes(spikes, bytes);
+    EXPECT_EQ(spikes, decode(bytes));
+
+    // One byte each for the gid difference and the source index, and at
+    // most three for the time offset.
+    EXPECT_LE(bytes.size(), 5*spikes.size()+10);
+    EXPECT_LT(bytes.size(), spikes.size()*sizeof(spike)/2);
+}
+
+TEST(spike_encoding, decode_gathered) {
+    std::vector<std::vector<spike>> domains = {
+        {{{1u, 0u}, 0.5f}, {{3u, 0u}, 0.1f}},
+        {},
+        {{{10u, 2u}, 0.2f}},
+    };
+
+    std::vector<std::uint8_t> bytes;
+    std::vector<unsigned> partition(1, 0);
+    std::vector<spike> expected;
+    for (auto& d: domains) {
+        encode_spikes(d, bytes);
+        partition.push_back(bytes.size());
+        util::append(expected, d);
+    }
+
+    auto spikes = decode_spikes(gathered_vector<std::uint8_t>(std::move(bytes), std::move(partition)));
+    EXPECT_EQ(expected, spikes.values());
+    EXPECT_EQ((std::vector<unsigned>{0, 2, 2, 3}), spikes.partition());
+}
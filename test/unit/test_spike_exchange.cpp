@@ -0,0 +1,244 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "communication/communicator.hpp"
+#include "communication/spike_encoding.hpp"
+#include "distributed_context.hpp"
+#include "execution_context.hpp"
+#include "util/rangeutil.hpp"
+#include "util/span.hpp"
+
+using namespace arb;
+
+namespace {
+    // Each cell has connections from num_inputs cells, which are close to
+    // it in the gid space, so that each domain receives spikes from a few
+    // neighbouring domains only.
+    class local_recipe: public recipe {
+    public:
+        local_recipe(cell_size_type n, cell_size_type num_inputs, cell_size_type spread):
+            size_(n), num_inputs_(num_inputs), spread_(spread)
+        {}
+
+        cell_size_type num_cells() const override { return size_; }
+
+        util::unique_any get_cell_description(cell_gid_type) const override { return {}; }
+
+        cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::cable; }
+
+        cell_size_type num_sources(cell_gid_type) const override { return 2; }
+        cell_size_type num_targets(cell_gid_type) const override { return num_inputs_; }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            std::vector<cell_connection> cons;
+            for (auto i: util::make_span(num_inputs_)) {
+                cell_gid_type src = (gid+size_+(i*7919+gid*31)%(2*spread_+1)-spread_)%size_;
+                cons.push_back(cell_connection({src, i%2}, {gid, i}, float(gid+i), 1.f+i%3));
+            }
+            return cons;
+        }
+
+    private:
+        cell_size_type size_;
+        cell_size_type num_inputs_;
+        cell_size_type spread_;
+    };
+
+    // Contiguous blocks of n cells per domain, in groups of 4 cells.
+    domain_decomposition block_decomposition(int num_domains, int domain, cell_size_type n) {
+        domain_decomposition d;
+        d.num_domains = num_domains;
+        d.domain_id = domain;
+        d.num_local_cells = n;
+        d.num_global_cells = n*num_domains;
+        d.gid_domain = [n](cell_gid_type gid) { return int(gid/n); };
+        for (cell_gid_type first = domain*n; first<(domain+1)*n; first += 4) {
+            auto last = std::min<cell_gid_type>(first+4, (domain+1)*n);
+            d.groups.push_back({cell_kind::cable, util::assign_from(util::make_span(first, last)), backend_kind::multicore});
+        }
+        return d;
+    }
+
+    bool event_less(const spike_event& a, const spike_event& b) {
+        return std::tie(a.target, a.time, a.weight)<std::tie(b.target, b.time, b.weight);
+    }
+
+    // The events generated on each domain by allgather and by sparse spike
+    // exchange of the spikes of the cells that satisfy fires, with each of
+    // num_domains domains of a thread context.
+    //
+    // With local connectivity, each domain receives fewer spikes than the
+    // allgather exchange delivers to every domain.
+    template <typename F>
+    void check_sparse_exchange(const recipe& rec, int num_domains, F&& fires, bool local = true) {
+        auto domains = make_thread_domain_contexts(num_domains);
+        const cell_size_type n = rec.num_cells()/num_domains;
+
+        std::vector<std::thread> threads;
+        std::vector<unsigned> num_received(num_domains);
+        std::vector<std::uint64_t> num_spikes(num_domains);
+        for (auto domain: util::make_span(num_domains)) {
+            threads.emplace_back([&, domain] {
+                execution_context ctx;
+                ctx.distributed = domains[domain];
+                auto sparse_ctx = ctx;
+                sparse_ctx.exchange = spike_exchange::sparse;
+
+                auto D = block_decomposition(num_domains, domain, n);
+                communicator A(rec, D, ctx);
+                communicator S(rec, D, sparse_ctx);
+
+                std::vector<spike> local_spikes;
+                for (auto gid: util::make_span(domain*n, (domain+1)*n)) {
+                    if (fires(gid)) {
+                        local_spikes.push_back({{gid, 0}, time_type(gid%5)});
+                        local_spikes.push_back({{gid, 1}, time_type(gid%3)});
+                    }
+                }
+
+                auto all_spikes = A.exchange(local_spikes);
+                auto sparse_spikes = S.exchange(local_spikes);
+                num_received[domain] = sparse_spikes.size();
+
+                cell_event_buffer expected, queues;
+                A.make_event_queues(all_spikes, expected);
+                S.make_event_queues(sparse_spikes, queues);
+                for (auto i: util::make_span(n)) {
+                    std::vector<spike_event> e = util::assign_from(expected.cell(i));
+                    std::vector<spike_event> q = util::assign_from(queues.cell(i));
+                    util::sort(e, event_less);
+                    util::sort(q, event_less);
+                    EXPECT_EQ(e, q) << "domain " << domain << ", cell " << i;
+                }
+
+                S.sum_spikes();
+                EXPECT_EQ(A.num_spikes(), S.num_spikes());
+                num_spikes[domain] = all_spikes.size();
+            });
+        }
+        for (auto& t: threads) t.join();
+
+        if (local && num_spikes[0]) {
+            for (auto domain: util::make_span(num_domains)) {
+                EXPECT_LT(num_received[domain], num_spikes[domain]);
+            }
+        }
+    }
+}
+
+TEST(spike_exchange, sparse_local_connectivity) {
+    // 4 domains of 32 cells, with connections from at most 8 gids away.
+    local_recipe rec(128, 6, 8);
+
+    check_sparse_exchange(rec, 4, [](cell_gid_type) { return true; });
+    check_sparse_exchange(rec, 4, [](cell_gid_type gid) { return gid%7==3; });
+    check_sparse_exchange(rec, 4, [](cell_gid_type) { return false; });
+}
+
+TEST(spike_exchange, sparse_wide_connectivity) {
+    // Connections from anywhere in the model: every domain is a neighbour
+    // of every other domain.
+    local_recipe rec(60, 5, 30);
+    check_sparse_exchange(rec, 3, [](cell_gid_type gid) { return gid%2; }, false);
+
+    auto domains = make_thread_domain_contexts(3);
+    std::vector<std::thread> threads;
+    for (auto domain: util::make_span(3)) {
+        threads.emplace_back([&, domain] {
+            execution_context ctx;
+            ctx.distributed = domains[domain];
+            ctx.exchange = spike_exchange::sparse;
+            auto D = block_decomposition(3, domain, 20);
+            communicator S(rec, D, ctx);
+
+            std::vector<spike> local_spikes;
+            for (cell_gid_type gid: util::make_span(domain*20, (domain+1)*20)) {
+                local_spikes.push_back({{gid, 0}, 0.5});
+            }
+            // The spikes received are partitioned by sending domain.
+            auto spikes = S.exchange(local_spikes);
+            ASSERT_EQ(3u, spikes.partition().size()-1);
+            for (auto r: util::make_span(3)) {
+                for (auto i: util::make_span(spikes.partition()[r], spikes.partition()[r+1])) {
+                    EXPECT_EQ(r, D.gid_domain(spikes.values()[i].source.gid));
+                }
+            }
+        });
+    }
+    for (auto& t: threads) t.join();
+}
+
+TEST(spike_exchange, sparse_dry_run) {
+    // A dry run can not find the destinations of the spikes of a sparse
+    // exchange, which is rejected when the communicator is made.
+    local_recipe rec(80, 5, 30);
+    execution_context ctx;
+    ctx.distributed = make_dry_run_context(4, 20);
+    auto D = block_decomposition(4, 0, 20);
+
+    EXPECT_NO_THROW(communicator(rec, D, ctx));
+    ctx.exchange = spike_exchange::sparse;
+    EXPECT_THROW(communicator(rec, D, ctx), arbor_exception);
+}
+
+TEST(spike_exchange, compact_encoding) {
+    // The encoded spikes generate the same events as the raw spikes, and
+    // decode to the same spikes.
+    const int num_domains = 3;
+    const cell_size_type n = 20;
+    local_recipe rec(num_domains*n, 5, 30);
+
+    auto domains = make_thread_domain_contexts(num_domains);
+    std::vector<std::thread> threads;
+    for (auto domain: util::make_span(num_domains)) {
+        threads.emplace_back([&, domain] {
+            execution_context ctx;
+            ctx.distributed = domains[domain];
+            auto compact_ctx = ctx;
+            compact_ctx.encoding = spike_encoding::compact;
+
+            auto D = block_decomposition(num_domains, domain, n);
+            communicator A(rec, D, ctx);
+            communicator C(rec, D, compact_ctx);
+            EXPECT_EQ(spike_encoding::raw, A.encoding());
+            EXPECT_EQ(spike_encoding::compact, C.encoding());
+
+            // Spikes are not sorted by source.
+            std::vector<spike> local_spikes;
+            for (auto gid: util::make_span(domain*n, (domain+1)*n)) {
+                if (gid%2) local_spikes.push_back({{gid, 1}, 10.f+0.01f*gid});
+                local_spikes.push_back({{gid, 0}, 10.f-0.003f*gid});
+            }
+            std::reverse(local_spikes.begin(), local_spikes.end());
+
+            auto all_spikes = A.exchange(local_spikes);
+            auto encoded = C.exchange_encoded(local_spikes);
+            auto decoded = decode_spikes(encoded);
+            EXPECT_EQ(all_spikes.values(), decoded.values());
+            EXPECT_EQ(all_spikes.partition(), decoded.partition());
+            EXPECT_LT(encoded.size(), all_spikes.size()*sizeof(spike));
+            EXPECT_EQ(A.num_spikes(), C.num_spikes());
+
+            cell_event_buffer expected, queues;
+            A.make_event_queues(all_spikes, expected);
+            C.make_event_queues(encoded, queues);
+            EXPECT_EQ(expected.divisions, queues.divisions);
+            EXPECT_EQ(expected.events, queues.events);
+        });
+    }
+    for (auto& t: threads) t.join();
+}
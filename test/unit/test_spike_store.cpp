@@ -89,3 +89,31 @@ TEST(spike_store, gather)
         EXPECT_EQ(spikes[i].time, gathered_spikes[i].time);
     }
 }
+
+TEST(spike_store, gather_sorted)
+{
+    using store_type = arb::thread_private_spike_store;
+
+    arb::proc_allocation resources(4, -1);
+    arb::execution_context context(resources);
+    store_type store(context.thread_pool);
+
+    // Insert spikes from many tasks, in decreasing order of source within
+    // each task.
+    const unsigned n = 100;
+    arb::threading::parallel_for::apply(0, n, context.thread_pool.get(),
+        [&](unsigned i) {
+            store.insert({{{n-i, 1}, 2.0f}, {{n-i, 0}, 1.0f}, {{n-i, 0}, 0.5f}});
+        });
+
+    auto spikes = store.gather();
+    ASSERT_EQ(3*n, spikes.size());
+    for (auto i=0u; i<n; ++i) {
+        EXPECT_EQ(spike({i+1, 0}, 0.5f), spikes[3*i]);
+        EXPECT_EQ(spike({i+1, 0}, 1.0f), spikes[3*i+1]);
+        EXPECT_EQ(spike({i+1, 1}, 2.0f), spikes[3*i+2]);
+    }
+
+    // The same spikes remain in the buffers.
+    EXPECT_EQ(spikes, store.gather());
+}
@@ -1,13 +1,22 @@
 #include "../gtest.h"
 #include "common.hpp"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <iostream>
+#include <numeric>
 #include <ostream>
+#include <thread>
+#include <vector>
 // (Pending abstraction of threading interface)
 #include <arbor/version.hpp>
 
-#include "threading/threading.hpp"
 #include "threading/enumerable_thread_specific.hpp"
+#include "threading/task_deque.hpp"
+#include "threading/threading.hpp"
 
 using namespace arb::threading::impl;
 using namespace arb::threading;
@@ -22,11 +31,13 @@ void reset() {
     ncopy = 0;
 }
 
+// Note: the move constructor is noexcept, so that an ftor is stored
+// inline in a task, as are the lambdas used with task_group in the library.
 struct ftor {
 
     ftor() {}
 
-    ftor(ftor&& other) {
+    ftor(ftor&& other) noexcept {
         ++nmove;
     }
 
@@ -68,7 +79,7 @@ TEST(task_system, test_copy) {
     ftor f;
     ts.async(f);
 
-    // Copy into new ftor and move ftor into a task (std::function<void()>)
+    // Copy into new ftor and move ftor into a task
     EXPECT_EQ(1, nmove);
     EXPECT_EQ(1, ncopy);
     reset();
@@ -80,7 +91,7 @@ TEST(task_system, test_move) {
     ftor f;
     ts.async(std::move(f));
 
-    // Move into new ftor and move ftor into a task (std::function<void()>)
+    // Move into new ftor and move ftor into a task
     EXPECT_LE(nmove, 2);
     EXPECT_LE(ncopy, 1);
     reset();
@@ -92,7 +103,7 @@ TEST(notification_queue, test_copy) {
     ftor f;
     q.push(f);
 
-    // Copy into new ftor and move ftor into a task (std::function<void()>)
+    // Copy into new ftor and move ftor into a task
     EXPECT_EQ(1, nmove);
     EXPECT_EQ(1, ncopy);
     reset();
@@ -103,7 +114,7 @@ TEST(notification_queue, test_move) {
 
     ftor f;
 
-    // Move into new ftor and move ftor into a task (std::function<void()>)
+    // Move into new ftor and move ftor into a task
     q.push(std::move(f));
     EXPECT_LE(nmove, 2);
     EXPECT_LE(ncopy, 1);
@@ -118,8 +129,9 @@ TEST(task_group, test_copy) {
     g.run(f);
     g.wait();
 
-    // Copy into "wrap" and move wrap into a task (std::function<void()>)
-    EXPECT_EQ(1, nmove);
+    // Copy into "wrap", move wrap into a task, and move the task (with the
+    // wrap stored inline) into and out of the task queue.
+    EXPECT_EQ(3, nmove);
     EXPECT_EQ(1, ncopy);
     reset();
 }
@@ -132,9 +144,10 @@ TEST(task_group, test_move) {
     g.run(std::move(f));
     g.wait();
 
-    // Move into wrap and move wrap into a task (std::function<void()>)
-    EXPECT_LE(nmove, 2);
-    EXPECT_LE(ncopy, 1);
+    // Move into wrap, move wrap into a task, and move the task (with the
+    // wrap stored inline) into and out of the task queue.
+    EXPECT_LE(nmove, 4);
+    EXPECT_EQ(ncopy, 0);
     reset();
 }
 
@@ -176,6 +189,38 @@ TEST(task_group, parallel_for) {
     }
 }
 
+TEST(task_group, parallel_for_grain) {
+    task_system ts(4);
+    for (int grain: {1, 3, 64, 10000}) {
+        for (int n = 0; n < 10000; n=!n?1:3*n) {
+            std::vector<int> v(n, 0);
+            parallel_for::apply(0, n, grain, &ts, [&](int i) {++v[i];});
+            for (int i = 0; i< n; i++) {
+                EXPECT_EQ(1, v[i]);
+            }
+        }
+    }
+
+    // Non-zero offset and empty ranges.
+    std::vector<int> v(100, 0);
+    parallel_for::apply(10, 90, 7, &ts, [&](int i) {++v[i];});
+    parallel_for::apply(50, 50, 7, &ts, [&](int i) {++v[i];});
+    parallel_for::apply(60, 40, 7, &ts, [&](int i) {++v[i];});
+    for (int i = 0; i<100; ++i) {
+        EXPECT_EQ(i>=10 && i<90? 1: 0, v[i]);
+    }
+}
+
+TEST(task_group, parallel_for_auto_grain) {
+    task_system ts(4);
+    const int nchunks = parallel_for::chunks_per_thread*ts.get_num_threads();
+
+    EXPECT_EQ(1, parallel_for::auto_grain_size(0, 0, &ts));
+    EXPECT_EQ(1, parallel_for::auto_grain_size(0, nchunks, &ts));
+    EXPECT_EQ(2, parallel_for::auto_grain_size(0, nchunks+1, &ts));
+    EXPECT_EQ(100, parallel_for::auto_grain_size(5, 5+100*nchunks, &ts));
+}
+
 TEST(task_group, nested_parallel_for) {
     task_system ts;
     for (int m = 1; m < 512; m*=2) {
@@ -194,6 +239,280 @@ TEST(task_group, nested_parallel_for) {
     }
 }
 
+TEST(task, storage) {
+    auto count = allocation_count();
+
+    // Small callables are stored inline.
+    int n = 0;
+    task t([&n] { ++n; });
+    EXPECT_TRUE(t);
+    t();
+    EXPECT_EQ(1, n);
+    EXPECT_EQ(count, allocation_count());
+
+    // Moved-from tasks are empty.
+    task u(std::move(t));
+    EXPECT_FALSE(t);
+    u();
+    EXPECT_EQ(2, n);
+    u = nullptr;
+    EXPECT_FALSE(u);
+
+    // Move-only callables are supported.
+    std::unique_ptr<int> p(new int(3));
+    task v([p = std::move(p), &n] { n += *p; });
+    v();
+    EXPECT_EQ(5, n);
+    EXPECT_EQ(count, allocation_count());
+
+    // Large callables are stored on the heap.
+    std::array<char, 2*task::inline_size> big{};
+    big[0] = 7;
+    task w([big, &n] { n += big[0]; });
+    EXPECT_EQ(count+1, allocation_count());
+    task x(std::move(w));
+    x();
+    EXPECT_EQ(12, n);
+}
+
+TEST(task_group, steady_state_allocation) {
+    // After warm-up, running the same pattern of tasks performs no heap
+    // allocations in the threading layer: the pattern below follows
+    // simulation_state::run, with an exchange task running concurrently
+    // with a parallel_for over cell groups and one over cells.
+    for (auto sched: {task_scheduler::shared_queue, task_scheduler::work_stealing}) {
+        for (int nthreads: {1, 2, 4}) {
+            task_system ts(nthreads, sched);
+            std::vector<int> groups(100), cells(1000);
+
+            auto epoch = [&] {
+                task_group g(&ts);
+                g.run([&] {
+                    parallel_for::apply(0, cells.size(), &ts, [&](int i) { ++cells[i]; });
+                });
+                g.run([&] {
+                    parallel_for::apply(0, groups.size(), 1, &ts, [&](int i) { ++groups[i]; });
+                });
+                g.wait();
+            };
+
+            for (int i = 0; i<10; ++i) epoch();
+            auto count = allocation_count();
+            for (int i = 0; i<100; ++i) epoch();
+
+            EXPECT_EQ(count, allocation_count()) << "nthreads " << nthreads;
+            EXPECT_EQ(110, groups[0]);
+            EXPECT_EQ(110, cells[999]);
+        }
+    }
+}
+
+TEST(task_deque, aligned_new) {
+    // top_ and bottom_ are on separate cache lines only if the deque itself
+    // is aligned to a cache line.
+    for (int i = 0; i<10; ++i) {
+        std::unique_ptr<task_deque<int>> d(new task_deque<int>());
+        EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(d.get())%alignof(task_deque<int>));
+    }
+}
+
+TEST(task_deque, owner_and_thief) {
+    task_deque<int> d(4);
+    std::vector<int> v(100);
+    std::iota(v.begin(), v.end(), 0);
+
+    EXPECT_TRUE(d.empty());
+    EXPECT_EQ(nullptr, d.pop());
+    EXPECT_EQ(nullptr, d.steal());
+
+    // Push past initial capacity to exercise growth.
+    for (auto& x: v) d.push(&x);
+    EXPECT_FALSE(d.empty());
+
+    // Owner pops LIFO, thief steals FIFO.
+    EXPECT_EQ(&v[99], d.pop());
+    EXPECT_EQ(&v[0], d.steal());
+    EXPECT_EQ(&v[98], d.pop());
+    EXPECT_EQ(&v[1], d.steal());
+
+    int n = 0;
+    while (d.pop()) ++n;
+    EXPECT_EQ(96, n);
+    EXPECT_TRUE(d.empty());
+}
+
+TEST(task_deque, concurrent_steal) {
+    // Every element is taken exactly once by either the owner or a thief.
+    const int n = 100000;
+    const int nthieves = 3;
+    std::vector<int> v(n, 0);
+    task_deque<int> d(16);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> thieves;
+    for (int k = 0; k<nthieves; ++k) {
+        thieves.emplace_back([&] {
+            while (!done.load()) {
+                if (int* x = d.steal()) ++*x;
+            }
+        });
+    }
+
+    for (int i = 0; i<n; ++i) {
+        d.push(&v[i]);
+        if (i%3==0) {
+            if (int* x = d.pop()) ++*x;
+        }
+    }
+    while (int* x = d.pop()) ++*x;
+    done = true;
+    for (auto& t: thieves) t.join();
+
+    for (int i = 0; i<n; ++i) {
+        ASSERT_EQ(1, v[i]) << "element " << i;
+    }
+}
+
+TEST(task_system, work_stealing) {
+    for (int nthreads: {1, 2, 4, 16}) {
+        task_system ts(nthreads, task_scheduler::work_stealing);
+        EXPECT_EQ(task_scheduler::work_stealing, ts.scheduler());
+        EXPECT_EQ(nthreads, ts.get_num_threads());
+
+        // Flat and nested parallel_for.
+        for (int m = 1; m < 128; m*=4) {
+            for (int n = 0; n < 1000; n=!n?1:4*n) {
+                std::vector<std::vector<int>> v(n, std::vector<int>(m, -1));
+                parallel_for::apply(0, n, 1, &ts, [&](int i) {
+                    auto &w = v[i];
+                    parallel_for::apply(0, m, 1, &ts, [&](int j) { w[j] = i + j; });
+                });
+                for (int i = 0; i < n; i++) {
+                    for (int j = 0; j < m; j++) {
+                        EXPECT_EQ(i + j, v[i][j]);
+                    }
+                }
+            }
+        }
+
+        // Many tasks with uneven cost.
+        std::atomic<int> count{0};
+        task_group g(&ts);
+        for (int i = 0; i < 1000; i++) {
+            g.run([&, i] {
+                if (i%100==0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+                ++count;
+            });
+        }
+        g.wait();
+        EXPECT_EQ(1000, count);
+    }
+}
+
+TEST(task_system, work_stealing_foreign_thread) {
+    // Tasks submitted from a thread that is not part of the pool go through
+    // the injection queue.
+    task_system ts(4, task_scheduler::work_stealing);
+    std::vector<int> v(1000, 0);
+
+    std::thread t([&] {
+        parallel_for::apply(0, v.size(), 1, &ts, [&](int i) { v[i] = i; });
+    });
+    t.join();
+
+    for (int i = 0; i < (int)v.size(); i++) {
+        EXPECT_EQ(i, v[i]);
+    }
+}
+
+TEST(affinity_schedule, apply) {
+    // Every index is processed exactly once, with either scheduler, and
+    // with owners that are unevenly loaded.
+    for (auto scheduler: {task_scheduler::shared_queue, task_scheduler::work_stealing}) {
+        task_system ts(4, scheduler);
+        std::vector<int> owner(1000);
+        for (int i = 0; i < (int)owner.size(); i++) {
+            owner[i] = i<900? 3: i%4;
+        }
+        affinity_schedule sched(owner, 4);
+        EXPECT_EQ(owner.size(), sched.size());
+
+        for (int pass = 0; pass < 3; pass++) {
+            std::vector<std::atomic<int>> count(owner.size());
+            for (auto& c: count) c = 0;
+            sched.apply(&ts, [&](int i) { ++count[i]; });
+            for (auto& c: count) {
+                EXPECT_EQ(1, c);
+            }
+        }
+    }
+
+    EXPECT_THROW(affinity_schedule({0, 4}, 4), std::runtime_error);
+}
+
+TEST(affinity_schedule, order_by_cost) {
+    // With one thread the indices are processed in schedule order:
+    // by owner, then by decreasing cost.
+    task_system ts(1);
+    std::vector<int> owner = {1, 0, 1, 0, 1, 0};
+    std::vector<double> cost = {1., 2., 3., 2., 0., 5.};
+    affinity_schedule sched(owner, 2);
+
+    std::vector<int> order;
+    sched.apply(&ts, [&](int i) { order.push_back(i); });
+    EXPECT_EQ((std::vector<int>{1, 3, 5, 0, 2, 4}), order);
+
+    sched.order_by_cost(cost);
+    order.clear();
+    sched.apply(&ts, [&](int i) { order.push_back(i); });
+    EXPECT_EQ((std::vector<int>{5, 1, 3, 2, 0, 4}), order);
+}
+
+TEST(affinity_schedule, rebalance_owners) {
+    // From one thread: index 2 (cost 5) is moved to thread 1, leaving loads
+    // of 11 and 5, then index 0 (3), leaving 8 and 8.
+    std::vector<double> cost = {3., 1., 5., 3., 4.};
+    EXPECT_EQ((std::vector<int>{1, 0, 1, 0, 0}), rebalance_owners(cost, std::vector<int>(5, 0), 2));
+
+    // A balanced assignment is kept.
+    EXPECT_EQ((std::vector<int>{0, 1, 0, 1, 1}), rebalance_owners(cost, {0, 1, 0, 1, 1}, 2));
+
+    // More threads than indices: index 2 stays the most loaded on its own.
+    EXPECT_EQ((std::vector<int>{3, 0, 1, 0, 2}), rebalance_owners(cost, std::vector<int>(5, 0), 6));
+
+    // Equal costs are moved in index order to the least loaded thread.
+    EXPECT_EQ((std::vector<int>{1, 2, 1, 2, 0, 0}), rebalance_owners(std::vector<double>(6, 1.), std::vector<int>(6, 0), 3));
+}
+
+TEST(affinity_schedule, owner_runs_own_indices) {
+    // When the load is balanced, each thread processes its own indices.
+    // Every index takes long enough that no thread runs out of work before
+    // all threads have started.
+    task_system ts(4);
+    std::vector<int> owner(16);
+    for (int i = 0; i < (int)owner.size(); i++) {
+        owner[i] = i%4;
+    }
+    affinity_schedule sched(owner, 4);
+
+    std::vector<int> ran_on(owner.size(), -1);
+    std::atomic<int> started{0};
+    sched.apply(&ts, [&](int i) {
+        ++started;
+        while (started<4) std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ran_on[i] = ts.current_index();
+    });
+
+    int own = 0;
+    for (int i = 0; i < (int)owner.size(); i++) {
+        own += ran_on[i]==owner[i];
+    }
+    // Thread 0 waits in the task_group, so may start late; allow some
+    // indices to be taken by other threads.
+    EXPECT_LE(12, own);
+}
+
 TEST(enumerable_thread_specific, test) {
     task_system_handle ts = task_system_handle(new task_system);
     enumerable_thread_specific<int> buffers(ts);
@@ -0,0 +1,167 @@
+#include "../gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/context.hpp>
+#include <arbor/spike.hpp>
+
+#include "distributed_context.hpp"
+#include "execution_context.hpp"
+#include "util/span.hpp"
+
+using namespace arb;
+
+namespace {
+    // Run f(domain, ctx) in a thread for each domain of a thread context.
+    template <typename F>
+    void run_domains(int num_domains, F&& f) {
+        auto domains = make_thread_domain_contexts(num_domains);
+        std::vector<std::thread> threads;
+        for (auto domain: util::make_span(num_domains)) {
+            threads.emplace_back([&, domain] { f(domain, *domains[domain]); });
+        }
+        for (auto& t: threads) t.join();
+    }
+}
+
+TEST(thread_context, size_rank) {
+    run_domains(3, [](int domain, const distributed_context& ctx) {
+        EXPECT_EQ(3, ctx.size());
+        EXPECT_EQ(domain, ctx.id());
+        EXPECT_EQ("threads", ctx.name());
+    });
+}
+
+TEST(thread_context, collectives) {
+    run_domains(3, [](int domain, const distributed_context& ctx) {
+        EXPECT_EQ(0+1+2, ctx.sum(domain));
+        EXPECT_EQ(0, ctx.min(domain));
+        EXPECT_EQ(2, ctx.max(domain));
+        EXPECT_EQ(1.0, ctx.max(0.5*domain));
+
+        std::vector<cell_gid_type> gids(domain, domain);
+        auto g = ctx.gather_gids(gids);
+        EXPECT_EQ((std::vector<cell_gid_type>{1, 2, 2}), g.values());
+        EXPECT_EQ((std::vector<unsigned>{0, 0, 1, 3}), g.partition());
+
+        // Only the root receives the gathered values.
+        auto s = ctx.gather(std::to_string(domain), 1);
+        if (domain==1) {
+            EXPECT_EQ((std::vector<std::string>{"0", "1", "2"}), s);
+        }
+        else {
+            EXPECT_TRUE(s.empty());
+        }
+
+        ctx.barrier();
+    });
+}
+
+TEST(thread_context, gather_spikes) {
+    run_domains(4, [](int domain, const distributed_context& ctx) {
+        // Repeat, so that both sets of buffers are reused.
+        for (unsigned n: {2u, 0u, 5u, 1u}) {
+            std::vector<spike> spikes;
+            for (auto i: util::make_span(n*domain)) {
+                spikes.push_back({{cell_gid_type(domain), i}, float(i)});
+            }
+
+            std::vector<spike> expected;
+            std::vector<unsigned> partition = {0};
+            for (auto d: util::make_span(4u)) {
+                for (auto i: util::make_span(n*d)) {
+                    expected.push_back({{d, i}, float(i)});
+                }
+                partition.push_back(expected.size());
+            }
+
+            auto g = ctx.gather_spikes(spikes);
+            EXPECT_EQ(expected, g.values());
+            EXPECT_EQ(partition, g.partition());
+
+            // The local values may be modified once the gather is started.
+            auto request = ctx.start_gather_spikes(spikes);
+            spikes.clear();
+            while (!request.test()) {}
+            g = request.wait();
+            EXPECT_EQ(expected, g.values());
+            EXPECT_EQ(partition, g.partition());
+        }
+
+        std::vector<std::uint8_t> bytes(domain, std::uint8_t(domain));
+        auto b = ctx.start_gather_bytes(bytes).wait();
+        EXPECT_EQ((std::vector<std::uint8_t>{1, 2, 2, 3, 3, 3}), b.values());
+        EXPECT_EQ((std::vector<unsigned>{0, 0, 1, 3, 6}), b.partition());
+    });
+}
+
+TEST(thread_context, exchange_spikes) {
+    // Each domain sends its spikes to the next domain in a ring.
+    run_domains(3, [](int domain, const distributed_context& ctx) {
+        spike_exchange_neighbors neighbors;
+        neighbors.send = {(domain+1)%3};
+        neighbors.recv = {(domain+2)%3};
+
+        std::vector<spike> spikes(domain+1, spike({cell_gid_type(domain), 0u}, 1.f));
+        auto g = ctx.exchange_spikes(spikes, {0u, unsigned(spikes.size())}, neighbors);
+
+        int from = (domain+2)%3;
+        EXPECT_EQ(std::vector<spike>(from+1, spike({cell_gid_type(from), 0u}, 1.f)), g.values());
+        EXPECT_EQ((std::vector<unsigned>{0, unsigned(from+1)}), g.partition());
+    });
+}
+
+TEST(thread_context, run_thread_domains) {
+    proc_allocation resources(2, -1);
+    std::vector<int> ids(3, -1);
+    std::vector<unsigned> threads(3);
+    run_thread_domains(resources, 3, [&](const context& ctx) {
+        auto r = rank(ctx);
+        ids[r] = r;
+        threads[r] = num_threads(ctx);
+        EXPECT_EQ(3u, num_ranks(ctx));
+        EXPECT_EQ("threads", distribution_type(ctx));
+        EXPECT_FALSE(has_mpi(ctx));
+    });
+    EXPECT_EQ((std::vector<int>{0, 1, 2}), ids);
+    EXPECT_EQ((std::vector<unsigned>{2, 2, 2}), threads);
+
+    // Exceptions are passed on to the caller.
+    EXPECT_THROW(run_thread_domains(resources, 2, [](const context& ctx) {
+        if (rank(ctx)==1) throw std::runtime_error("domain 1");
+    }), std::runtime_error);
+}
+
+TEST(thread_context, run_thread_domains_abort) {
+    // A domain that throws while the others wait for it in a collective
+    // aborts the collective, and its exception is passed on to the caller.
+    proc_allocation resources(1, -1);
+    std::atomic<int> aborted(0);
+    try {
+        run_thread_domains(resources, 3, [&](const context& ctx) {
+            if (rank(ctx)==1) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                throw std::runtime_error("domain 1");
+            }
+            try {
+                ctx->distributed->sum(1);
+            }
+            catch (arbor_exception&) {
+                ++aborted;
+                throw;
+            }
+        });
+        FAIL() << "expected an exception";
+    }
+    catch (std::runtime_error& e) {
+        EXPECT_EQ(std::string("domain 1"), e.what());
+    }
+    EXPECT_EQ(2, aborted);
+}
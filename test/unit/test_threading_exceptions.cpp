@@ -306,6 +306,24 @@ TEST(test_exception, post_exception_state) {
     }
 }
 
+TEST(test_exception, work_stealing) {
+    for (int nthreads: {1, 2, 16}) {
+        task_system ts(nthreads, task_scheduler::work_stealing);
+        for (int n = 1; n < 1000; n*=2) {
+            try {
+                parallel_for::apply(0, n, 1, &ts, [](int i) { if(i%7 == 0) {throw error(i);} });
+                FAIL() << "Expected exception";
+            }
+            catch (error &e) {
+                EXPECT_EQ(e.code%7, 0);
+            }
+            catch (...) {
+                FAIL() << "Expected error type";
+            }
+        }
+    }
+}
+
 TEST(test_exception, terminate_if_no_wait_DeathTest) {
     testing::FLAGS_gtest_death_test_style = "threadsafe";
 